@@ -0,0 +1,27 @@
+# cmake -DINPUT=x.spv -DOUTPUT=x.hpp -DSYMBOL=name -DSOURCE=file -P this
+# writes the SPIR-V module as a constexpr array of words
+
+file(READ ${INPUT} _hex HEX)
+string(LENGTH "${_hex}" _length)
+math(EXPR _remainder "${_length} % 8")
+if (_length EQUAL 0 OR NOT _remainder EQUAL 0)
+  message(FATAL_ERROR "'${INPUT}' is not a SPIR-V module")
+endif()
+
+# SPIR-V is a stream of little-endian words
+string(REGEX REPLACE
+  "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])"
+  "0x\\4\\3\\2\\1,"
+  _words "${_hex}"
+)
+# eight words per line
+string(REGEX REPLACE "((0x[0-9a-f]+,){8})" "\\1\n    " _words "${_words}")
+
+file(WRITE ${OUTPUT}
+  "// generated from ${SOURCE} by cmake/EmbedSpirv.cmake, do not edit\n"
+  "#pragma once\n\n"
+  "#include <cstdint>\n\n"
+  "inline constexpr uint32_t ${SYMBOL}[] = {\n"
+  "    ${_words}\n"
+  "};\n"
+)
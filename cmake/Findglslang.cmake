@@ -29,6 +29,8 @@
 find_program(GLSLANG_VALIDATOR_EXECUTABLE glslangValidator)
 if (GLSLANG_VALIDATOR_EXECUTABLE)
   set(Glslang_FOUND TRUE)
+  # find_package checks the spelling of the package name it was called with
+  set(glslang_FOUND TRUE)
 endif()
 
 # Copied from ECMPoQmTools which copied it from FindGettext.cmake
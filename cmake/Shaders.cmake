@@ -0,0 +1,187 @@
+# compiles GLSL to SPIR-V at build time & embeds the result in the binary,
+# so nothing is parsed or read from disk for shaders at runtime
+#
+#   dtq_add_shader(shaders/bands.frag
+#     PERMUTATION bands4 "0:4"
+#     PERMUTATION bands8 "0:8"
+#   )
+#   dtq_embed_shaders(dtq)
+#
+# every shader is embedded as-is under its file name ("bands.frag") and once
+# per permutation ("bands.frag:bands4"). Permutations name specialization
+# constant values ("<constant_id>:<value> ..."); with spirv-opt they are baked
+# into the module & folded, without it the values are recorded next to the
+# blob and supplied as vk::SpecializationInfo at pipeline creation instead.
+
+find_program(SPIRV_OPT_EXECUTABLE spirv-opt)
+if (SPIRV_OPT_EXECUTABLE)
+  message("[spirv-opt found, shaders are optimized]")
+else()
+  message("[spirv-opt not found, shaders are embedded unoptimized]")
+endif()
+
+set(DTQ_SHADER_EMBED_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/EmbedSpirv.cmake")
+set(DTQ_SHADER_OUTPUT_DIR "${CMAKE_CURRENT_BINARY_DIR}/shaders")
+
+function(_dtq_shader_stage _shader _out)
+  get_filename_component(_ext ${_shader} EXT)
+  string(REGEX REPLACE "^.*\\." "" _ext "${_ext}")
+  if (_ext STREQUAL "vert")
+    set(_stage eVertex)
+  elseif (_ext STREQUAL "frag")
+    set(_stage eFragment)
+  elseif (_ext STREQUAL "comp")
+    set(_stage eCompute)
+  elseif (_ext STREQUAL "geom")
+    set(_stage eGeometry)
+  elseif (_ext STREQUAL "tesc")
+    set(_stage eTessellationControl)
+  elseif (_ext STREQUAL "tese")
+    set(_stage eTessellationEvaluation)
+  else()
+    message(FATAL_ERROR "unknown shader stage for '${_shader}'")
+  endif()
+  set(${_out} ${_stage} PARENT_SCOPE)
+endfunction()
+
+# one compile -> optimize -> embed chain, producing ${_symbol}.hpp
+function(_dtq_compile_shader _shader_abs _name _symbol _specs)
+  set(_raw "${DTQ_SHADER_OUTPUT_DIR}/${_symbol}.raw.spv")
+  set(_spv "${DTQ_SHADER_OUTPUT_DIR}/${_symbol}.spv")
+  set(_hpp "${DTQ_SHADER_OUTPUT_DIR}/${_symbol}.hpp")
+
+  if (SPIRV_OPT_EXECUTABLE)
+    set(_opt_args)
+    if (_specs)
+      list(APPEND _opt_args
+        "--set-spec-const-default-value=${_specs}"
+        --freeze-spec-const
+      )
+    endif()
+    set(_optimize
+      COMMAND ${SPIRV_OPT_EXECUTABLE} ${_opt_args} -O ${_raw} -o ${_spv}
+    )
+    set(_runtime_specs "")
+  else()
+    set(_optimize COMMAND ${CMAKE_COMMAND} -E copy ${_raw} ${_spv})
+    set(_runtime_specs "${_specs}")
+  endif()
+
+  # includes (ei. bindless.glsl) live next to the shaders
+  get_filename_component(_shader_dir ${_shader_abs} DIRECTORY)
+  file(GLOB _includes "${_shader_dir}/*.glsl")
+
+  add_custom_command(
+    OUTPUT ${_hpp}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${DTQ_SHADER_OUTPUT_DIR}
+    COMMAND
+      ${GLSLANG_VALIDATOR_EXECUTABLE} -V --target-env vulkan1.2
+        -o ${_raw} ${_shader_abs}
+    ${_optimize}
+    COMMAND
+      ${CMAKE_COMMAND}
+        -DINPUT=${_spv} -DOUTPUT=${_hpp} -DSYMBOL=${_symbol} -DSOURCE=${_name}
+        -P ${DTQ_SHADER_EMBED_SCRIPT}
+    MAIN_DEPENDENCY ${_shader_abs}
+    DEPENDS ${DTQ_SHADER_EMBED_SCRIPT} ${_includes}
+    VERBATIM
+  )
+
+  _dtq_shader_stage(${_shader_abs} _stage)
+  set_property(GLOBAL APPEND PROPERTY DTQ_SHADER_HEADERS ${_hpp})
+  set_property(GLOBAL APPEND PROPERTY DTQ_SHADER_ENTRIES
+    "${_name}|${_symbol}|${_stage}|${_runtime_specs}"
+  )
+endfunction()
+
+function(dtq_add_shader _shader)
+  get_filename_component(_shader_abs ${_shader} ABSOLUTE)
+  get_filename_component(_file ${_shader} NAME)
+  string(MAKE_C_IDENTIFIER "shader_${_file}" _symbol)
+
+  _dtq_compile_shader(${_shader_abs} ${_file} ${_symbol} "")
+
+  set(_args ${ARGN})
+  list(LENGTH _args _count)
+  while (_count GREATER 0)
+    if (_count LESS 3)
+      message(FATAL_ERROR "'${_shader}': PERMUTATION takes a name & values")
+    endif()
+    list(GET _args 0 _keyword)
+    list(GET _args 1 _permutation)
+    list(GET _args 2 _specs)
+    list(REMOVE_AT _args 0 1 2)
+    list(LENGTH _args _count)
+
+    if (NOT _keyword STREQUAL "PERMUTATION")
+      message(FATAL_ERROR "'${_shader}': unexpected '${_keyword}'")
+    endif()
+
+    string(MAKE_C_IDENTIFIER "${_symbol}_${_permutation}" _perm_symbol)
+    _dtq_compile_shader(
+      ${_shader_abs} "${_file}:${_permutation}" ${_perm_symbol} "${_specs}"
+    )
+  endwhile()
+endfunction()
+
+# generates the registry over every dtq_add_shader so far & adds it to _target
+function(dtq_embed_shaders _target)
+  get_property(_headers GLOBAL PROPERTY DTQ_SHADER_HEADERS)
+  get_property(_entries GLOBAL PROPERTY DTQ_SHADER_ENTRIES)
+
+  set(_includes "")
+  set(_specs "")
+  set(_table "")
+  foreach(_entry ${_entries})
+    string(REPLACE "|" ";" _fields "${_entry}")
+    list(GET _fields 0 _name)
+    list(GET _fields 1 _symbol)
+    list(GET _fields 2 _stage)
+    list(LENGTH _fields _field_count)
+    set(_values "")
+    if (_field_count GREATER 3)
+      list(GET _fields 3 _values)
+    endif()
+
+    string(APPEND _includes "#include \"${_symbol}.hpp\"\n")
+
+    set(_spec_span "{}")
+    if (_values)
+      string(REPLACE " " ";" _values "${_values}")
+      set(_spec_list "")
+      foreach(_value ${_values})
+        string(REPLACE ":" ", " _value "${_value}")
+        string(APPEND _spec_list "{ ${_value} }, ")
+      endforeach()
+      string(APPEND _specs
+        "constexpr SpecializationConstant ${_symbol}_specs[] = "
+        "{ ${_spec_list}};\n"
+      )
+      set(_spec_span "${_symbol}_specs")
+    endif()
+
+    string(APPEND _table
+      "  { \"${_name}\", vk::ShaderStageFlagBits::${_stage}, "
+      "${_symbol}, ${_spec_span} },\n"
+    )
+  endforeach()
+
+  set(_registry "${DTQ_SHADER_OUTPUT_DIR}/registry.cpp")
+  file(WRITE "${_registry}.in"
+    "// generated by cmake/Shaders.cmake, do not edit\n"
+    "#include \"shaders.hpp\"\n\n"
+    "${_includes}\n"
+    "namespace {\n\n"
+    "${_specs}\n"
+    "constexpr ShaderBlob registry[] = {\n"
+    "${_table}"
+    "};\n\n"
+    "} // -- namespace\n\n"
+    "std::span<ShaderBlob const> ShaderRegistry() { return registry; }\n"
+  )
+  # only touches the registry when its contents change
+  configure_file("${_registry}.in" "${_registry}" COPYONLY)
+
+  target_sources(${_target} PRIVATE ${_headers} ${_registry})
+  target_include_directories(${_target} PRIVATE ${DTQ_SHADER_OUTPUT_DIR})
+endfunction()
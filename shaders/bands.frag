@@ -0,0 +1,11 @@
+#version 450
+
+layout(constant_id = 0) const uint bandCount = 16;
+
+layout(location = 0) in vec2 inUv;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+  uint band = min(uint(inUv.y * float(bandCount)), bandCount - 1u);
+  outColor = vec4(band & 1u, (band >> 1u) & 1u, (band >> 2u) & 1u, 1.0f);
+}
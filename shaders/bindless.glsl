@@ -0,0 +1,28 @@
+// the BindlessHeap set (src/bindless.hpp), include from any shader that takes
+// resources by handle (#extension GL_GOOGLE_include_directive); handles
+// usually arrive through push constants
+#ifndef DTQ_BINDLESS_GLSL
+#define DTQ_BINDLESS_GLSL
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform texture2D bindlessTextures[];
+layout(set = 0, binding = 2) uniform sampler bindlessSamplers[];
+
+// storage buffers need a block per element type:
+//   BINDLESS_STORAGE_BUFFER(Particles, { Particle particles[]; });
+//   ... bindlessParticles[handle].particles[i]
+#define BINDLESS_STORAGE_BUFFER(Name, Body) \
+  layout(set = 0, binding = 1, std430) buffer Bindless##Name Body \
+    bindless##Name[]
+
+// nonuniformEXT when the handle may differ across the invocations of a draw
+#define BINDLESS_SAMPLE(textureHandle, samplerHandle, uv) \
+  texture( \
+    sampler2D( \
+      bindlessTextures[textureHandle], bindlessSamplers[samplerHandle] \
+    ) \
+  , uv \
+  )
+
+#endif
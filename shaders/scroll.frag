@@ -0,0 +1,37 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+
+// bands.frag scrolled by per-frame constants & tinted by a texture per draw,
+// both reached through the bindless heap by the handles dtq_bench pushes;
+// mirrors DrawConstants & DrawPush in bench.cpp
+layout(constant_id = 0) const uint bandCount = 16;
+
+struct DrawConstants {
+  float scroll; // in bands
+  uint frameIndex;
+};
+BINDLESS_STORAGE_BUFFER(DrawConstants, { DrawConstants constants[]; });
+
+// the same for every invocation of a draw, so no nonuniformEXT
+layout(push_constant) uniform DrawPush {
+  uint textureHandle;
+  uint samplerHandle;
+  uint constantsHandle; // the frame allocator's ring
+  uint constantsIndex;  // of this frame's constants in it
+} draw;
+
+layout(location = 0) in vec2 inUv;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+  DrawConstants constants =
+    bindlessDrawConstants[draw.constantsHandle]
+      .constants[draw.constantsIndex];
+  uint band = uint(inUv.y * float(bandCount) + constants.scroll) % bandCount;
+  vec3 bandColor = vec3(band & 1u, (band >> 1u) & 1u, (band >> 2u) & 1u);
+  vec3 texel =
+    BINDLESS_SAMPLE(draw.textureHandle, draw.samplerHandle, inUv).rgb;
+  outColor = vec4(mix(bandColor, texel, 0.5f), 1.0f);
+}
@@ -0,0 +1,627 @@
+#include "allocator.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+////////////////////////////////////////////////////////////////////////////////
+char const * ToString(MemoryCategory category) {
+  switch (category) {
+    case MemoryCategory::Buffers:   return "buffers";
+    case MemoryCategory::Images:    return "images";
+    case MemoryCategory::Staging:   return "staging";
+    case MemoryCategory::Transient: return "transient";
+    case MemoryCategory::Count: break;
+  }
+  return "unknown";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeviceAllocator::DeviceAllocator(
+  GraphicsContext const & context
+, vk::DeviceSize blockSize_
+)
+: device{context.device.get()}
+, memoryProperties{context.deviceMemoryProperties}
+, blockSize{std::bit_ceil(blockSize_)}
+{
+  auto const & limits = context.deviceProperties.limits;
+  this->bufferImageGranularity = limits.bufferImageGranularity;
+  this->nonCoherentAtomSize = limits.nonCoherentAtomSize;
+  this->maxMemoryAllocationCount = limits.maxMemoryAllocationCount;
+  this->deviceAddress = context.enabledFeatures12.bufferDeviceAddress;
+
+  // small heaps (ei. the 256MiB BAR window) get proportionally small blocks
+  this->stats.heapCount = this->memoryProperties.memoryHeapCount;
+  for (uint32_t i = 0; i < this->memoryProperties.memoryHeapCount; ++ i) {
+    auto const heapSize = this->memoryProperties.memoryHeaps[i].size;
+    this->heapBlockSize[i] =
+      std::clamp(
+        std::bit_floor(heapSize / 8)
+      , vk::DeviceSize { 1024*1024 }
+      , this->blockSize
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeviceAllocator::~DeviceAllocator() {
+  if (this->stats.allocationCount > 0) {
+    spdlog::error(
+      "Allocator destroyed with {} live allocations"
+    , this->stats.allocationCount
+    );
+  }
+
+  for (auto & block : this->blocks) {
+    if (!block) { continue; }
+    FreeDeviceMemory(block->memory, block->size, block->memoryTypeIdx);
+  }
+  this->blocks.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t DeviceAllocator::FindMemoryType(
+  uint32_t memoryTypeBits
+, MemoryUsage usage
+) const {
+  vk::MemoryPropertyFlags required, preferred, avoided;
+  switch (usage) {
+    case MemoryUsage::GpuOnly:
+      required  = vk::MemoryPropertyFlagBits::eDeviceLocal;
+      avoided   = vk::MemoryPropertyFlagBits::eHostVisible;
+    break;
+    case MemoryUsage::CpuToGpu:
+      required  = vk::MemoryPropertyFlagBits::eHostVisible;
+      preferred = vk::MemoryPropertyFlagBits::eHostCoherent;
+      avoided   = vk::MemoryPropertyFlagBits::eHostCached;
+    break;
+    case MemoryUsage::GpuToCpu:
+      required  = vk::MemoryPropertyFlagBits::eHostVisible;
+      preferred =
+        vk::MemoryPropertyFlagBits::eHostCached
+      | vk::MemoryPropertyFlagBits::eHostCoherent;
+    break;
+    case MemoryUsage::CpuOnly:
+      required  =
+        vk::MemoryPropertyFlagBits::eHostVisible
+      | vk::MemoryPropertyFlagBits::eHostCoherent;
+      avoided   = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    break;
+  }
+
+  uint32_t bestMatch = VK_MAX_MEMORY_TYPES;
+  int bestScore = std::numeric_limits<int>::min();
+  for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; ++ i) {
+    if (!(memoryTypeBits & (1u << i))) { continue; }
+
+    auto const flags = this->memoryProperties.memoryTypes[i].propertyFlags;
+    if ((flags & required) != required) { continue; }
+
+    int const score =
+      std::popcount(static_cast<VkMemoryPropertyFlags>(flags & preferred))
+    - std::popcount(static_cast<VkMemoryPropertyFlags>(flags & avoided));
+
+    if (score > bestScore) {
+      bestMatch = i;
+      bestScore = score;
+    }
+  }
+
+  return bestMatch;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::DeviceMemory DeviceAllocator::AllocateDeviceMemory(
+  vk::DeviceSize size
+, uint32_t memoryTypeIdx
+, void** mapped
+, vk::MemoryDedicatedAllocateInfo const * dedicatedInfo
+) {
+  if (this->stats.deviceMemoryCount >= this->maxMemoryAllocationCount) {
+    spdlog::error(
+      "Exceeding maxMemoryAllocationCount ({})"
+    , this->maxMemoryAllocationCount
+    );
+  }
+
+  vk::MemoryAllocateInfo memoryAI;
+  memoryAI.pNext = dedicatedInfo;
+
+  // buffers created with eShaderDeviceAddress need it on their memory
+  vk::MemoryAllocateFlagsInfo flagsAI;
+  if (this->deviceAddress) {
+    flagsAI.flags = vk::MemoryAllocateFlagBits::eDeviceAddress;
+    flagsAI.pNext = dedicatedInfo;
+    memoryAI.pNext = &flagsAI;
+  }
+  memoryAI.allocationSize = size;
+  memoryAI.memoryTypeIndex = memoryTypeIdx;
+
+  auto result = this->device.allocateMemory(memoryAI);
+  if (result.result != vk::Result::eSuccess) {
+    spdlog::error(
+      "Could not allocate {} bytes of memory type {}: {}"
+    , size, memoryTypeIdx, vk::to_string(result.result)
+    );
+    return nullptr;
+  }
+
+  *mapped = nullptr;
+  auto const & memoryType = this->memoryProperties.memoryTypes[memoryTypeIdx];
+  if (memoryType.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+    *mapped =
+      CheckReturn(
+        this->device.mapMemory(result.value, 0, VK_WHOLE_SIZE),
+        "Persistently mapping device memory"
+      );
+  }
+
+  auto & heap = this->stats.heaps[memoryType.heapIndex];
+  heap.reservedBytes += size;
+  heap.peakReservedBytes = std::max(heap.peakReservedBytes, heap.reservedBytes);
+  heap.deviceMemoryCount += 1;
+  this->stats.reservedBytes += size;
+  this->stats.peakReservedBytes =
+    std::max(this->stats.peakReservedBytes, this->stats.reservedBytes);
+  this->stats.deviceMemoryCount += 1;
+
+  return result.value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::FreeDeviceMemory(
+  vk::DeviceMemory memory
+, vk::DeviceSize size
+, uint32_t memoryTypeIdx
+) {
+  // freeing implicitly unmaps
+  this->device.freeMemory(memory);
+
+  auto const & memoryType = this->memoryProperties.memoryTypes[memoryTypeIdx];
+  auto & heap = this->stats.heaps[memoryType.heapIndex];
+  heap.reservedBytes -= size;
+  heap.deviceMemoryCount -= 1;
+  this->stats.reservedBytes -= size;
+  this->stats.deviceMemoryCount -= 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t DeviceAllocator::CreateBlock(
+  uint32_t memoryTypeIdx
+, AllocationStrategy strategy
+) {
+  auto const heapIdx =
+    this->memoryProperties.memoryTypes[memoryTypeIdx].heapIndex;
+
+  auto block = std::make_unique<MemoryBlock>();
+  block->size = this->heapBlockSize[heapIdx];
+  block->strategy = strategy;
+  block->memoryTypeIdx = memoryTypeIdx;
+  block->memory =
+    AllocateDeviceMemory(block->size, memoryTypeIdx, &block->mapped, nullptr);
+
+  if (!block->memory) { return std::numeric_limits<uint32_t>::max(); }
+
+  if (strategy == AllocationStrategy::Buddy) {
+    auto const maxOrder =
+      static_cast<size_t>(std::countr_zero(block->size / minBuddySize));
+    block->buddyFreeLists.resize(maxOrder + 1);
+    block->buddyFreeLists[maxOrder].insert(0);
+  }
+
+  // reuse a released slot so live allocations keep their indices
+  for (uint32_t i = 0; i < this->blocks.size(); ++ i) {
+    if (!this->blocks[i]) {
+      this->blocks[i] = std::move(block);
+      return i;
+    }
+  }
+
+  this->blocks.emplace_back(std::move(block));
+  return static_cast<uint32_t>(this->blocks.size() - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::ReleaseBlockIfRedundant(uint32_t blockIdx) {
+  auto & block = *this->blocks[blockIdx];
+  if (block.liveAllocations > 0) { return; }
+
+  // keep a single empty block per type & strategy around to avoid thrashing
+  for (uint32_t i = 0; i < this->blocks.size(); ++ i) {
+    auto const & other = this->blocks[i];
+    if (i == blockIdx || !other) { continue; }
+    if (other->memoryTypeIdx == block.memoryTypeIdx
+     && other->strategy == block.strategy
+     && other->liveAllocations == 0
+    ) {
+      FreeDeviceMemory(block.memory, block.size, block.memoryTypeIdx);
+      this->blocks[blockIdx].reset();
+      return;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool DeviceAllocator::AllocateFromBlock(
+  uint32_t blockIdx
+, vk::DeviceSize size
+, vk::DeviceSize alignment
+, Allocation & allocation
+) {
+  auto & block = *this->blocks[blockIdx];
+
+  if (block.strategy == AllocationStrategy::Linear) {
+    auto const offset = AlignUp(block.linearHead, alignment);
+    if (offset + size > block.size) { return false; }
+    block.linearHead = offset + size;
+    allocation.offset = offset;
+  } else {
+    // buddy offsets are aligned to their own power-of-two size
+    auto const needed =
+      std::bit_ceil(std::max({size, alignment, minBuddySize}));
+    auto const order =
+      static_cast<uint32_t>(std::countr_zero(needed / minBuddySize));
+
+    auto & freeLists = block.buddyFreeLists;
+    uint32_t available = order;
+    while (available < freeLists.size() && freeLists[available].empty())
+      { ++ available; }
+    if (available >= freeLists.size()) { return false; }
+
+    auto const offset = *freeLists[available].begin();
+    freeLists[available].erase(freeLists[available].begin());
+
+    // split down, returning the upper halves to the free lists
+    while (available > order) {
+      -- available;
+      freeLists[available].insert(offset + (minBuddySize << available));
+    }
+
+    allocation.offset = offset;
+    allocation.order = order;
+  }
+
+  block.liveAllocations += 1;
+  allocation.memory = block.memory;
+  allocation.blockIdx = blockIdx;
+  allocation.mapped =
+    block.mapped
+  ? static_cast<char*>(block.mapped) + allocation.offset
+  : nullptr;
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Allocation DeviceAllocator::Allocate(
+  vk::MemoryRequirements const & requirements
+, AllocationCreateInfo const & ci
+, vk::MemoryDedicatedAllocateInfo const * dedicatedInfo
+) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  Allocation allocation;
+  allocation.size = requirements.size;
+  allocation.memoryTypeIdx =
+    FindMemoryType(requirements.memoryTypeBits, ci.usage);
+
+  if (allocation.memoryTypeIdx == VK_MAX_MEMORY_TYPES) {
+    spdlog::error(
+      "No memory type for bits {:#x} usage {}"
+    , requirements.memoryTypeBits, static_cast<int>(ci.usage)
+    );
+    return Allocation {};
+  }
+
+  auto const heapIdx =
+    this->memoryProperties.memoryTypes[allocation.memoryTypeIdx].heapIndex;
+
+  allocation.strategy = ci.strategy;
+  allocation.category = ci.category.value_or(MemoryCategory::Buffers);
+  if (dedicatedInfo || requirements.size > this->heapBlockSize[heapIdx]/2)
+    { allocation.strategy = AllocationStrategy::Dedicated; }
+
+  if (allocation.strategy == AllocationStrategy::Dedicated) {
+    allocation.memory =
+      AllocateDeviceMemory(
+        requirements.size
+      , allocation.memoryTypeIdx
+      , &allocation.mapped
+      , dedicatedInfo
+      );
+    if (!allocation.memory) { return Allocation {}; }
+    allocation.blockIdx = std::numeric_limits<uint32_t>::max();
+    this->stats.dedicatedCount += 1;
+  } else {
+    // padding to the granularity keeps linear & optimal resources that share
+    // a block from ever aliasing the same page
+    auto const alignment =
+      std::max(requirements.alignment, this->bufferImageGranularity);
+    auto const size = AlignUp(requirements.size, this->bufferImageGranularity);
+
+    bool allocated = false;
+    for (uint32_t i = 0; i < this->blocks.size() && !allocated; ++ i) {
+      auto const & block = this->blocks[i];
+      if (!block
+       || block->memoryTypeIdx != allocation.memoryTypeIdx
+       || block->strategy != allocation.strategy
+      ) {
+        continue;
+      }
+      allocated = AllocateFromBlock(i, size, alignment, allocation);
+    }
+
+    if (!allocated) {
+      auto const blockIdx =
+        CreateBlock(allocation.memoryTypeIdx, allocation.strategy);
+      if (blockIdx == std::numeric_limits<uint32_t>::max()
+       || !AllocateFromBlock(blockIdx, size, alignment, allocation)
+      ) {
+        spdlog::error("Could not sub-allocate {} bytes", requirements.size);
+        return Allocation {};
+      }
+    }
+  }
+
+  auto & heap = this->stats.heaps[heapIdx];
+  heap.allocatedBytes += allocation.size;
+  heap.peakAllocatedBytes =
+    std::max(heap.peakAllocatedBytes, heap.allocatedBytes);
+  heap.allocationCount += 1;
+
+  auto & category =
+    this->stats.categories[static_cast<size_t>(allocation.category)];
+  category.allocatedBytes += allocation.size;
+  category.peakAllocatedBytes =
+    std::max(category.peakAllocatedBytes, category.allocatedBytes);
+  category.allocationCount += 1;
+
+  this->stats.allocatedBytes += allocation.size;
+  this->stats.peakAllocatedBytes =
+    std::max(this->stats.peakAllocatedBytes, this->stats.allocatedBytes);
+  this->stats.allocationCount += 1;
+
+  return allocation;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::Free(Allocation & allocation) {
+  if (!allocation.memory) { return; }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  auto const heapIdx =
+    this->memoryProperties.memoryTypes[allocation.memoryTypeIdx].heapIndex;
+  auto & heap = this->stats.heaps[heapIdx];
+  heap.allocatedBytes -= allocation.size;
+  heap.allocationCount -= 1;
+  auto & category =
+    this->stats.categories[static_cast<size_t>(allocation.category)];
+  category.allocatedBytes -= allocation.size;
+  category.allocationCount -= 1;
+  this->stats.allocatedBytes -= allocation.size;
+  this->stats.allocationCount -= 1;
+
+  if (allocation.strategy == AllocationStrategy::Dedicated) {
+    FreeDeviceMemory(
+      allocation.memory, allocation.size, allocation.memoryTypeIdx
+    );
+    this->stats.dedicatedCount -= 1;
+    allocation = Allocation {};
+    return;
+  }
+
+  auto & block = *this->blocks[allocation.blockIdx];
+  block.liveAllocations -= 1;
+
+  if (block.strategy == AllocationStrategy::Linear) {
+    if (block.liveAllocations == 0) { block.linearHead = 0; }
+  } else {
+    // merge with free buddies as far up as possible
+    auto & freeLists = block.buddyFreeLists;
+    auto offset = allocation.offset;
+    auto order = allocation.order;
+    while (order+1 < freeLists.size()) {
+      auto const buddy = offset ^ (minBuddySize << order);
+      if (freeLists[order].erase(buddy) == 0) { break; }
+      offset = std::min(offset, buddy);
+      ++ order;
+    }
+    freeLists[order].insert(offset);
+  }
+
+  ReleaseBlockIfRedundant(allocation.blockIdx);
+  allocation = Allocation {};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::Flush(
+  Allocation const & allocation
+, vk::DeviceSize offset
+, vk::DeviceSize size
+) {
+  auto const & memoryType =
+    this->memoryProperties.memoryTypes[allocation.memoryTypeIdx];
+  if (memoryType.propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent)
+    { return; }
+
+  if (size == VK_WHOLE_SIZE) { size = allocation.size - offset; }
+  auto const end =
+    AlignUp(allocation.offset + offset + size, this->nonCoherentAtomSize);
+
+  vk::MappedMemoryRange range;
+  range.memory = allocation.memory;
+  range.offset =
+    AlignDown(allocation.offset + offset, this->nonCoherentAtomSize);
+  // a dedicated allocation's size needn't be a multiple of the atom size
+  range.size =
+    allocation.strategy == AllocationStrategy::Dedicated
+ && end > allocation.offset + allocation.size
+  ? VK_WHOLE_SIZE
+  : end - range.offset;
+  this->device.flushMappedMemoryRanges(range);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::Invalidate(Allocation const & allocation) {
+  auto const & memoryType =
+    this->memoryProperties.memoryTypes[allocation.memoryTypeIdx];
+  if (memoryType.propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent)
+    { return; }
+
+  vk::MappedMemoryRange range;
+  range.memory = allocation.memory;
+  range.offset = AlignDown(allocation.offset, this->nonCoherentAtomSize);
+  range.size =
+    allocation.strategy == AllocationStrategy::Dedicated
+  ? VK_WHOLE_SIZE
+  : AlignUp(allocation.offset + allocation.size, this->nonCoherentAtomSize)
+  - range.offset;
+  this->device.invalidateMappedMemoryRanges(range);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+AllocatorStats DeviceAllocator::Stats() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::LogStats() {
+  auto const stats = this->Stats();
+  spdlog::info(
+    "Allocator: {} allocations ({} dedicated) {} MiB in {} MiB over {} "
+    "device memories"
+  , stats.allocationCount, stats.dedicatedCount
+  , stats.allocatedBytes/(1024*1024), stats.reservedBytes/(1024*1024)
+  , stats.deviceMemoryCount
+  );
+  spdlog::info(
+    "\tPeak {} MiB in {} MiB"
+  , stats.peakAllocatedBytes/(1024*1024), stats.peakReservedBytes/(1024*1024)
+  );
+  for (uint32_t i = 0; i < stats.heapCount; ++ i) {
+    auto const & heap = stats.heaps[i];
+    spdlog::info(
+      "\tHeap {} {} allocations {} MiB in {} MiB, peak {} MiB in {} MiB"
+    , i, heap.allocationCount
+    , heap.allocatedBytes/(1024*1024), heap.reservedBytes/(1024*1024)
+    , heap.peakAllocatedBytes/(1024*1024), heap.peakReservedBytes/(1024*1024)
+    );
+  }
+  for (size_t i = 0; i < memoryCategoryCount; ++ i) {
+    auto const & category = stats.categories[i];
+    spdlog::info(
+      "\t{} {} allocations {} MiB, peak {} MiB"
+    , ToString(static_cast<MemoryCategory>(i)), category.allocationCount
+    , category.allocatedBytes/(1024*1024)
+    , category.peakAllocatedBytes/(1024*1024)
+    );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Buffer DeviceAllocator::CreateBuffer(
+  vk::BufferCreateInfo const & bufferCI
+, AllocationCreateInfo const & ci
+) {
+  Buffer self;
+  self.buffer =
+    CheckReturn(this->device.createBuffer(bufferCI), "Creating buffer");
+
+  auto const requirements =
+    this->device.getBufferMemoryRequirements2<
+      vk::MemoryRequirements2, vk::MemoryDedicatedRequirements
+    >(vk::BufferMemoryRequirementsInfo2 { self.buffer });
+  auto const & dedicated =
+    requirements.get<vk::MemoryDedicatedRequirements>();
+
+  vk::MemoryDedicatedAllocateInfo dedicatedAI;
+  dedicatedAI.buffer = self.buffer;
+
+  // transients stay linear unless the driver insists
+  bool const useDedicated =
+    dedicated.requiresDedicatedAllocation
+ || (dedicated.prefersDedicatedAllocation
+  && ci.strategy != AllocationStrategy::Linear);
+
+  auto categorized = ci;
+  if (!categorized.category) { categorized.category = MemoryCategory::Buffers; }
+
+  self.allocation =
+    this->Allocate(
+      requirements.get<vk::MemoryRequirements2>().memoryRequirements
+    , categorized
+    , useDedicated ? &dedicatedAI : nullptr
+    );
+
+  if (self.allocation.memory) {
+    this->device.bindBufferMemory(
+      self.buffer, self.allocation.memory, self.allocation.offset
+    );
+  }
+
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::DestroyBuffer(Buffer & buffer) {
+  this->device.destroyBuffer(buffer.buffer);
+  this->Free(buffer.allocation);
+  buffer = Buffer {};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Image DeviceAllocator::CreateImage(
+  vk::ImageCreateInfo const & imageCI
+, AllocationCreateInfo const & ci
+) {
+  Image self;
+  self.image =
+    CheckReturn(this->device.createImage(imageCI), "Creating image");
+
+  auto const requirements =
+    this->device.getImageMemoryRequirements2<
+      vk::MemoryRequirements2, vk::MemoryDedicatedRequirements
+    >(vk::ImageMemoryRequirementsInfo2 { self.image });
+  auto const & dedicated =
+    requirements.get<vk::MemoryDedicatedRequirements>();
+
+  vk::MemoryDedicatedAllocateInfo dedicatedAI;
+  dedicatedAI.image = self.image;
+
+  bool const useDedicated =
+    dedicated.requiresDedicatedAllocation
+ || (dedicated.prefersDedicatedAllocation
+  && ci.strategy != AllocationStrategy::Linear);
+
+  auto categorized = ci;
+  if (!categorized.category) { categorized.category = MemoryCategory::Images; }
+
+  self.allocation =
+    this->Allocate(
+      requirements.get<vk::MemoryRequirements2>().memoryRequirements
+    , categorized
+    , useDedicated ? &dedicatedAI : nullptr
+    );
+
+  if (self.allocation.memory) {
+    this->device.bindImageMemory(
+      self.image, self.allocation.memory, self.allocation.offset
+    );
+  }
+
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeviceAllocator::DestroyImage(Image & image) {
+  this->device.destroyImage(image.image);
+  this->Free(image.allocation);
+  image = Image {};
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+enum class MemoryUsage {
+  GpuOnly,  // device local, never mapped
+  CpuToGpu, // host visible, written by the CPU each frame or for staging
+  GpuToCpu, // host visible & preferably cached, for readback
+  CpuOnly,  // host visible, avoids device local heaps
+};
+
+////////////////////////////////////////////////////////////////////////////////
+enum class AllocationStrategy {
+  // bump allocated, the block rewinds once every allocation in it is freed;
+  // suits per-frame transients that are all released together
+  Linear,
+  // power-of-two buddy blocks, for long-lived resources of mixed sizes
+  Buddy,
+  // one vkAllocateMemory per resource, for huge images or when the driver
+  // asks for it through VkMemoryDedicatedRequirements
+  Dedicated,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// what an allocation is for, accounted separately in AllocatorStats
+enum class MemoryCategory : uint32_t {
+  Buffers,
+  Images,
+  Staging,   // host visible rings for uploads & readback
+  // aliased or recycled within a frame, ei. render graph attachments & the
+  // FrameAllocator's per-frame ring
+  Transient,
+  Count
+};
+
+inline constexpr size_t memoryCategoryCount =
+  static_cast<size_t>(MemoryCategory::Count);
+
+char const * ToString(MemoryCategory category);
+
+////////////////////////////////////////////////////////////////////////////////
+struct AllocationCreateInfo {
+  MemoryUsage usage = MemoryUsage::GpuOnly;
+  AllocationStrategy strategy = AllocationStrategy::Buddy;
+  // host visible allocations are always persistently mapped
+  // defaults to Buffers or Images for CreateBuffer & CreateImage
+  std::optional<MemoryCategory> category;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct Allocation {
+  vk::DeviceMemory memory;
+  vk::DeviceSize   offset = 0;
+  vk::DeviceSize   size   = 0;
+  void*            mapped = nullptr; // already offset to this allocation
+
+  uint32_t memoryTypeIdx = VK_MAX_MEMORY_TYPES;
+  AllocationStrategy strategy = AllocationStrategy::Buddy;
+  MemoryCategory category = MemoryCategory::Buffers;
+
+  // -- internal bookkeeping
+  uint32_t blockIdx = 0;
+  uint32_t order    = 0; // buddy order, size is minBuddySize << order
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// the peak* fields are high-water marks since the allocator was created
+struct AllocatorStats {
+  struct Heap {
+    vk::DeviceSize reservedBytes  = 0; // sum of vkAllocateMemory sizes
+    vk::DeviceSize allocatedBytes = 0; // handed out to resources
+    vk::DeviceSize peakReservedBytes  = 0;
+    vk::DeviceSize peakAllocatedBytes = 0;
+    uint32_t deviceMemoryCount = 0;
+    uint32_t allocationCount   = 0;
+  };
+
+  struct Category {
+    vk::DeviceSize allocatedBytes = 0;
+    vk::DeviceSize peakAllocatedBytes = 0;
+    uint32_t allocationCount = 0;
+  };
+
+  std::array<Heap, VK_MAX_MEMORY_HEAPS> heaps {};
+  uint32_t heapCount = 0;
+
+  std::array<Category, memoryCategoryCount> categories {};
+
+  vk::DeviceSize reservedBytes  = 0;
+  vk::DeviceSize allocatedBytes = 0;
+  vk::DeviceSize peakReservedBytes  = 0;
+  vk::DeviceSize peakAllocatedBytes = 0;
+  uint32_t deviceMemoryCount = 0;
+  uint32_t allocationCount   = 0;
+  uint32_t dedicatedCount    = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct Buffer {
+  vk::Buffer buffer;
+  Allocation allocation;
+};
+
+struct Image {
+  vk::Image  image;
+  Allocation allocation;
+};
+
+// sub-allocates device memory out of large blocks per memory type, so
+// resources never approach maxMemoryAllocationCount; thread safe
+class DeviceAllocator {
+private:
+  struct MemoryBlock {
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    void* mapped = nullptr;
+    AllocationStrategy strategy = AllocationStrategy::Buddy;
+    uint32_t memoryTypeIdx = 0;
+    uint32_t liveAllocations = 0;
+
+    vk::DeviceSize linearHead = 0;
+    std::vector<std::set<vk::DeviceSize>> buddyFreeLists; // offsets per order
+  };
+
+  vk::Device device;
+  vk::PhysicalDeviceMemoryProperties memoryProperties;
+  vk::DeviceSize bufferImageGranularity = 1;
+  vk::DeviceSize nonCoherentAtomSize = 1;
+  uint32_t maxMemoryAllocationCount = 0;
+  // bufferDeviceAddress is enabled, every device memory can back one
+  bool deviceAddress = false;
+
+  vk::DeviceSize blockSize;
+  std::array<vk::DeviceSize, VK_MAX_MEMORY_HEAPS> heapBlockSize {};
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<MemoryBlock>> blocks; // null entries are free
+  AllocatorStats stats;
+
+  vk::DeviceMemory AllocateDeviceMemory(
+    vk::DeviceSize size
+  , uint32_t memoryTypeIdx
+  , void** mapped
+  , vk::MemoryDedicatedAllocateInfo const * dedicatedInfo
+  );
+  void FreeDeviceMemory(
+    vk::DeviceMemory memory
+  , vk::DeviceSize size
+  , uint32_t memoryTypeIdx
+  );
+  uint32_t CreateBlock(uint32_t memoryTypeIdx, AllocationStrategy strategy);
+  void ReleaseBlockIfRedundant(uint32_t blockIdx);
+  bool AllocateFromBlock(
+    uint32_t blockIdx
+  , vk::DeviceSize size
+  , vk::DeviceSize alignment
+  , Allocation & allocation
+  );
+
+public:
+  static constexpr vk::DeviceSize minBuddySize = 256;
+
+  DeviceAllocator(
+    GraphicsContext const & context
+  , vk::DeviceSize blockSize = 64ull*1024ull*1024ull
+  );
+  ~DeviceAllocator();
+  DeviceAllocator(DeviceAllocator const &) = delete;
+  DeviceAllocator(DeviceAllocator &&) = delete;
+
+  // returns an allocation with a null memory on failure; dedicatedInfo is
+  // forwarded when the driver requires or prefers a dedicated allocation
+  Allocation Allocate(
+    vk::MemoryRequirements const & requirements
+  , AllocationCreateInfo const & ci
+  , vk::MemoryDedicatedAllocateInfo const * dedicatedInfo = nullptr
+  );
+  void Free(Allocation & allocation);
+
+  // the type Allocate picks, VK_MAX_MEMORY_TYPES if none fits; ei. to tell
+  // which heap a resource will land in before creating it
+  uint32_t FindMemoryType(uint32_t memoryTypeBits, MemoryUsage usage) const;
+
+  // only required for memory types without eHostCoherent; offset & size are
+  // relative to the allocation, the default being all of it
+  void Flush(
+    Allocation const & allocation
+  , vk::DeviceSize offset = 0
+  , vk::DeviceSize size = VK_WHOLE_SIZE
+  );
+  void Invalidate(Allocation const & allocation);
+
+  AllocatorStats Stats();
+  void LogStats();
+
+  Buffer CreateBuffer(
+    vk::BufferCreateInfo const & bufferCI
+  , AllocationCreateInfo const & ci
+  );
+  void DestroyBuffer(Buffer & buffer);
+
+  Image CreateImage(
+    vk::ImageCreateInfo const & imageCI
+  , AllocationCreateInfo const & ci
+  );
+  void DestroyImage(Image & image);
+};
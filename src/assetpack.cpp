@@ -0,0 +1,266 @@
+#include "assetpack.hpp"
+
+#include "util.hpp"
+
+#include "upload.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+bool InRange(uint64_t offset, uint64_t size, uint64_t total) {
+  return offset <= total && size <= total - offset;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// whether the image's mip chain fits its data; PackMipSize & PackMipOffset
+// wrap for hostile extents & texel sizes, so each level is checked against
+// dataSize before it's multiplied out & summed
+bool ImageLevelsFit(PackEntry const & entry) {
+  if (entry.mipLevels == 0 || entry.mipLevels > 32 || entry.texelSize == 0)
+    { return false; }
+
+  uint64_t chain = 0;
+  for (uint32_t level = 0; level < entry.mipLevels; ++ level) {
+    // extents are 32 bit, their product can't wrap
+    uint64_t const texels =
+      uint64_t(PackMipExtent(entry.width, level))
+    * PackMipExtent(entry.height, level);
+    if (texels > entry.dataSize / entry.texelSize) { return false; }
+    chain += texels * entry.texelSize;
+    if (chain > entry.dataSize) { return false; }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// madvise wants page aligned addresses, widen [data, data+size) to pages
+void Advise(std::byte const * data, size_t size, int advice) {
+  if (size == 0) { return; }
+  auto const page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  auto const begin = reinterpret_cast<uintptr_t>(data) & ~(page - 1);
+  auto const end = reinterpret_cast<uintptr_t>(data) + size;
+  madvise(reinterpret_cast<void*>(begin), end - begin, advice);
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+AssetPack::AssetPack(std::string path_) : path{std::move(path_)} {
+  int const fd = open(this->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    spdlog::error("Could not open asset pack '{}'", this->path);
+    return;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(PackHeader)) {
+    spdlog::error("Asset pack '{}' is too small", this->path);
+    close(fd);
+    return;
+  }
+
+  // the mapping holds its own reference to the file
+  this->mappingSize = size_t(info.st_size);
+  void * const mapped =
+    mmap(nullptr, this->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    spdlog::error("Could not map asset pack '{}'", this->path);
+    this->mappingSize = 0;
+    return;
+  }
+
+  this->mapping = static_cast<std::byte const *>(mapped);
+  this->header = reinterpret_cast<PackHeader const *>(this->mapping);
+  if (!this->Validate()) {
+    this->Close();
+    return;
+  }
+
+  this->entries =
+    reinterpret_cast<PackEntry const *>(
+      this->mapping + this->header->indexOffset
+    );
+  this->names =
+    reinterpret_cast<char const *>(this->mapping + this->header->namesOffset);
+
+  // the index is read on every lookup, entry data is read front to back once
+  // per upload, don't read ahead much past it
+  Advise(
+    this->mapping
+  , this->header->namesOffset + this->header->namesSize
+  , MADV_WILLNEED
+  );
+
+  spdlog::info(
+    "Mapped asset pack '{}', {} entries in {} bytes"
+  , this->path, this->header->entryCount, this->mappingSize
+  );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool AssetPack::Validate() const {
+  auto const & hdr = *this->header;
+  auto const fail = [this](char const * reason) {
+    spdlog::error("Asset pack '{}' is invalid, {}", this->path, reason);
+    return false;
+  };
+
+  if (std::memcmp(hdr.magic, packMagic, sizeof(packMagic)) != 0)
+    { return fail("bad magic"); }
+  if (hdr.version != packVersion) {
+    spdlog::error(
+      "Asset pack '{}' is version {}, expected {}"
+    , this->path, hdr.version, packVersion
+    );
+    return false;
+  }
+  if (hdr.fileSize != this->mappingSize) { return fail("truncated"); }
+  if (hdr.dataAlignment == 0 || (hdr.dataAlignment & (hdr.dataAlignment-1)))
+    { return fail("data alignment isn't a power of two"); }
+  if (
+      hdr.indexOffset % alignof(PackEntry) != 0
+   || !InRange(
+        hdr.indexOffset, uint64_t(hdr.entryCount) * sizeof(PackEntry)
+      , this->mappingSize
+      )
+  ) {
+    return fail("index out of bounds");
+  }
+  if (!InRange(hdr.namesOffset, hdr.namesSize, this->mappingSize))
+    { return fail("name table out of bounds"); }
+
+  auto const * index =
+    reinterpret_cast<PackEntry const *>(this->mapping + hdr.indexOffset);
+  for (uint32_t i = 0; i < hdr.entryCount; ++ i) {
+    auto const & entry = index[i];
+    if (i > 0 && index[i-1].nameHash > entry.nameHash)
+      { return fail("index isn't sorted"); }
+    if (!InRange(entry.nameOffset, entry.nameLength, hdr.namesSize))
+      { return fail("entry name out of bounds"); }
+    if (
+        entry.dataOffset % hdr.dataAlignment != 0
+     || !InRange(entry.dataOffset, entry.dataSize, this->mappingSize)
+    ) {
+      return fail("entry data out of bounds");
+    }
+    if (entry.kind == PackEntryKind::Image && !ImageLevelsFit(entry))
+      { return fail("image levels overrun its data"); }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AssetPack::Close() {
+  if (this->mapping) {
+    munmap(const_cast<std::byte *>(this->mapping), this->mappingSize);
+  }
+  this->mapping = nullptr;
+  this->mappingSize = 0;
+  this->header = nullptr;
+  this->entries = nullptr;
+  this->names = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string_view AssetPack::Name(PackEntry const & entry) const {
+  return std::string_view(this->names + entry.nameOffset, entry.nameLength);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PackEntry const * AssetPack::Find(std::string_view name) const {
+  if (!this->IsOpen()) { return nullptr; }
+
+  uint64_t const hash = PackHash(name);
+  auto const * end = this->entries + this->header->entryCount;
+  auto const * it =
+    std::lower_bound(
+      this->entries, end, hash
+    , [](PackEntry const & entry, uint64_t h) { return entry.nameHash < h; }
+    );
+  // collisions are adjacent
+  for (; it != end && it->nameHash == hash; ++ it) {
+    if (this->Name(*it) == name) { return it; }
+  }
+  return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::span<std::byte const> AssetPack::Data(PackEntry const & entry) const {
+  return { this->mapping + entry.dataOffset, size_t(entry.dataSize) };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::span<std::byte const> AssetPack::MipData(
+  PackEntry const & entry
+, uint32_t level
+) const {
+  return {
+    this->mapping + entry.dataOffset + PackMipOffset(entry, level)
+  , size_t(PackMipSize(entry, level))
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AssetPack::Prefetch(PackEntry const & entry) const {
+  auto const data = this->Data(entry);
+  Advise(data.data(), data.size(), MADV_WILLNEED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AssetPack::Evict(PackEntry const & entry) const {
+  // the mapping is read-only & file backed, dropped pages just fault back in
+  auto const data = this->Data(entry);
+  Advise(data.data(), data.size(), MADV_DONTNEED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AssetPack::UploadBuffer(
+  UploadEngine & uploads
+, PackEntry const & entry
+, vk::Buffer const & dst
+, vk::DeviceSize dstOffset
+) const {
+  // memcpys from the mapping into the staging ring, in chunks when the entry
+  // is larger than it
+  auto const data = this->Data(entry);
+  uploads.UploadBuffer(dst, dstOffset, data.data(), data.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AssetPack::UploadImage(
+  UploadEngine & uploads
+, PackEntry const & entry
+, vk::Image const & dst
+, uint32_t firstMip
+, vk::ImageLayout finalLayout
+) const {
+  if (entry.kind != PackEntryKind::Image) {
+    spdlog::error("Asset '{}' isn't an image", this->Name(entry));
+    return;
+  }
+
+  for (uint32_t level = firstMip; level < entry.mipLevels; ++ level) {
+    vk::BufferImageCopy copy;
+    copy.imageSubresource =
+      vk::ImageSubresourceLayers {
+        vk::ImageAspectFlagBits::eColor, level - firstMip, 0, 1
+      };
+    copy.imageExtent =
+      vk::Extent3D {
+        PackMipExtent(entry.width, level), PackMipExtent(entry.height, level)
+      , 1
+      };
+
+    auto const data = this->MipData(entry, level);
+    uploads.UploadImage(dst, copy, data.data(), data.size(), finalLayout);
+  }
+}
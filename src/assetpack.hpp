@@ -0,0 +1,72 @@
+#pragma once
+
+#include "packformat.hpp"
+#include "vulkan.hpp"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+class UploadEngine; // -- fwd decl
+
+// a pack written by dtq_pack, memory mapped read-only. Nothing is read up
+// front besides the index, entry data is paged in as it's touched & uploads
+// copy straight from the mapping into UploadEngine's staging ring, so there
+// are no intermediate heap copies & only what's being uploaded is resident.
+// POSIX only. Thread safe once open, the mapping is never written.
+class AssetPack {
+private:
+  std::string path;
+  std::byte const * mapping = nullptr;
+  size_t mappingSize = 0;
+
+  PackHeader const * header = nullptr;
+  PackEntry const * entries = nullptr;
+  char const * names = nullptr;
+
+  bool Validate() const;
+  void Close();
+
+public:
+  explicit AssetPack(std::string path_);
+  ~AssetPack() { Close(); }
+  AssetPack(AssetPack const &) = delete;
+  AssetPack(AssetPack &&) = delete;
+
+  // false if the pack couldn't be mapped or failed validation
+  bool IsOpen() const { return mapping != nullptr; }
+
+  uint32_t EntryCount() const { return header ? header->entryCount : 0; }
+  PackEntry const & Entry(uint32_t idx) const { return entries[idx]; }
+  std::string_view Name(PackEntry const & entry) const;
+
+  // null if no entry has the name
+  PackEntry const * Find(std::string_view name) const;
+
+  // a view into the mapping, valid as long as the pack is open
+  std::span<std::byte const> Data(PackEntry const & entry) const;
+  std::span<std::byte const> MipData(PackEntry const & entry, uint32_t level)
+    const;
+
+  // hints the kernel to read entry ahead of an upload, or that its pages can
+  // be dropped from the resident set once uploaded
+  void Prefetch(PackEntry const & entry) const;
+  void Evict(PackEntry const & entry) const;
+
+  // queue the copy of a blob into dst, or of an image's levels from firstMip
+  // on into dst's levels from 0, both on uploads; the caller flushes
+  void UploadBuffer(
+    UploadEngine & uploads
+  , PackEntry const & entry
+  , vk::Buffer const & dst
+  , vk::DeviceSize dstOffset = 0
+  ) const;
+  void UploadImage(
+    UploadEngine & uploads
+  , PackEntry const & entry
+  , vk::Image const & dst
+  , uint32_t firstMip = 0
+  , vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+  ) const;
+};
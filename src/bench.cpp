@@ -0,0 +1,1516 @@
+#include "util.hpp"
+#include "assetpack.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "frame.hpp"
+#include "glfw.hpp"
+#include "graphicscontext.hpp"
+#include "jobs.hpp"
+#include "memorytelemetry.hpp"
+#include "offscreen.hpp"
+#include "pacing.hpp"
+#include "packwriter.hpp"
+#include "pipeline.hpp"
+#include "recorder.hpp"
+#include "rendergraph.hpp"
+#include "shaders.hpp"
+#include "swapchain.hpp"
+#include "texturestream.hpp"
+#include "upload.hpp"
+
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// runs each scenario for a fixed number of frames, sweeping frames in flight
+// (and present modes when windowed), and writes one JSON object per run to
+// stdout or --output; logging goes to stderr. Headless by default, so it runs
+// on a software ICD, ei. VK_ICD_FILENAMES=.../lvp_icd.x86_64.json dtq_bench
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+enum class Scenario {
+  Clear,     // an empty render pass, the demo's original loop
+  ManyDraws, // thousands of small draws, culled & recorded in parallel
+  Upload,    // streams a buffer through the transfer queue every frame
+  Compute,   // ALU bound dispatches on the async compute queue
+  Stream,    // a packed texture set streamed in & out under a tight budget
+  Graph,     // aliased transients & a culled pass, checked against what the
+             // render graph should derive for them
+};
+
+constexpr std::array<std::pair<Scenario, std::string_view>, 6> scenarioNames {{
+  { Scenario::Clear,     "clear"   },
+  { Scenario::ManyDraws, "draws"   },
+  { Scenario::Upload,    "upload"  },
+  { Scenario::Compute,   "compute" },
+  { Scenario::Stream,    "stream"  },
+  { Scenario::Graph,     "graph"   },
+}};
+
+constexpr std::array<std::pair<vk::PresentModeKHR, std::string_view>, 4>
+  presentModeNames {{
+    { vk::PresentModeKHR::eFifo,        "fifo"         },
+    { vk::PresentModeKHR::eFifoRelaxed, "fifo-relaxed" },
+    { vk::PresentModeKHR::eMailbox,     "mailbox"      },
+    { vk::PresentModeKHR::eImmediate,   "immediate"    },
+  }};
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, size_t N>
+std::optional<T> FromName(
+  std::array<std::pair<T, std::string_view>, N> const & names
+, std::string_view name
+) {
+  for (auto const & [value, valueName] : names)
+    { if (valueName == name) { return value; } }
+  return std::nullopt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, size_t N>
+std::string_view ToName(
+  std::array<std::pair<T, std::string_view>, N> const & names
+, T value
+) {
+  for (auto const & [namedValue, name] : names)
+    { if (namedValue == value) { return name; } }
+  return "?";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<std::string_view> SplitList(std::string_view list) {
+  std::vector<std::string_view> items;
+  while (!list.empty()) {
+    auto const comma = list.find(',');
+    items.emplace_back(list.substr(0, comma));
+    if (comma == std::string_view::npos) { break; }
+    list.remove_prefix(comma + 1);
+  }
+  return items;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct BenchOptions {
+  uint64_t frames = 600;
+  uint64_t warmupFrames = 60; // run before measuring, not reported
+  std::vector<Scenario> scenarios {
+    Scenario::Clear, Scenario::ManyDraws, Scenario::Upload, Scenario::Compute
+  , Scenario::Stream, Scenario::Graph
+  };
+  std::vector<uint32_t> framesInFlight { 1, 2, 3 };
+  bool windowed = false;
+  std::vector<vk::PresentModeKHR> presentModes {
+    vk::PresentModeKHR::eFifo
+  , vk::PresentModeKHR::eMailbox
+  , vk::PresentModeKHR::eImmediate
+  };
+  std::string outputPath; // stdout if empty
+  glm::uvec2 extent { 1280, 720 };
+
+  uint32_t drawCount = 4096;
+  vk::DeviceSize uploadBytes = 8ull*1024ull*1024ull;
+  uint32_t computeGroups = 1024;
+  // the streamed set is generated & packed for the run; the budget holds
+  // about a third of it at full resolution
+  uint32_t streamTextures = 32;
+  uint32_t streamExtent = 512;
+  vk::DeviceSize streamBudget = 16ull*1024ull*1024ull;
+  // job system workers besides the main thread, to compare core counts
+  uint32_t workers = JobSystem::DefaultWorkerCount();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+BenchOptions ParseOptions(int argc, char ** argv) {
+  BenchOptions options;
+  for (int i = 1; i < argc; ++ i) {
+    std::string_view const arg = argv[i];
+    bool const hasValue = i+1 < argc;
+    if (arg == "--frames" && hasValue) {
+      options.frames = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--warmup" && hasValue) {
+      options.warmupFrames = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--scenarios" && hasValue) {
+      options.scenarios.clear();
+      for (auto const name : SplitList(argv[++i])) {
+        if (auto const scenario = FromName(scenarioNames, name))
+          { options.scenarios.emplace_back(*scenario); }
+        else
+          { spdlog::error("Unknown scenario '{}'", name); }
+      }
+    } else if (arg == "--frames-in-flight" && hasValue) {
+      options.framesInFlight.clear();
+      for (auto const count : SplitList(argv[++i])) {
+        auto const value = std::strtoul(std::string(count).c_str(), nullptr, 10);
+        if (value > 0)
+          { options.framesInFlight.emplace_back(static_cast<uint32_t>(value)); }
+      }
+    } else if (arg == "--windowed") {
+      options.windowed = true;
+    } else if (arg == "--present-modes" && hasValue) {
+      options.presentModes.clear();
+      for (auto const name : SplitList(argv[++i])) {
+        if (auto const mode = FromName(presentModeNames, name))
+          { options.presentModes.emplace_back(*mode); }
+        else
+          { spdlog::error("Unknown present mode '{}'", name); }
+      }
+    } else if (arg == "--output" && hasValue) {
+      options.outputPath = argv[++i];
+    } else if (arg == "--draws" && hasValue) {
+      options.drawCount =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--upload-bytes" && hasValue) {
+      options.uploadBytes = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--compute-groups" && hasValue) {
+      options.computeGroups =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--stream-textures" && hasValue) {
+      options.streamTextures =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--stream-extent" && hasValue) {
+      options.streamExtent =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--stream-budget" && hasValue) {
+      options.streamBudget = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--workers" && hasValue) {
+      options.workers =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else {
+      spdlog::error("Unknown argument '{}'", arg);
+    }
+  }
+  return options;
+}
+
+// per-frame constants of the draws, std430 like shaders/scroll.frag
+struct DrawConstants {
+  float scroll = 0.0f; // in bands
+  uint32_t frameIndex = 0;
+};
+
+// pushed per draw, everything else is reached through the bindless heap by
+// these handles; mirrors DrawPush in shaders/scroll.frag
+struct DrawPush {
+  BindlessHandle textureHandle = invalidBindlessHandle;
+  BindlessHandle samplerHandle = invalidBindlessHandle;
+  BindlessHandle constantsHandle = invalidBindlessHandle; // the frame ring
+  uint32_t constantsIndex = 0; // of the frame's DrawConstants in the ring
+};
+
+// the draws cycle through this many generated textures
+constexpr uint32_t drawTextureCount = 16;
+constexpr uint32_t drawTextureExtent = 64;
+
+////////////////////////////////////////////////////////////////////////////////
+// checkers in a color per texture, every level of the chain generated rather
+// than filtered, for the stream scenario's pack
+std::vector<PackedAsset> StreamTextures(uint32_t count, uint32_t extent) {
+  extent = std::max(extent, 1u);
+  uint32_t mipLevels = 1;
+  while ((extent >> mipLevels) > 0) { ++ mipLevels; }
+
+  std::vector<PackedAsset> assets(count);
+  for (uint32_t i = 0; i < count; ++ i) {
+    auto & asset = assets[i];
+    asset.name = fmt::format("stream{}", i);
+    asset.entry.kind = PackEntryKind::Image;
+    asset.entry.format = static_cast<uint32_t>(vk::Format::eR8G8B8A8Unorm);
+    asset.entry.texelSize = 4;
+    asset.entry.width = extent;
+    asset.entry.height = extent;
+    asset.entry.mipLevels = mipLevels;
+
+    for (uint32_t mip = 0; mip < mipLevels; ++ mip) {
+      auto const levelExtent = PackMipExtent(extent, mip);
+      auto const square = std::max(levelExtent / 8, 1u);
+      for (uint32_t y = 0; y < levelExtent; ++ y)
+      for (uint32_t x = 0; x < levelExtent; ++ x) {
+        uint8_t const shade = ((x / square + y / square) & 1) ? 255 : 96;
+        asset.data.push_back((i & 1) ? shade : 0);
+        asset.data.push_back((i & 2) ? shade : 0);
+        asset.data.push_back((i & 4) ? shade : 0);
+        asset.data.push_back(255);
+      }
+    }
+  }
+  return assets;
+}
+
+// the per-scenario resources & the passes they add to the run's graph, which
+// renders into its imported target
+////////////////////////////////////////////////////////////////////////////////
+class BenchScene {
+private:
+  GraphicsContext* context = nullptr;
+  Scenario scenario;
+  BenchOptions const* options = nullptr;
+
+  JobSystem* jobs = nullptr;
+  RenderGraph* graph = nullptr;
+  RGResourceId target;
+
+  // -- draws & stream
+  std::unique_ptr<BindlessHeap> bindless;
+
+  // -- draws, their constants are pushed to the frame ring's allocator & every
+  //    resource they read goes through the heap, so there are no per-draw
+  //    descriptor sets; the textures are uploaded through uploads
+  FrameAllocator* frameAllocator = nullptr;
+  std::vector<Image> drawTextures;
+  std::vector<vk::ImageView> drawViews;
+  std::vector<BindlessHandle> drawTextureHandles;
+  vk::UniqueSampler drawSampler;
+  BindlessHandle drawSamplerHandle = invalidBindlessHandle;
+  BindlessHandle drawConstantsHandle = invalidBindlessHandle;
+  vk::Pipeline drawPipeline;
+  uint32_t drawColumns = 1, drawRows = 1; // one tile of the target per draw
+
+  // the draws' CPU side, built once & run every frame: culling the tiles
+  // against a view sweeping over them & pushing the constants, in parallel,
+  // then recording what survived
+  JobGraph drawGraph;
+  std::vector<uint8_t> drawVisible; // written by culling, read by recording
+  struct DrawFrame {
+    CommandRecorder* recorder = nullptr;
+    vk::CommandBuffer commandBuffer;
+    vk::RenderPassBeginInfo renderPassBI; // the render graph's "draws" pass
+    uint64_t frameIndex = 0;
+    uint32_t constantsIndex = 0;
+  } drawFrame; // the graph's inputs & outputs for the frame being recorded
+
+  // -- upload, one target per frame in flight so a frame never overwrites a
+  //    buffer an earlier frame still acquires
+  std::unique_ptr<UploadEngine> uploads;
+  std::vector<Buffer> uploadTargets;
+  std::vector<std::byte> uploadData;
+
+  // -- stream, the pack is generated into a scratch file for the run
+  std::filesystem::path streamPackPath;
+  std::unique_ptr<AssetPack> streamPack;
+  std::unique_ptr<TextureStreamer> streamer;
+  std::vector<TextureId> streamIds;
+  vk::DeviceSize streamPeakBytes = 0; // resident, after any frame's update
+
+  // -- compute
+  std::unique_ptr<AsyncCompute> compute;
+  Buffer computeBuffer;
+  vk::UniqueDescriptorSetLayout computeSetLayout;
+  vk::UniqueDescriptorPool descriptorPool;
+  vk::DescriptorSet computeSet;
+  vk::UniquePipelineLayout computeLayout;
+  vk::Pipeline computePipeline;
+
+  // -- graph, transients of the scenario's frame besides the target
+  RGResourceId graphScene, graphOverlay, graphDebug;
+  uint32_t graphFailures = 0;
+
+  // declared last, so pipelines are destroyed before the layouts
+  std::unique_ptr<PipelineManager> pipelines;
+
+  std::string unsupported;
+
+  void CreateDrawTextures();
+  void AddPasses();
+  void AddGraphPasses();
+  void CheckGraph();
+
+  void CullDraws(uint32_t first, uint32_t last);
+  void RecordDraws() const;
+
+public:
+  // adds the scenario's passes to graph_ & compiles it, graph_ must have
+  // nothing compiled yet; the draws need frameAllocator, the other scenarios
+  // ignore it
+  BenchScene(
+    GraphicsContext & context_
+  , JobSystem & jobs_
+  , Scenario scenario_
+  , BenchOptions const & options_
+  , RenderGraph & graph_
+  , RGResourceId target_
+  , uint32_t framesInFlight
+  , FrameAllocator* frameAllocator_
+  );
+  ~BenchScene();
+  BenchScene(BenchScene const &) = delete;
+  BenchScene(BenchScene &&) = delete;
+
+  // why the scenario can't run on the device, empty if it can
+  std::string const & Unsupported() const { return unsupported; }
+
+  // the streamer's totals, null for the other scenarios
+  TextureStreamerStats const * StreamStats() const
+    { return streamer ? &streamer->Stats() : nullptr; }
+  vk::DeviceSize StreamPeakBytes() const { return streamPeakBytes; }
+
+  // of the graph scenario's checks on what the graph compiled to
+  uint32_t GraphFailures() const { return graphFailures; }
+
+  // begins, records & ends commandBuffer, executing the graph with the
+  // target bound to this frame's image; returns what the graphics submit
+  // has to wait on besides the swapchain image
+  std::vector<SemaphoreSubmit> Record(
+    CommandRecorder & recorder
+  , FrameRing & frames
+  , vk::CommandBuffer const & commandBuffer
+  , uint64_t frameIndex
+  );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+BenchScene::BenchScene(
+  GraphicsContext & context_
+, JobSystem & jobs_
+, Scenario scenario_
+, BenchOptions const & options_
+, RenderGraph & graph_
+, RGResourceId target_
+, uint32_t framesInFlight
+, FrameAllocator* frameAllocator_
+)
+: context{&context_}, scenario{scenario_}, options{&options_}, jobs{&jobs_}
+, graph{&graph_}, target{target_}, frameAllocator{frameAllocator_}
+{
+  auto & device = this->context->device;
+
+  switch (this->scenario) {
+    case Scenario::Clear:
+    case Scenario::Graph: break;
+
+    case Scenario::ManyDraws: {
+      BindlessHeapCreateInfo heapCI;
+      heapCI.sampledImageCount = drawTextureCount;
+      heapCI.storageBufferCount = 1;
+      heapCI.samplerCount = 1;
+      this->bindless = std::make_unique<BindlessHeap>(*this->context, heapCI);
+      if (!this->bindless->IsValid()) {
+        this->unsupported = "descriptor indexing unsupported";
+        break;
+      }
+
+      this->pipelines = std::make_unique<PipelineManager>(*this->context);
+      this->uploads = std::make_unique<UploadEngine>(*this->context);
+      this->CreateDrawTextures();
+      if (this->drawTextureHandles.empty()) {
+        this->unsupported = "no draw textures";
+        break;
+      }
+
+      // the whole ring, each frame's constants are found by index
+      this->drawConstantsHandle =
+        this->bindless->AddStorageBuffer(this->frameAllocator->RingBuffer());
+
+      uint32_t const drawCount = std::max(this->options->drawCount, 1u);
+      this->drawColumns =
+        static_cast<uint32_t>(
+          std::ceil(std::sqrt(static_cast<double>(drawCount)))
+        );
+      this->drawRows = (drawCount + this->drawColumns - 1) / this->drawColumns;
+      this->drawVisible.resize(drawCount, 0);
+
+      auto const cull =
+        this->drawGraph.Add([this, drawCount]() {
+          this->jobs->ParallelFor(
+            0, drawCount, 256
+          , [this](uint32_t first, uint32_t last) {
+              this->CullDraws(first, last);
+            }
+          );
+        });
+      auto const constants =
+        this->drawGraph.Add([this]() {
+          // scrolls a band every 20 frames; flushed by SubmitFrame
+          auto const frameIndex = this->drawFrame.frameIndex;
+          DrawConstants constants;
+          constants.scroll = static_cast<float>(frameIndex % 160) * 0.05f;
+          constants.frameIndex = static_cast<uint32_t>(frameIndex);
+          // aligned to its own size, so its offset is an index into the ring
+          auto const allocation =
+            this->frameAllocator->Allocate(
+              sizeof(DrawConstants), sizeof(DrawConstants)
+            );
+          if (allocation.data)
+            { std::memcpy(allocation.data, &constants, sizeof(constants)); }
+          this->drawFrame.constantsIndex =
+            static_cast<uint32_t>(allocation.offset / sizeof(DrawConstants));
+        });
+      this->drawGraph.Add(
+        [this]() { this->RecordDraws(); }, { cull, constants }
+      );
+    } break;
+
+    case Scenario::Upload: {
+      this->uploads = std::make_unique<UploadEngine>(*this->context);
+      this->uploadData.resize(this->options->uploadBytes, std::byte { 0x5a });
+
+      vk::BufferCreateInfo bufferCI;
+      bufferCI.size = this->options->uploadBytes;
+      bufferCI.usage = vk::BufferUsageFlagBits::eTransferDst;
+      for (uint32_t i = 0; i < framesInFlight; ++ i) {
+        this->uploadTargets.emplace_back(
+          this->context->allocator->CreateBuffer(
+            bufferCI, { MemoryUsage::GpuOnly }
+          )
+        );
+      }
+    } break;
+
+    case Scenario::Stream: {
+      // a texture's old & new handles coexist until the old one retires
+      BindlessHeapCreateInfo heapCI;
+      heapCI.sampledImageCount = 1024;
+      heapCI.storageBufferCount = 1;
+      heapCI.samplerCount = 1;
+      this->bindless = std::make_unique<BindlessHeap>(*this->context, heapCI);
+      if (!this->bindless->IsValid()) {
+        this->unsupported = "descriptor indexing unsupported";
+        break;
+      }
+
+      std::error_code error;
+      this->streamPackPath =
+        std::filesystem::temp_directory_path(error) / "dtq_bench_stream.pack";
+      if (
+        error
+     || !WritePack(
+          this->streamPackPath.string()
+        , StreamTextures(
+            this->options->streamTextures, this->options->streamExtent
+          )
+        )
+      ) {
+        this->unsupported = "could not write the stream pack";
+        break;
+      }
+      this->streamPack =
+        std::make_unique<AssetPack>(this->streamPackPath.string());
+      if (!this->streamPack->IsOpen()) {
+        this->unsupported = "could not open the stream pack";
+        break;
+      }
+
+      TextureStreamerCreateInfo streamerCI;
+      streamerCI.budgetBytes = this->options->streamBudget;
+      this->streamer =
+        std::make_unique<TextureStreamer>(
+          *this->context, *this->bindless, *this->streamPack, streamerCI
+        );
+      for (uint32_t i = 0; i < this->options->streamTextures; ++ i) {
+        auto const id = this->streamer->Add(fmt::format("stream{}", i));
+        if (id != invalidTextureId) { this->streamIds.emplace_back(id); }
+      }
+      if (this->streamIds.empty()) {
+        this->unsupported = "no streamed textures";
+        break;
+      }
+    } break;
+
+    case Scenario::Compute: {
+      this->pipelines = std::make_unique<PipelineManager>(*this->context);
+      this->compute =
+        std::make_unique<AsyncCompute>(*this->context, framesInFlight);
+
+      vk::BufferCreateInfo bufferCI;
+      bufferCI.size =
+        vk::DeviceSize{this->options->computeGroups} * 64 * sizeof(float);
+      bufferCI.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+      this->computeBuffer =
+        this->context->allocator->CreateBuffer(
+          bufferCI, { MemoryUsage::GpuOnly }
+        );
+
+      vk::DescriptorSetLayoutBinding binding;
+      binding.binding = 0;
+      binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+      binding.descriptorCount = 1;
+      binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+      vk::DescriptorSetLayoutCreateInfo setLayoutCI;
+      setLayoutCI.bindingCount = 1;
+      setLayoutCI.pBindings = &binding;
+      this->computeSetLayout =
+        CheckReturn(
+          device->createDescriptorSetLayoutUnique(setLayoutCI),
+          "Creating compute descriptor set layout"
+        );
+
+      vk::DescriptorPoolSize poolSize { vk::DescriptorType::eStorageBuffer, 1 };
+      vk::DescriptorPoolCreateInfo poolCI;
+      poolCI.maxSets = 1;
+      poolCI.poolSizeCount = 1;
+      poolCI.pPoolSizes = &poolSize;
+      this->descriptorPool =
+        CheckReturn(
+          device->createDescriptorPoolUnique(poolCI),
+          "Creating compute descriptor pool"
+        );
+
+      vk::DescriptorSetAllocateInfo setAI;
+      setAI.descriptorPool = *this->descriptorPool;
+      setAI.descriptorSetCount = 1;
+      setAI.pSetLayouts = &*this->computeSetLayout;
+      this->computeSet =
+        CheckReturn(
+          device->allocateDescriptorSets(setAI),
+          "Allocating compute descriptor set"
+        )[0];
+
+      vk::DescriptorBufferInfo bufferInfo {
+        this->computeBuffer.buffer, 0, VK_WHOLE_SIZE
+      };
+      vk::WriteDescriptorSet write;
+      write.dstSet = this->computeSet;
+      write.dstBinding = 0;
+      write.descriptorCount = 1;
+      write.descriptorType = vk::DescriptorType::eStorageBuffer;
+      write.pBufferInfo = &bufferInfo;
+      device->updateDescriptorSets(write, {});
+
+      vk::PipelineLayoutCreateInfo layoutCI;
+      layoutCI.setLayoutCount = 1;
+      layoutCI.pSetLayouts = &*this->computeSetLayout;
+      this->computeLayout =
+        CheckReturn(
+          device->createPipelineLayoutUnique(layoutCI),
+          "Creating compute pipeline layout"
+        );
+
+      ComputePipelineDesc desc;
+      desc.stage = LoadShader("busy.comp");
+      desc.layout = *this->computeLayout;
+      this->computePipeline =
+        this->pipelines->Get(this->pipelines->Request(desc));
+    } break;
+  }
+  if (!this->unsupported.empty()) { return; }
+
+  this->AddPasses();
+  // a graph compiled for the first time has nothing to retire
+  this->graph->Compile()();
+  this->graph->LogStats();
+
+  if (this->scenario == Scenario::ManyDraws) {
+    GraphicsPipelineDesc desc;
+    desc.stages = {
+      LoadShader("fullscreen.vert"), LoadShader("scroll.frag:scroll8")
+    };
+    desc.layout = this->bindless->PipelineLayout();
+    desc.renderPass = this->graph->RenderPass("draws");
+    this->drawPipeline = this->pipelines->Get(this->pipelines->Request(desc));
+  }
+  if (this->scenario == Scenario::Graph)
+    { this->CheckGraph(); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BenchScene::~BenchScene() {
+  // engines wait for their own work, the caller idles the graphics queue
+  this->uploads.reset();
+  this->compute.reset();
+
+  // the streamer waits for its batch in flight, the pack it reads goes after
+  this->streamer.reset();
+  this->streamPack.reset();
+  if (!this->streamPackPath.empty()) {
+    std::error_code error;
+    std::filesystem::remove(this->streamPackPath, error);
+  }
+
+  for (auto const & view : this->drawViews)
+    { this->context->device->destroyImageView(view); }
+  for (auto & texture : this->drawTextures)
+    { this->context->allocator->DestroyImage(texture); }
+
+  for (auto & target : this->uploadTargets)
+    { this->context->allocator->DestroyBuffer(target); }
+  if (this->computeBuffer.buffer)
+    { this->context->allocator->DestroyBuffer(this->computeBuffer); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// checkers in a color per texture, so neighbouring draws visibly differ
+void BenchScene::CreateDrawTextures() {
+  auto & device = this->context->device;
+
+  vk::ImageCreateInfo imageCI;
+  imageCI.imageType = vk::ImageType::e2D;
+  imageCI.format = vk::Format::eR8G8B8A8Unorm;
+  imageCI.extent = vk::Extent3D { drawTextureExtent, drawTextureExtent, 1 };
+  imageCI.mipLevels = 1;
+  imageCI.arrayLayers = 1;
+  imageCI.samples = vk::SampleCountFlagBits::e1;
+  imageCI.tiling = vk::ImageTiling::eOptimal;
+  imageCI.usage =
+    vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+  imageCI.sharingMode = vk::SharingMode::eExclusive;
+  imageCI.initialLayout = vk::ImageLayout::eUndefined;
+
+  vk::BufferImageCopy copy;
+  copy.imageSubresource =
+    vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+  copy.imageExtent = imageCI.extent;
+
+  std::vector<uint8_t> texels(drawTextureExtent * drawTextureExtent * 4);
+  for (uint32_t i = 0; i < drawTextureCount; ++ i) {
+    auto texture =
+      this->context->allocator->CreateImage(
+        imageCI, { MemoryUsage::GpuOnly }
+      );
+    if (!texture.image) {
+      spdlog::error("Could not create draw texture {}", i);
+      continue;
+    }
+
+    for (uint32_t y = 0; y < drawTextureExtent; ++ y)
+    for (uint32_t x = 0; x < drawTextureExtent; ++ x) {
+      uint8_t const shade = ((x / 8 + y / 8) & 1) ? 255 : 96;
+      auto * texel = &texels[(y * drawTextureExtent + x) * 4];
+      texel[0] = (i & 1) ? shade : 0;
+      texel[1] = (i & 2) ? shade : 0;
+      texel[2] = (i & 4) ? shade : 0;
+      texel[3] = 255;
+    }
+    this->uploads->UploadImage(
+      texture.image, copy, texels.data(), texels.size()
+    );
+
+    vk::ImageViewCreateInfo viewCI;
+    viewCI.image = texture.image;
+    viewCI.viewType = vk::ImageViewType::e2D;
+    viewCI.format = imageCI.format;
+    viewCI.subresourceRange =
+      vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+    auto const view =
+      CheckReturn(
+        device->createImageView(viewCI),
+        "Creating draw texture image view"
+      );
+
+    this->drawTextures.emplace_back(texture);
+    this->drawViews.emplace_back(view);
+    this->drawTextureHandles.emplace_back(
+      this->bindless->AddSampledImage(view)
+    );
+  }
+  // acquired & waited on by the first frame's Record
+  this->uploads->Flush();
+
+  vk::SamplerCreateInfo samplerCI;
+  samplerCI.magFilter = vk::Filter::eLinear;
+  samplerCI.minFilter = vk::Filter::eLinear;
+  samplerCI.addressModeU = vk::SamplerAddressMode::eRepeat;
+  samplerCI.addressModeV = vk::SamplerAddressMode::eRepeat;
+  samplerCI.addressModeW = vk::SamplerAddressMode::eRepeat;
+  this->drawSampler =
+    CheckReturn(
+      device->createSamplerUnique(samplerCI),
+      "Creating draw sampler"
+    );
+  this->drawSamplerHandle = this->bindless->AddSampler(*this->drawSampler);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BenchScene::AddPasses() {
+  vk::ClearValue clearValue;
+  clearValue.color =
+    vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
+  RGAccess const clearTarget {
+    this->target, RGAccessType::ColorAttachment
+  , vk::AttachmentLoadOp::eClear, clearValue
+  };
+
+  switch (this->scenario) {
+    case Scenario::ManyDraws: {
+      RGPassDesc pass;
+      pass.name = "draws";
+      pass.writes = { clearTarget };
+      pass.contents = vk::SubpassContents::eSecondaryCommandBuffers;
+      pass.execute = [this](
+        vk::CommandBuffer const & commandBuffer
+      , RenderGraph const & graph
+      ) {
+        this->drawFrame.commandBuffer = commandBuffer;
+        this->drawFrame.renderPassBI = graph.ActiveRenderPass();
+        this->drawGraph.Run(*this->jobs);
+      };
+      this->graph->AddPass(std::move(pass));
+    } break;
+
+    case Scenario::Graph:
+      this->AddGraphPasses();
+      break;
+
+    // an empty render pass, the work is recorded ahead of the graph
+    case Scenario::Clear:
+    case Scenario::Upload:
+    case Scenario::Compute:
+    case Scenario::Stream: {
+      RGPassDesc pass;
+      pass.name = "clear";
+      pass.writes = { clearTarget };
+      this->graph->AddPass(std::move(pass));
+    } break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// "scene" is cleared & copied into the target by "resolve", "overlay" is
+// cleared & its lower half copied over the target by "composite", then "ui"
+// clears a corner of it in place; "debug" copies "scene" where nothing reads
+// it. So "debug" is culled, "scene" & "overlay" never live at the same time &
+// alias, and the target goes through copies before the last raster pass
+void BenchScene::AddGraphPasses() {
+  auto & graph = *this->graph;
+  auto const target = this->target;
+
+  RGImageDesc const desc {
+    graph.Desc(target).format, graph.Desc(target).extent
+  };
+  this->graphScene = graph.CreateImage("scene", desc);
+  this->graphOverlay = graph.CreateImage("overlay", desc);
+  this->graphDebug = graph.CreateImage("debug", desc);
+
+  auto const addClear = [&](
+    std::string const & name, RGResourceId image, std::array<float, 4> color
+  ) {
+    vk::ClearValue clearValue;
+    clearValue.color = vk::ClearColorValue(color);
+    RGPassDesc pass;
+    pass.name = name;
+    pass.writes = {
+      { image, RGAccessType::ColorAttachment
+      , vk::AttachmentLoadOp::eClear, clearValue
+      }
+    };
+    graph.AddPass(std::move(pass));
+  };
+
+  // the whole image or its lower half, over what both images cover; the
+  // target may have been resized since the transients were created
+  auto const addCopy = [&](
+    std::string const & name, RGResourceId src, RGResourceId dst
+  , bool lowerHalf
+  ) {
+    RGPassDesc pass;
+    pass.name = name;
+    pass.reads = { { src, RGAccessType::TransferSrc } };
+    pass.writes = { { dst, RGAccessType::TransferDst } };
+    pass.execute = [src, dst, lowerHalf](
+      vk::CommandBuffer const & commandBuffer
+    , RenderGraph const & graph
+    ) {
+      auto const & srcExtent = graph.Desc(src).extent;
+      auto const & dstExtent = graph.Desc(dst).extent;
+      uint32_t const width = std::min(srcExtent.width, dstExtent.width);
+      uint32_t const height = std::min(srcExtent.height, dstExtent.height);
+      int32_t const y = static_cast<int32_t>(lowerHalf ? height / 2 : 0);
+
+      vk::ImageCopy region;
+      region.srcSubresource =
+        vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+      region.dstSubresource = region.srcSubresource;
+      region.srcOffset = vk::Offset3D { 0, y, 0 };
+      region.dstOffset = region.srcOffset;
+      region.extent =
+        vk::Extent3D { width, height - static_cast<uint32_t>(y), 1 };
+      if (region.extent.width == 0 || region.extent.height == 0) { return; }
+
+      commandBuffer.copyImage(
+        graph.ImageHandle(src), vk::ImageLayout::eTransferSrcOptimal
+      , graph.ImageHandle(dst), vk::ImageLayout::eTransferDstOptimal
+      , region
+      );
+    };
+    graph.AddPass(std::move(pass));
+  };
+
+  addClear("scene", this->graphScene, { 0.1f, 0.2f, 0.4f, 1.0f });
+  addCopy("debug", this->graphScene, this->graphDebug, false);
+  addCopy("resolve", this->graphScene, target, false);
+  addClear("overlay", this->graphOverlay, { 0.8f, 0.5f, 0.1f, 1.0f });
+  addCopy("composite", this->graphOverlay, target, true);
+
+  RGPassDesc ui;
+  ui.name = "ui";
+  ui.writes = {
+    { target, RGAccessType::ColorAttachment, vk::AttachmentLoadOp::eLoad }
+  };
+  ui.execute = [](
+    vk::CommandBuffer const & commandBuffer
+  , RenderGraph const & graph
+  ) {
+    auto const extent = graph.ActiveRenderPass().renderArea.extent;
+    vk::ClearAttachment clear;
+    clear.aspectMask = vk::ImageAspectFlagBits::eColor;
+    clear.colorAttachment = 0;
+    clear.clearValue.color =
+      vk::ClearColorValue(std::array<float, 4>{1.0f, 1.0f, 1.0f, 1.0f});
+    vk::ClearRect rect;
+    rect.rect.extent =
+      vk::Extent2D {
+        std::max(extent.width / 4, 1u), std::max(extent.height / 4, 1u)
+      };
+    rect.baseArrayLayer = 0;
+    rect.layerCount = 1;
+    commandBuffer.clearAttachments(clear, rect);
+  };
+  graph.AddPass(std::move(ui));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// what Compile should have derived for AddGraphPasses' frame
+void BenchScene::CheckGraph() {
+  using Layout = vk::ImageLayout;
+  auto const & graph = *this->graph;
+  auto const target = this->target;
+  auto const scene = this->graphScene;
+  auto const overlay = this->graphOverlay;
+
+  auto const check = [this](bool condition, std::string_view what) {
+    if (condition) { return; }
+    spdlog::error("Render graph check failed: {}", what);
+    ++ this->graphFailures;
+  };
+
+  auto const find = [](
+    RGBarrierBatch const & batch, RGResourceId resource
+  ) -> RGBarrier const * {
+    for (auto const & barrier : batch.barriers)
+      { if (barrier.resource == resource) { return &barrier; } }
+    return nullptr;
+  };
+
+  auto const transitions = [&](
+    RGBarrierBatch const & batch, RGResourceId resource
+  , Layout oldLayout, Layout newLayout
+  ) {
+    auto const * barrier = find(batch, resource);
+    return
+      barrier
+   && barrier->oldLayout == oldLayout && barrier->newLayout == newLayout;
+  };
+
+  // -- culling
+  check(graph.IsCulled("debug"), "'debug' feeds nothing, so is culled");
+  check(
+    graph.Barriers("debug").barriers.empty()
+  , "culled 'debug' records no barriers"
+  );
+  check(
+    !graph.ImageHandle(this->graphDebug)
+  , "only culled 'debug' wrote 'debug', so it isn't created"
+  );
+  for (auto const * name : { "scene", "resolve", "overlay", "composite", "ui" })
+    { check(!graph.IsCulled(name), fmt::format("'{}' isn't culled", name)); }
+
+  // -- barriers
+  check(
+    transitions(
+      graph.Barriers("scene"), scene, Layout::eUndefined
+    , Layout::eColorAttachmentOptimal
+    )
+  , "'scene' is cleared from undefined"
+  );
+  check(
+    transitions(
+      graph.Barriers("resolve"), scene, Layout::eColorAttachmentOptimal
+    , Layout::eTransferSrcOptimal
+    )
+  , "'resolve' waits for 'scene' as a copy source"
+  );
+  check(
+    transitions(
+      graph.Barriers("resolve"), target, Layout::eUndefined
+    , Layout::eTransferDstOptimal
+    )
+  , "'resolve' takes the target from its initial layout"
+  );
+  { // write after write, in the same layout
+    auto const * barrier = find(graph.Barriers("composite"), target);
+    check(
+      barrier
+   && barrier->oldLayout == Layout::eTransferDstOptimal
+   && barrier->newLayout == Layout::eTransferDstOptimal
+   && (barrier->srcAccess & vk::AccessFlagBits::eTransferWrite)
+    , "'composite' waits for the copy 'resolve' made into the target"
+    );
+  }
+  check(
+    transitions(
+      graph.Barriers("ui"), target, Layout::eTransferDstOptimal
+    , Layout::eColorAttachmentOptimal
+    )
+  , "'ui' loads what the copies left in the target"
+  );
+  { // in whichever layout the run takes the target on in
+    auto const * barrier = find(graph.FinalBarriers(), target);
+    check(
+      barrier && barrier->oldLayout == Layout::eColorAttachmentOptimal
+    , "the target is handed back from where 'ui' left it"
+    );
+  }
+
+  // -- aliasing
+  check(
+    graph.TransientOffset(scene) == graph.TransientOffset(overlay)
+  , "'scene' & 'overlay' never live at the same time, so alias"
+  );
+  check(
+    graph.AliasedBytes() < graph.TransientBytes()
+  , "aliasing takes less memory than the transients add up to"
+  );
+  auto const & overlayBarriers = graph.Barriers("overlay");
+  check(
+    transitions(
+      overlayBarriers, overlay, Layout::eUndefined
+    , Layout::eColorAttachmentOptimal
+    )
+ && (overlayBarriers.srcStage & vk::PipelineStageFlagBits::eTransfer)
+  , "'overlay' waits for the copy out of 'scene' it reuses the memory of"
+  );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BenchScene::CullDraws(uint32_t first, uint32_t last) {
+  // a circle over half the target, orbiting its center every 240 frames
+  float const angle =
+    static_cast<float>(this->drawFrame.frameIndex % 240) / 240.0f
+  * 6.2831853f;
+  float const viewX = 0.5f + 0.25f*std::cos(angle);
+  float const viewY = 0.5f + 0.25f*std::sin(angle);
+  constexpr float radius = 0.5f;
+
+  for (uint32_t draw = first; draw < last; ++ draw) {
+    float const x =
+      (static_cast<float>(draw % this->drawColumns) + 0.5f) / this->drawColumns;
+    float const y =
+      (static_cast<float>(draw / this->drawColumns) + 0.5f) / this->drawRows;
+    float const dx = x - viewX, dy = y - viewY;
+    this->drawVisible[draw] = dx*dx + dy*dy <= radius*radius;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BenchScene::RecordDraws() const {
+  auto const & renderPassBI = this->drawFrame.renderPassBI;
+  auto const constantsIndex = this->drawFrame.constantsIndex;
+  uint32_t const drawCount = static_cast<uint32_t>(this->drawVisible.size());
+  auto const columns = this->drawColumns;
+  auto const rows = this->drawRows;
+  auto const extent = renderPassBI.renderArea.extent;
+  float const tileWidth = static_cast<float>(extent.width) / columns;
+  float const tileHeight = static_cast<float>(extent.height) / rows;
+
+  constexpr uint32_t drawsPerTask = 256;
+  std::vector<RecordTask> tasks;
+  for (uint32_t first = 0; first < drawCount; first += drawsPerTask) {
+    uint32_t const last = std::min(first + drawsPerTask, drawCount);
+    tasks.emplace_back([=, this](vk::CommandBuffer const & secondary) {
+      secondary.bindPipeline(
+        vk::PipelineBindPoint::eGraphics, this->drawPipeline
+      );
+      this->bindless->Bind(secondary, vk::PipelineBindPoint::eGraphics);
+
+      DrawPush push;
+      push.samplerHandle = this->drawSamplerHandle;
+      push.constantsHandle = this->drawConstantsHandle;
+      push.constantsIndex = constantsIndex;
+      for (uint32_t draw = first; draw < last; ++ draw) {
+        if (!this->drawVisible[draw]) { continue; }
+        push.textureHandle =
+          this->drawTextureHandles[draw % this->drawTextureHandles.size()];
+        secondary.pushConstants(
+          this->bindless->PipelineLayout(), vk::ShaderStageFlagBits::eAll
+        , 0, sizeof(push), &push
+        );
+        float const x = (draw % columns) * tileWidth;
+        float const y = (draw / columns) * tileHeight;
+        secondary.setViewport(
+          0, vk::Viewport { x, y, tileWidth, tileHeight, 0.0f, 1.0f }
+        );
+        secondary.setScissor(
+          0
+        , vk::Rect2D {
+            { static_cast<int32_t>(x), static_cast<int32_t>(y) }
+          , {
+              static_cast<uint32_t>(std::ceil(tileWidth))
+            , static_cast<uint32_t>(std::ceil(tileHeight))
+            }
+          }
+        );
+        secondary.draw(3, 1, 0, 0);
+      }
+    });
+  }
+
+  this->drawFrame.recorder->RecordSecondaries(
+    this->drawFrame.commandBuffer, renderPassBI, tasks
+  );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<SemaphoreSubmit> BenchScene::Record(
+  CommandRecorder & recorder
+, FrameRing & frames
+, vk::CommandBuffer const & commandBuffer
+, uint64_t frameIndex
+) {
+  std::vector<SemaphoreSubmit> waits;
+
+  vk::CommandBufferBeginInfo commandBufferBI;
+  commandBufferBI.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  commandBuffer.begin(commandBufferBI);
+
+  switch (this->scenario) {
+    case Scenario::Clear:
+    case Scenario::Graph: break;
+
+    case Scenario::ManyDraws: {
+      // the textures' ownership, once; nothing to acquire after that
+      auto const acquire = this->uploads->RecordOwnershipAcquire(commandBuffer);
+      if (acquire > 0) {
+        waits.push_back(
+          SemaphoreSubmit { this->uploads->Timeline(), acquire }
+        );
+      }
+    } break;
+
+    case Scenario::Upload: {
+      auto const & target =
+        this->uploadTargets[frameIndex % this->uploadTargets.size()];
+      this->uploads->UploadBuffer(
+        target.buffer, 0, this->uploadData.data(), this->uploadData.size()
+      );
+      auto const uploaded = this->uploads->Flush();
+      auto const acquire = this->uploads->RecordOwnershipAcquire(commandBuffer);
+      waits.push_back(
+        SemaphoreSubmit {
+          this->uploads->Timeline(), std::max(uploaded, acquire)
+        }
+      );
+    } break;
+
+    case Scenario::Stream: {
+      // a quarter of the set wants full resolution, a different quarter
+      // every 30 frames, so levels keep being raised & evicted
+      auto const count = static_cast<uint32_t>(this->streamIds.size());
+      auto const window = std::max(count / 4, 1u);
+      auto const first = static_cast<uint32_t>(frameIndex / 30) * window;
+      for (uint32_t i = 0; i < window; ++ i)
+        { this->streamer->RequestMip(this->streamIds[(first + i) % count], 0); }
+      this->streamer->Update(frames, commandBuffer, waits);
+      this->streamPeakBytes =
+        std::max(this->streamPeakBytes, this->streamer->Stats().residentBytes);
+    } break;
+
+    case Scenario::Compute: {
+      this->compute->BeginFrame(frameIndex);
+      auto const computeCommands = this->compute->BeginCommands();
+
+      // consecutive dispatches read & write the same values
+      vk::BufferMemoryBarrier barrier;
+      barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+      barrier.dstAccessMask =
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.buffer = this->computeBuffer.buffer;
+      barrier.size = VK_WHOLE_SIZE;
+      computeCommands.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader
+      , vk::PipelineStageFlagBits::eComputeShader
+      , {}, {}, barrier, {}
+      );
+
+      computeCommands.bindPipeline(
+        vk::PipelineBindPoint::eCompute, this->computePipeline
+      );
+      computeCommands.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute, *this->computeLayout
+      , 0, this->computeSet, {}
+      );
+      computeCommands.dispatch(this->options->computeGroups, 1, 1);
+
+      auto const value = this->compute->Submit(computeCommands);
+      waits.push_back(
+        this->compute->GraphicsWait(
+          value, vk::PipelineStageFlagBits::eColorAttachmentOutput
+        )
+      );
+    } break;
+  }
+
+  // the draws' job graph runs from within their pass
+  this->drawFrame.recorder = &recorder;
+  this->drawFrame.frameIndex = frameIndex;
+  this->graph->Execute(commandBuffer);
+
+  commandBuffer.end();
+  return waits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct RunResult {
+  Scenario scenario;
+  uint32_t framesInFlight = 0;
+  uint32_t threads = 0; // the job system's, main thread included
+  std::string presentMode; // "offscreen" when headless
+  std::string skipped;     // reason, empty if the run happened
+  uint64_t frames = 0;
+  double seconds = 0.0;
+  // high-water mark of the device local heaps' usage over the run
+  vk::DeviceSize peakDeviceBytes = 0;
+  // the stream scenario's, with the most it ever had resident
+  std::optional<TextureStreamerStats> stream;
+  vk::DeviceSize streamPeakBytes = 0;
+  // the graph scenario's failed checks
+  std::optional<uint32_t> graphFailures;
+  std::array<FrameStageStats, static_cast<size_t>(FrameStage::Count)> stages;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+RunResult Run(
+  GraphicsContext & context
+, JobSystem & jobs
+, BenchOptions const & options
+, Scenario scenario
+, uint32_t framesInFlight
+, Swapchain * swapchain // null runs offscreen
+, vk::PresentModeKHR presentMode
+) {
+  RunResult result;
+  result.scenario = scenario;
+  result.framesInFlight = framesInFlight;
+  result.threads = jobs.ThreadCount();
+  result.presentMode =
+    swapchain ? ToName(presentModeNames, presentMode) : "offscreen";
+
+  std::unique_ptr<Offscreen> offscreen;
+  vk::Format colorFormat;
+  vk::Extent2D extent;
+  if (swapchain) {
+    swapchain->preferredPresentModes = { presentMode };
+    swapchain->Construct(FramebufferSize(*context.glfwWindow))();
+    if (swapchain->presentMode != presentMode) {
+      result.skipped = "present mode unsupported";
+      return result;
+    }
+    colorFormat = swapchain->colorFormat;
+    extent = swapchain->swapchainExtent;
+  } else {
+    offscreen = std::make_unique<Offscreen>(context, framesInFlight);
+    offscreen->Construct(options.extent);
+    colorFormat = offscreen->colorFormat;
+    extent = offscreen->imageExtent;
+  }
+
+  // the graph scenario copies into the target
+  if (scenario == Scenario::Graph && swapchain
+   && !(swapchain->imageUsage & vk::ImageUsageFlagBits::eTransferDst)
+  ) {
+    result.skipped = "swapchain images can't be copied to";
+    return result;
+  }
+
+  // only the draws push per-frame constants, read from the ring through the
+  // bindless heap as a storage buffer
+  std::optional<FrameAllocatorCreateInfo> frameAllocatorCI;
+  if (scenario == Scenario::ManyDraws) {
+    frameAllocatorCI.emplace();
+    frameAllocatorCI->bytesPerFrame = 64ull*1024ull;
+    frameAllocatorCI->usage = vk::BufferUsageFlagBits::eStorageBuffer;
+  }
+  auto frames = FrameRing::Construct(context, framesInFlight, frameAllocatorCI);
+
+  // the swapchain or offscreen image of the frame is bound to the import,
+  // left in whatever the frame's consumer takes it in
+  RenderGraph graph(context);
+  auto const target =
+    graph.ImportImage(
+      "target"
+    , RGImageDesc { colorFormat, extent }
+    , vk::ImageLayout::eUndefined
+    , swapchain
+    ? vk::ImageLayout::ePresentSrcKHR
+    : vk::ImageLayout::eTransferSrcOptimal
+    );
+
+  // without idling the device, it would show up in the frame times; the old
+  // swapchain & the graph's framebuffers over it go once the frames using
+  // them retire
+  auto const recreateSwapchain = [&]() {
+    DeferDestroy(frames, graph.InvalidateImported(target));
+    DeferDestroy(
+      frames, swapchain->Construct(FramebufferSize(*context.glfwWindow))
+    );
+    extent = swapchain->swapchainExtent;
+    graph.ResizeImported(target, extent);
+  };
+  auto recorder = CommandRecorder(context, jobs, framesInFlight);
+  auto scene =
+    BenchScene(
+      context, jobs, scenario, options, graph, target, framesInFlight
+    , frames.frameAllocator.get()
+    );
+  if (!scene.Unsupported().empty()) {
+    result.skipped = scene.Unsupported();
+    return result;
+  }
+  if (scenario == Scenario::Graph)
+    { result.graphFailures = scene.GraphFailures(); }
+  FramePacing pacing;
+  auto memory = MemoryTelemetry(context);
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t const totalFrames = options.warmupFrames + options.frames;
+  for (uint64_t frameIdx = 0; frameIdx < totalFrames;) {
+    if (frameIdx == options.warmupFrames) {
+      pacing.Reset();
+      start = std::chrono::steady_clock::now();
+    }
+
+    if (swapchain) { PollEvents(*context.glfwWindow); }
+
+    auto & frame =
+      TimeStage(pacing, FrameStage::FenceWait, [&]() -> FrameContext & {
+        return BeginFrame(context, frames);
+      });
+    recorder.BeginFrame(frame.frameIndex);
+
+    std::vector<SemaphoreSubmit> waits, signals;
+    uint32_t imageIdx = 0;
+    vk::Result acquireResult = vk::Result::eSuccess;
+    if (swapchain) {
+      acquireResult =
+        TimeStage(pacing, FrameStage::Acquire, [&]() {
+          return swapchain->AcquireNextImage(*frame.acquireComplete);
+        });
+      if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+        recreateSwapchain();
+        continue;
+      }
+      imageIdx = swapchain->currentImage;
+      waits.push_back(
+        SemaphoreSubmit {
+          *frame.acquireComplete, 0
+        , vk::PipelineStageFlagBits::eColorAttachmentOutput
+        }
+      );
+      signals.push_back(SemaphoreSubmit { swapchain->RenderComplete() });
+      graph.SetImported(
+        target
+      , swapchain->ImageHandle(imageIdx), swapchain->ImageView(imageIdx)
+      );
+    } else {
+      imageIdx = offscreen->AcquireNextImage();
+      graph.SetImported(
+        target
+      , offscreen->ImageHandle(imageIdx), offscreen->ImageView(imageIdx)
+      );
+    }
+
+    {
+      ScopedFrameStage stage(pacing, FrameStage::Record);
+      auto const sceneWaits =
+        scene.Record(recorder, frames, frame.commandBuffer, frameIdx);
+      waits.insert(waits.end(), sceneWaits.begin(), sceneWaits.end());
+    }
+
+    {
+      ScopedFrameStage stage(pacing, FrameStage::Submit);
+      SubmitFrame(context, frames, frame, waits, signals);
+    }
+
+    vk::Result presentResult = vk::Result::eSuccess;
+    if (swapchain) {
+      presentResult =
+        TimeStage(pacing, FrameStage::Present, [&]() {
+          return swapchain->QueuePresent(swapchain->RenderComplete());
+        });
+    }
+
+    EndFrame(frames);
+    pacing.EndFrame();
+    memory.Poll();
+    ++ frameIdx;
+
+    if (acquireResult == vk::Result::eSuboptimalKHR
+     || presentResult == vk::Result::eSuboptimalKHR
+     || presentResult == vk::Result::eErrorOutOfDateKHR
+    ) {
+      recreateSwapchain();
+    }
+  }
+
+  // measured up to the last submit, the pacing samples end there too
+  result.seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+  result.frames = options.frames;
+  for (uint32_t i = 0; i < memory.HeapCount(); ++ i) {
+    auto const & heap = memory.Heap(i);
+    if (!heap.deviceLocal) { continue; }
+    result.peakDeviceBytes = std::max(result.peakDeviceBytes, heap.peakUsage);
+  }
+  if (auto const * stats = scene.StreamStats()) {
+    result.stream = *stats;
+    result.streamPeakBytes = scene.StreamPeakBytes();
+  }
+
+  context.device->waitIdle();
+  FlushDeferred(frames);
+
+  pacing.Collect();
+  for (uint32_t i = 0; i < static_cast<uint32_t>(FrameStage::Count); ++ i)
+    { result.stages[i] = pacing.Stats(static_cast<FrameStage>(i)); }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteResult(
+  std::ostream & out
+, GraphicsContext const & context
+, RunResult const & result
+) {
+  out
+    << fmt::format(
+         "{{\"scenario\":\"{}\",\"device\":\"{}\",\"framesInFlight\":{},"
+         "\"threads\":{},\"presentMode\":\"{}\""
+       , ToName(scenarioNames, result.scenario)
+       , EscapeJson(context.deviceProperties.deviceName.data())
+       , result.framesInFlight
+       , result.threads
+       , result.presentMode
+       );
+
+  if (!result.skipped.empty()) {
+    out << fmt::format(",\"skipped\":\"{}\"}}\n", result.skipped);
+    return;
+  }
+
+  auto const & frame = result.stages[static_cast<size_t>(FrameStage::Frame)];
+  out
+    << fmt::format(
+         ",\"frames\":{},\"seconds\":{:.6f},\"fps\":{:.3f},"
+         "\"frameMs\":{{\"mean\":{:.4f},\"p50\":{:.4f},\"p99\":{:.4f},"
+         "\"p999\":{:.4f},\"max\":{:.4f}}},\"peakDeviceBytes\":{}"
+       , result.frames, result.seconds
+       , result.seconds > 0.0 ? result.frames / result.seconds : 0.0
+       , frame.meanMs, frame.p50Ms, frame.p99Ms, frame.p999Ms, frame.maxMs
+       , result.peakDeviceBytes
+       );
+
+  if (result.stream) {
+    out
+      << fmt::format(
+           ",\"stream\":{{\"textures\":{},\"budget\":{},"
+           "\"peakResident\":{},\"uploaded\":{},\"raises\":{},"
+           "\"evictions\":{}}}"
+         , result.stream->textureCount, result.stream->budgetBytes
+         , result.streamPeakBytes, result.stream->uploadedBytes
+         , result.stream->raises, result.stream->evictions
+         );
+  }
+
+  if (result.graphFailures)
+    { out << fmt::format(",\"graphFailures\":{}", *result.graphFailures); }
+
+  out << ",\"stageMs\":{";
+  bool first = true;
+  for (uint32_t i = 0; i < static_cast<uint32_t>(FrameStage::Count); ++ i) {
+    auto const stage = static_cast<FrameStage>(i);
+    auto const & stats = result.stages[i];
+    if (stage == FrameStage::Frame || stats.count == 0) { continue; }
+    out
+      << fmt::format(
+           "{}\"{}\":{{\"mean\":{:.4f},\"p50\":{:.4f},\"p99\":{:.4f}}}"
+         , first ? "" : ","
+         , ToString(stage), stats.meanMs, stats.p50Ms, stats.p99Ms
+         );
+    first = false;
+  }
+  out << "}}\n";
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char ** argv) {
+  // stdout carries the results
+  spdlog::set_default_logger(spdlog::stderr_color_mt("dtq_bench"));
+
+  auto const options = ParseOptions(argc, argv);
+
+  JobSystem jobs(options.workers);
+
+  GraphicsContextCreateInfo contextCI;
+  contextCI.headless = !options.windowed;
+  contextCI.windowSize = options.extent;
+
+  auto context = GraphicsContext::Construct(contextCI);
+  if (!context.device) { return 1; }
+  LogDiagnosticInfo(context);
+
+  std::ofstream outputFile;
+  if (!options.outputPath.empty()) {
+    outputFile.open(options.outputPath, std::ios::trunc);
+    if (!outputFile) {
+      spdlog::critical("Could not open '{}'", options.outputPath);
+      return 1;
+    }
+  }
+  std::ostream & out = options.outputPath.empty() ? std::cout : outputFile;
+
+  // one swapchain for every run, retargeted per present mode, since it owns
+  // the context's surface
+  std::unique_ptr<Swapchain> swapchain;
+  if (options.windowed)
+    { swapchain = std::make_unique<Swapchain>(context, context.surface); }
+
+  std::vector<std::optional<vk::PresentModeKHR>> presentModes { std::nullopt };
+  if (options.windowed) {
+    presentModes.clear();
+    for (auto const mode : options.presentModes)
+      { presentModes.emplace_back(mode); }
+  }
+
+  bool checksFailed = false;
+  for (auto const scenario : options.scenarios)
+  for (auto const framesInFlight : options.framesInFlight)
+  for (auto const presentMode : presentModes) {
+    spdlog::info(
+      "Running '{}' with {} frames in flight{}{}"
+    , ToName(scenarioNames, scenario), framesInFlight
+    , presentMode ? ", present mode " : ""
+    , presentMode ? ToName(presentModeNames, *presentMode) : ""
+    );
+    auto const result =
+      Run(
+        context, jobs, options, scenario, framesInFlight
+      , swapchain.get(), presentMode.value_or(vk::PresentModeKHR::eFifo)
+      );
+    WriteResult(out, context, result);
+    out.flush();
+    checksFailed = checksFailed || result.graphFailures.value_or(0) > 0;
+  }
+
+  context.device->waitIdle();
+
+  // so the graph scenario can gate a run, ei. on a software ICD
+  return checksFailed ? 1 : 0;
+}
@@ -0,0 +1,334 @@
+#include "bindless.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+vk::DescriptorType DescriptorType(BindlessKind kind) {
+  switch (kind) {
+    case BindlessKind::SampledImage:  return vk::DescriptorType::eSampledImage;
+    case BindlessKind::StorageBuffer: return vk::DescriptorType::eStorageBuffer;
+    case BindlessKind::Sampler:       return vk::DescriptorType::eSampler;
+    case BindlessKind::Count:         break;
+  }
+  return vk::DescriptorType::eSampler;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+char const * ToString(BindlessKind kind) {
+  switch (kind) {
+    case BindlessKind::SampledImage:  return "sampled image";
+    case BindlessKind::StorageBuffer: return "storage buffer";
+    case BindlessKind::Sampler:       return "sampler";
+    case BindlessKind::Count:         break;
+  }
+  return "?";
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+BindlessHeap::BindlessHeap(
+  GraphicsContext & context_
+, BindlessHeapCreateInfo const & ci
+)
+: context{&context_}
+{
+  auto & device = this->context->device;
+  auto const & features12 = this->context->enabledFeatures12;
+
+  if (!features12.descriptorIndexing
+   || !features12.runtimeDescriptorArray
+   || !features12.descriptorBindingPartiallyBound
+   || !features12.descriptorBindingSampledImageUpdateAfterBind
+   || !features12.descriptorBindingStorageBufferUpdateAfterBind
+  ) {
+    // an update-after-bind layout would be invalid usage, leave the heap
+    // unusable instead; every Add returns invalidBindlessHandle
+    spdlog::critical("Device lacks the descriptor indexing the heap needs");
+    return;
+  }
+
+  // both the per-stage & the whole-set limits bound each array
+  auto const properties =
+    this->context->physicalDevice.getProperties2<
+      vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties
+    >();
+  auto const & limits12 =
+    properties.get<vk::PhysicalDeviceVulkan12Properties>();
+
+  auto & sampledImages = this->slots[
+    static_cast<size_t>(BindlessKind::SampledImage)
+  ];
+  sampledImages.capacity =
+    std::min({
+      ci.sampledImageCount
+    , limits12.maxPerStageDescriptorUpdateAfterBindSampledImages
+    , limits12.maxDescriptorSetUpdateAfterBindSampledImages
+    });
+
+  auto & storageBuffers = this->slots[
+    static_cast<size_t>(BindlessKind::StorageBuffer)
+  ];
+  storageBuffers.capacity =
+    std::min({
+      ci.storageBufferCount
+    , limits12.maxPerStageDescriptorUpdateAfterBindStorageBuffers
+    , limits12.maxDescriptorSetUpdateAfterBindStorageBuffers
+    });
+
+  auto & samplers = this->slots[static_cast<size_t>(BindlessKind::Sampler)];
+  samplers.capacity =
+    std::min({
+      ci.samplerCount
+    , limits12.maxPerStageDescriptorUpdateAfterBindSamplers
+    , limits12.maxDescriptorSetUpdateAfterBindSamplers
+    });
+
+  // and together they may not pass the per-stage total, halve the largest
+  // array until they fit or every array is down to a single slot
+  while (
+    uint64_t{sampledImages.capacity} + storageBuffers.capacity
+  + samplers.capacity
+  > limits12.maxPerStageUpdateAfterBindResources
+  ) {
+    auto & largest =
+      *std::max_element(
+        this->slots.begin(), this->slots.end()
+      , [](Slots const & a, Slots const & b) {
+          return a.capacity < b.capacity;
+        }
+      );
+    if (largest.capacity <= 1) {
+      spdlog::critical(
+        "Bindless heap can't fit maxPerStageUpdateAfterBindResources ({})"
+      , limits12.maxPerStageUpdateAfterBindResources
+      );
+      break;
+    }
+    largest.capacity /= 2;
+  }
+
+  std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+  std::array<vk::DescriptorBindingFlags, 3> bindingFlags;
+  std::array<vk::DescriptorPoolSize, 3> poolSizes;
+  for (uint32_t i = 0; i < bindings.size(); ++ i) {
+    auto const kind = static_cast<BindlessKind>(i);
+    bindings[i].binding = i;
+    bindings[i].descriptorType = DescriptorType(kind);
+    bindings[i].descriptorCount = this->slots[i].capacity;
+    bindings[i].stageFlags = vk::ShaderStageFlagBits::eAll;
+
+    // unwritten & freed slots are never read, and slots no pending command
+    // buffer reads may change while the set is bound
+    bindingFlags[i] =
+      vk::DescriptorBindingFlagBits::ePartiallyBound
+    | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+    if (features12.descriptorBindingUpdateUnusedWhilePending) {
+      bindingFlags[i] |=
+        vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+    }
+
+    poolSizes[i] =
+      vk::DescriptorPoolSize { DescriptorType(kind), this->slots[i].capacity };
+  }
+
+  vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI;
+  bindingFlagsCI.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsCI.pBindingFlags = bindingFlags.data();
+
+  vk::DescriptorSetLayoutCreateInfo setLayoutCI;
+  setLayoutCI.pNext = &bindingFlagsCI;
+  setLayoutCI.flags =
+    vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+  setLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+  setLayoutCI.pBindings = bindings.data();
+  this->setLayout =
+    CheckReturn(
+      device->createDescriptorSetLayoutUnique(setLayoutCI),
+      "Creating bindless descriptor set layout"
+    );
+
+  vk::DescriptorPoolCreateInfo poolCI;
+  poolCI.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+  poolCI.maxSets = 1;
+  poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolCI.pPoolSizes = poolSizes.data();
+  this->pool =
+    CheckReturn(
+      device->createDescriptorPoolUnique(poolCI),
+      "Creating bindless descriptor pool"
+    );
+
+  vk::DescriptorSetAllocateInfo setAI;
+  setAI.descriptorPool = *this->pool;
+  setAI.descriptorSetCount = 1;
+  setAI.pSetLayouts = &*this->setLayout;
+  this->set =
+    CheckReturn(
+      device->allocateDescriptorSets(setAI),
+      "Allocating bindless descriptor set"
+    )[0];
+
+  vk::PushConstantRange pushConstants;
+  pushConstants.stageFlags = vk::ShaderStageFlagBits::eAll;
+  pushConstants.offset = 0;
+  pushConstants.size =
+    std::min(
+      ci.pushConstantBytes
+    , this->context->deviceProperties.limits.maxPushConstantsSize
+    );
+
+  vk::PipelineLayoutCreateInfo layoutCI;
+  layoutCI.setLayoutCount = 1;
+  layoutCI.pSetLayouts = &*this->setLayout;
+  layoutCI.pushConstantRangeCount = pushConstants.size > 0 ? 1 : 0;
+  layoutCI.pPushConstantRanges = &pushConstants;
+  this->pipelineLayout =
+    CheckReturn(
+      device->createPipelineLayoutUnique(layoutCI),
+      "Creating bindless pipeline layout"
+    );
+
+  spdlog::info(
+    "Bindless heap of {} sampled images, {} storage buffers, {} samplers"
+  , sampledImages.capacity, storageBuffers.capacity, samplers.capacity
+  );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BindlessHandle BindlessHeap::Allocate(BindlessKind kind) {
+  auto & slots = this->slots[static_cast<size_t>(kind)];
+  if (!slots.freeList.empty()) {
+    auto const handle = slots.freeList.back();
+    slots.freeList.pop_back();
+    slots.isFree[handle] = false;
+    return handle;
+  }
+  if (slots.used < slots.capacity) {
+    slots.isFree.push_back(false);
+    return slots.used ++;
+  }
+
+  spdlog::error("Bindless heap is out of {} slots", ToString(kind));
+  return invalidBindlessHandle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BindlessHeap::Write(
+  BindlessKind kind
+, BindlessHandle handle
+, vk::DescriptorImageInfo const * imageInfo
+, vk::DescriptorBufferInfo const * bufferInfo
+) {
+  vk::WriteDescriptorSet write;
+  write.dstSet = this->set;
+  write.dstBinding = static_cast<uint32_t>(kind);
+  write.dstArrayElement = handle;
+  write.descriptorCount = 1;
+  write.descriptorType = DescriptorType(kind);
+  write.pImageInfo = imageInfo;
+  write.pBufferInfo = bufferInfo;
+  this->context->device->updateDescriptorSets(write, {});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BindlessHandle BindlessHeap::AddSampledImage(
+  vk::ImageView const & view
+, vk::ImageLayout layout
+) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto const handle = this->Allocate(BindlessKind::SampledImage);
+  if (handle == invalidBindlessHandle) { return handle; }
+
+  vk::DescriptorImageInfo imageInfo { nullptr, view, layout };
+  this->Write(BindlessKind::SampledImage, handle, &imageInfo, nullptr);
+  return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BindlessHandle BindlessHeap::AddStorageBuffer(
+  vk::Buffer const & buffer
+, vk::DeviceSize offset
+, vk::DeviceSize range
+) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto const handle = this->Allocate(BindlessKind::StorageBuffer);
+  if (handle == invalidBindlessHandle) { return handle; }
+
+  vk::DescriptorBufferInfo bufferInfo { buffer, offset, range };
+  this->Write(BindlessKind::StorageBuffer, handle, nullptr, &bufferInfo);
+  return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BindlessHandle BindlessHeap::AddSampler(vk::Sampler const & sampler) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto const handle = this->Allocate(BindlessKind::Sampler);
+  if (handle == invalidBindlessHandle) { return handle; }
+
+  vk::DescriptorImageInfo imageInfo { sampler, nullptr, {} };
+  this->Write(BindlessKind::Sampler, handle, &imageInfo, nullptr);
+  return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BindlessHeap::UpdateSampledImage(
+  BindlessHandle handle
+, vk::ImageView const & view
+, vk::ImageLayout layout
+) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  vk::DescriptorImageInfo imageInfo { nullptr, view, layout };
+  this->Write(BindlessKind::SampledImage, handle, &imageInfo, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BindlessHeap::Free(BindlessKind kind, BindlessHandle handle) {
+  if (handle == invalidBindlessHandle) { return; }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto & slots = this->slots[static_cast<size_t>(kind)];
+  if (handle >= slots.used) {
+    spdlog::error(
+      "Freeing {} handle {} that was never allocated", ToString(kind), handle
+    );
+    return;
+  }
+  if (slots.isFree[handle]) {
+    spdlog::error("Freeing {} handle {} twice", ToString(kind), handle);
+    return;
+  }
+
+  // the stale descriptor stays, partially bound lets nothing read it
+  slots.isFree[handle] = true;
+  slots.freeList.push_back(handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t BindlessHeap::Capacity(BindlessKind kind) const {
+  return this->slots[static_cast<size_t>(kind)].capacity;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t BindlessHeap::LiveCount(BindlessKind kind) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto const & slots = this->slots[static_cast<size_t>(kind)];
+  return slots.used - static_cast<uint32_t>(slots.freeList.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BindlessHeap::Bind(
+  vk::CommandBuffer const & commandBuffer
+, vk::PipelineBindPoint bindPoint
+) const {
+  if (!this->set) { return; }
+  commandBuffer.bindDescriptorSets(
+    bindPoint, *this->pipelineLayout, 0, this->set, {}
+  );
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+// the bindings of the heap's set, mirrored by shaders/bindless.glsl
+enum class BindlessKind : uint32_t {
+  SampledImage,  // binding 0, texture2D textures[]
+  StorageBuffer, // binding 1, buffer arrays declared per use
+  Sampler,       // binding 2, sampler samplers[]
+  Count
+};
+
+// index into the array of its kind, what shaders receive (ei. through push
+// constants) in place of a descriptor set
+using BindlessHandle = uint32_t;
+inline constexpr BindlessHandle invalidBindlessHandle = ~0u;
+
+////////////////////////////////////////////////////////////////////////////////
+struct BindlessHeapCreateInfo {
+  // clamped to the device's update-after-bind limits
+  uint32_t sampledImageCount  = 1u << 16;
+  uint32_t storageBufferCount = 1u << 16;
+  uint32_t samplerCount       = 1u << 10;
+  uint32_t pushConstantBytes  = 128; // the guaranteed minimum
+};
+
+// one global descriptor set of large update-after-bind arrays, bound once per
+// command buffer at set 0 of a shared pipeline layout; resources are written
+// into free slots and referenced by handle, so draws never allocate or bind
+// descriptor sets. Requires descriptor indexing (enabledFeatures12). Thread
+// safe. A freed slot is reused right away, so free a handle only once the
+// frames that might read it have retired, ei. through DeferDestroy.
+class BindlessHeap {
+private:
+  struct Slots {
+    uint32_t capacity = 0;
+    uint32_t used = 0; // slots below this have been handed out at least once
+    std::vector<BindlessHandle> freeList;
+    std::vector<bool> isFree; // per slot below used, catches double frees
+  };
+
+  GraphicsContext* context = nullptr;
+
+  vk::UniqueDescriptorSetLayout setLayout;
+  vk::UniqueDescriptorPool pool;
+  vk::DescriptorSet set;
+  vk::UniquePipelineLayout pipelineLayout;
+
+  std::mutex mutex;
+  std::array<Slots, static_cast<size_t>(BindlessKind::Count)> slots;
+
+  BindlessHandle Allocate(BindlessKind kind);
+  void Write(
+    BindlessKind kind
+  , BindlessHandle handle
+  , vk::DescriptorImageInfo const * imageInfo
+  , vk::DescriptorBufferInfo const * bufferInfo
+  );
+
+public:
+  BindlessHeap(
+    GraphicsContext & context_
+  , BindlessHeapCreateInfo const & ci = {}
+  );
+  BindlessHeap(BindlessHeap const &) = delete;
+  BindlessHeap(BindlessHeap &&) = delete;
+
+  // returns invalidBindlessHandle once the array of that kind is full
+  BindlessHandle AddSampledImage(
+    vk::ImageView const & view
+  , vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal
+  );
+  BindlessHandle AddStorageBuffer(
+    vk::Buffer const & buffer
+  , vk::DeviceSize offset = 0
+  , vk::DeviceSize range = VK_WHOLE_SIZE
+  );
+  BindlessHandle AddSampler(vk::Sampler const & sampler);
+
+  // points an existing slot at another resource, ei. a streamed-in mip chain
+  void UpdateSampledImage(
+    BindlessHandle handle
+  , vk::ImageView const & view
+  , vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal
+  );
+
+  // handles that were never handed out or are already free are rejected
+  void Free(BindlessKind kind, BindlessHandle handle);
+
+  // false if the device lacks the features, nothing can be added then
+  bool IsValid() const { return static_cast<bool>(set); }
+
+  uint32_t Capacity(BindlessKind kind) const;
+  uint32_t LiveCount(BindlessKind kind);
+
+  vk::DescriptorSetLayout const & SetLayout() const { return *setLayout; }
+  // the heap at set 0 & pushConstantBytes of push constants for every stage,
+  // pipelines that only use bindless resources all share it
+  vk::PipelineLayout const & PipelineLayout() const { return *pipelineLayout; }
+
+  void Bind(
+    vk::CommandBuffer const & commandBuffer
+  , vk::PipelineBindPoint bindPoint
+  ) const;
+};
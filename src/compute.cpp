@@ -0,0 +1,124 @@
+#include "compute.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+AsyncCompute::AsyncCompute(
+  GraphicsContext & context_
+, uint32_t framesInFlight
+)
+: context{&context_}
+{
+  this->async =
+    this->context->computeQueueIdx != this->context->graphicsQueueIdx;
+
+  if (this->async) {
+    this->submits = this->context->computeSubmits;
+    this->queueFamilyIdx = this->context->computeQueueIdx;
+  } else {
+    this->submits = this->context->graphicsSubmits;
+    this->queueFamilyIdx = this->context->graphicsQueueIdx;
+  }
+
+  spdlog::info(
+    "Compute submits to queue family {}{}"
+  , this->queueFamilyIdx, this->async ? " (async)" : " (graphics fallback)"
+  );
+
+  this->frames.resize(framesInFlight);
+  for (auto & frame : this->frames) {
+    vk::CommandPoolCreateInfo commandPoolCI;
+    commandPoolCI.queueFamilyIndex = this->queueFamilyIdx;
+    commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eTransient;
+    frame.commandPool =
+      CheckReturn(
+        this->context->device->createCommandPoolUnique(commandPoolCI),
+        "Creating compute command pool"
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+AsyncCompute::~AsyncCompute() {
+  this->Wait(this->submittedValue);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<uint32_t> AsyncCompute::SharedQueueFamilies() const {
+  if (!this->async) { return { this->context->graphicsQueueIdx }; }
+  return { this->context->graphicsQueueIdx, this->queueFamilyIdx };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AsyncCompute::BeginFrame(uint64_t frameIndex) {
+  this->currentFrame = static_cast<uint32_t>(frameIndex % this->frames.size());
+  auto & frame = this->frames[this->currentFrame];
+
+  this->Wait(frame.lastTimelineValue);
+  this->context->device->resetCommandPool(*frame.commandPool, {});
+  frame.usedCommandBuffers = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::CommandBuffer AsyncCompute::BeginCommands() {
+  auto & frame = this->frames[this->currentFrame];
+
+  if (frame.usedCommandBuffers == frame.commandBuffers.size()) {
+    vk::CommandBufferAllocateInfo commandBufferAI;
+    commandBufferAI.commandPool = *frame.commandPool;
+    commandBufferAI.commandBufferCount = 1;
+    commandBufferAI.level = vk::CommandBufferLevel::ePrimary;
+    frame.commandBuffers.emplace_back(
+      CheckReturn(
+        this->context->device->allocateCommandBuffers(commandBufferAI),
+        "Allocating compute command buffer"
+      )[0]
+    );
+  }
+
+  auto const commandBuffer = frame.commandBuffers[frame.usedCommandBuffers++];
+
+  vk::CommandBufferBeginInfo commandBufferBI;
+  commandBufferBI.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  commandBuffer.begin(commandBufferBI);
+
+  return commandBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t AsyncCompute::Submit(
+  vk::CommandBuffer const & commandBuffer
+, std::vector<SemaphoreSubmit> const & waits
+) {
+  commandBuffer.end();
+
+  auto const value = this->submits->Enqueue({ commandBuffer }, waits);
+  this->submittedValue = value;
+  this->frames[this->currentFrame].lastTimelineValue = value;
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AsyncCompute::Flush() {
+  this->submits->Flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+SemaphoreSubmit AsyncCompute::GraphicsWait(
+  uint64_t value
+, vk::PipelineStageFlags stage
+) const {
+  return this->submits->WaitFor(value, stage);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool AsyncCompute::IsComplete(uint64_t value) {
+  return this->submits->IsComplete(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AsyncCompute::Wait(uint64_t value) {
+  this->submits->Wait(value);
+}
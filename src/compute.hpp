@@ -0,0 +1,74 @@
+#pragma once
+
+#include "graphicscontext.hpp"
+#include "vulkan.hpp"
+
+#include <vector>
+
+// records compute work into per-frame command pools and submits it on the
+// dedicated compute queue, so it overlaps rasterization; when the compute
+// family aliases graphics it falls back to the graphics queue. Ordering with
+// other queues goes through the SubmitQueue's timeline semaphore: graphics
+// waits on GraphicsWait(value), compute waits on whatever graphics signals.
+// Submits are batched, they reach the GPU with the next Flush, the next
+// flush of a queue waiting on them, or a Wait.
+//
+// Resources touched by both queues should be created with
+// vk::SharingMode::eConcurrent over SharedQueueFamilies().
+class AsyncCompute {
+private:
+  struct FrameResources {
+    vk::UniqueCommandPool commandPool;
+    std::vector<vk::CommandBuffer> commandBuffers;
+    uint32_t usedCommandBuffers = 0;
+    uint64_t lastTimelineValue = 0;
+  };
+
+  GraphicsContext* context = nullptr;
+
+  SubmitQueue* submits = nullptr;
+  uint32_t queueFamilyIdx = 0;
+  bool async = false;
+
+  uint64_t submittedValue = 0;
+
+  std::vector<FrameResources> frames;
+  uint32_t currentFrame = 0;
+
+public:
+  AsyncCompute(GraphicsContext & context_, uint32_t framesInFlight);
+  ~AsyncCompute();
+  AsyncCompute(AsyncCompute const &) = delete;
+  AsyncCompute(AsyncCompute &&) = delete;
+
+  // false when compute work shares the graphics queue
+  bool IsAsync() const { return async; }
+
+  vk::Semaphore const & Timeline() const { return submits->Timeline(); }
+
+  std::vector<uint32_t> SharedQueueFamilies() const;
+
+  // recycles the command pool of the frame slot, only blocks if the compute
+  // work submitted framesInFlight frames ago is somehow still running
+  void BeginFrame(uint64_t frameIndex);
+
+  // returns a begun, one-time-submit command buffer from the current frame
+  vk::CommandBuffer BeginCommands();
+
+  // ends & enqueues, returns the timeline value signalled on completion
+  uint64_t Submit(
+    vk::CommandBuffer const & commandBuffer
+  , std::vector<SemaphoreSubmit> const & waits = {}
+  );
+  // hands everything submitted so far to the GPU
+  void Flush();
+
+  // the wait a graphics submit needs to consume the results of value
+  SemaphoreSubmit GraphicsWait(
+    uint64_t value
+  , vk::PipelineStageFlags stage
+  ) const;
+
+  bool IsComplete(uint64_t value);
+  void Wait(uint64_t value);
+};
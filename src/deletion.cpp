@@ -0,0 +1,131 @@
+#include "deletion.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <iterator>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////
+DeletionQueue::DeletionQueue(GraphicsContext const & context_)
+: context{&context_}
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+DeletionQueue::~DeletionQueue() {
+  if (this->pending > 0) {
+    spdlog::error(
+      "Deletion queue destroyed with {} resources pending", this->pending
+    );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeletionQueue::DeletionQueue(DeletionQueue && other)
+: context{other.context}
+, batches{std::move(other.batches)}
+, pending{std::exchange(other.pending, 0)}
+{
+  other.batches.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeletionQueue & DeletionQueue::operator=(DeletionQueue && other) {
+  if (this->pending > 0) {
+    spdlog::error(
+      "Deletion queue overwritten with {} resources pending", this->pending
+    );
+  }
+  this->context = other.context;
+  this->batches = std::move(other.batches);
+  this->pending = std::exchange(other.pending, 0);
+  other.batches.clear();
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeletionQueue::Batch & DeletionQueue::BatchFor(uint64_t value) {
+  // nearly always the newest value, so search from the back
+  auto it = this->batches.end();
+  while (it != this->batches.begin() && std::prev(it)->value > value)
+    { -- it; }
+  if (it != this->batches.begin() && std::prev(it)->value == value)
+    { return *std::prev(it); }
+
+  Batch batch;
+  batch.value = value;
+  return *this->batches.insert(it, std::move(batch));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Destroy(uint64_t value, vk::Framebuffer framebuffer) {
+  this->BatchFor(value).framebuffers.emplace_back(framebuffer);
+  ++ this->pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Destroy(uint64_t value, vk::ImageView view) {
+  this->BatchFor(value).imageViews.emplace_back(view);
+  ++ this->pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Destroy(uint64_t value, Image image) {
+  this->BatchFor(value).images.emplace_back(image);
+  ++ this->pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Destroy(uint64_t value, Buffer buffer) {
+  this->BatchFor(value).buffers.emplace_back(buffer);
+  ++ this->pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Destroy(uint64_t value, std::function<void()> destroy) {
+  this->BatchFor(value).callbacks.emplace_back(std::move(destroy));
+  ++ this->pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Free(Batch & batch) {
+  auto const & device = this->context->device;
+  auto & allocator = *this->context->allocator;
+
+  // views & framebuffers before the images they reference
+  for (auto const & framebuffer : batch.framebuffers)
+    { device->destroyFramebuffer(framebuffer); }
+  for (auto const & view : batch.imageViews)
+    { device->destroyImageView(view); }
+  for (auto & image : batch.images)
+    { allocator.DestroyImage(image); }
+  for (auto & buffer : batch.buffers)
+    { allocator.DestroyBuffer(buffer); }
+  for (auto & destroy : batch.callbacks)
+    { destroy(); }
+
+  this->pending -=
+    batch.framebuffers.size() + batch.imageViews.size() + batch.images.size()
+  + batch.buffers.size() + batch.callbacks.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t DeletionQueue::Collect(uint64_t completedValue) {
+  auto const before = this->pending;
+  while (
+    !this->batches.empty()
+ && this->batches.front().value <= completedValue
+  ) {
+    this->Free(this->batches.front());
+    this->batches.pop_front();
+  }
+  return before - this->pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DeletionQueue::Flush() {
+  for (auto & batch : this->batches)
+    { this->Free(batch); }
+  this->batches.clear();
+}
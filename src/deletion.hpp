@@ -0,0 +1,59 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "vulkan.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+// resources queued for destruction under the value of whatever last used
+// them & freed in bulk once that value has retired, so releasing an object
+// never waits on the GPU. Values only have to grow with completion: frame
+// indices for FrameRing, or a SubmitQueue's timeline values collected against
+// its CompletedValue. Resources sharing a value share one batch, the common
+// kinds without an allocation each. Not thread safe.
+class DeletionQueue {
+private:
+  struct Batch {
+    uint64_t value = 0;
+    std::vector<vk::Framebuffer> framebuffers;
+    std::vector<vk::ImageView> imageViews;
+    std::vector<Image> images;
+    std::vector<Buffer> buffers;
+    // run in order, after the above
+    std::vector<std::function<void()>> callbacks;
+  };
+
+  GraphicsContext const* context = nullptr;
+  std::deque<Batch> batches; // ascending values
+  size_t pending = 0;
+
+  Batch & BatchFor(uint64_t value);
+  void Free(Batch & batch);
+
+public:
+  DeletionQueue() = default;
+  explicit DeletionQueue(GraphicsContext const & context_);
+  ~DeletionQueue();
+  DeletionQueue(DeletionQueue && other);
+  DeletionQueue & operator=(DeletionQueue && other);
+
+  // -- destroyed once Collect is handed a value at or above value
+  void Destroy(uint64_t value, vk::Framebuffer framebuffer);
+  void Destroy(uint64_t value, vk::ImageView view);
+  void Destroy(uint64_t value, Image image);
+  void Destroy(uint64_t value, Buffer buffer);
+  void Destroy(uint64_t value, std::function<void()> destroy);
+
+  // frees every batch at or below completedValue, returns how many resources
+  // that was
+  size_t Collect(uint64_t completedValue);
+  // frees everything; only valid once the device is idle
+  void Flush();
+
+  size_t Pending() const { return pending; }
+};
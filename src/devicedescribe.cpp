@@ -0,0 +1,73 @@
+#include "deviceselect.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+DeviceCandidate DescribeDevice(
+  vk::PhysicalDevice const & physicalDevice
+, uint32_t index
+, vk::SurfaceKHR const & surface
+) {
+  DeviceCandidate self;
+  self.index = index;
+
+  auto const properties =
+    physicalDevice.getProperties2<
+      vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties
+    >();
+  auto const & core =
+    properties.get<vk::PhysicalDeviceProperties2>().properties;
+  self.name = core.deviceName.data();
+  self.type = core.deviceType;
+  self.apiVersion = core.apiVersion;
+  auto const & deviceUuid =
+    properties.get<vk::PhysicalDeviceIDProperties>().deviceUUID;
+  std::copy(deviceUuid.begin(), deviceUuid.end(), self.uuid.begin());
+
+  auto const memory = physicalDevice.getMemoryProperties();
+  for (uint32_t i = 0; i < memory.memoryHeapCount; ++ i) {
+    auto const & heap = memory.memoryHeaps[i];
+    if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+      self.deviceLocalBytes = std::max(self.deviceLocalBytes, heap.size);
+    }
+  }
+
+  auto const families = physicalDevice.getQueueFamilyProperties();
+  for (uint32_t i = 0; i < families.size(); ++ i) {
+    auto const flags = families[i].queueFlags;
+    bool const graphics = !!(flags & vk::QueueFlagBits::eGraphics);
+    bool const compute = !!(flags & vk::QueueFlagBits::eCompute);
+
+    if (graphics) {
+      self.graphicsQueue = true;
+      if (surface && physicalDevice.getSurfaceSupportKHR(i, surface).value)
+        { self.presentQueue = true; }
+    }
+    if (compute && !graphics) { self.dedicatedCompute = true; }
+    if ((flags & vk::QueueFlagBits::eTransfer) && !graphics && !compute)
+      { self.dedicatedTransfer = true; }
+  }
+
+  for (
+    auto const & ext
+  : CheckReturn(
+      physicalDevice.enumerateDeviceExtensionProperties(),
+      "Could not enumerate device extension properties"
+    )
+  ) { self.extensions.emplace_back(ext.extensionName.data()); }
+
+  if (self.apiVersion >= VK_API_VERSION_1_2) {
+    auto const features =
+      physicalDevice.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features
+      >();
+    auto const & features12 =
+      features.get<vk::PhysicalDeviceVulkan12Features>();
+    self.timelineSemaphore = features12.timelineSemaphore;
+    self.descriptorIndexing = features12.descriptorIndexing;
+  }
+
+  return self;
+}
@@ -0,0 +1,243 @@
+#include "deviceselect.hpp"
+
+#include "util.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+std::string Lowercase(std::string_view str) {
+  std::string lower(str);
+  for (auto & c : lower)
+    { c = static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+  return lower;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string FormatUuid(std::array<uint8_t, VK_UUID_SIZE> const & uuid) {
+  std::string str;
+  for (size_t i = 0; i < uuid.size(); ++ i) {
+    if (i == 4 || i == 6 || i == 8 || i == 10) { str.push_back('-'); }
+    str += fmt::format("{:02x}", uuid[i]);
+  }
+  return str;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool HasExtension(DeviceCandidate const & candidate, std::string const & ext) {
+  return
+    std::find(candidate.extensions.begin(), candidate.extensions.end(), ext)
+ != candidate.extensions.end();
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+DeviceScore ScoreDevice(
+  DeviceCandidate const & candidate
+, DeviceRequirements const & requirements
+) {
+  DeviceScore self;
+
+  // -- hard requirements, every failure is listed
+  if (candidate.apiVersion < requirements.minApiVersion) {
+    self.reasons.emplace_back(
+      fmt::format(
+        "Vulkan {}.{} is too old"
+      , VK_VERSION_MAJOR(candidate.apiVersion)
+      , VK_VERSION_MINOR(candidate.apiVersion)
+      )
+    );
+  }
+  if (!candidate.graphicsQueue)
+    { self.reasons.emplace_back("no graphics queue"); }
+  if (requirements.present && !candidate.presentQueue)
+    { self.reasons.emplace_back("can't present to the surface"); }
+  if (!candidate.timelineSemaphore)
+    { self.reasons.emplace_back("no timeline semaphores"); }
+  for (auto const & ext : requirements.requiredExtensions) {
+    if (!HasExtension(candidate, ext))
+      { self.reasons.emplace_back(fmt::format("missing {}", ext)); }
+  }
+
+  if (!self.reasons.empty()) { return self; }
+  self.eligible = true;
+
+  auto const add = [&](int64_t points, std::string reason) {
+    if (points == 0) { return; }
+    self.score += points;
+    self.reasons.emplace_back(fmt::format("{:+} {}", points, reason));
+  };
+
+  // -- type dominates, a CPU device only wins when it is the only one
+  switch (candidate.type) {
+    case vk::PhysicalDeviceType::eDiscreteGpu:   add(1000, "discrete"); break;
+    case vk::PhysicalDeviceType::eIntegratedGpu: add(500, "integrated"); break;
+    case vk::PhysicalDeviceType::eVirtualGpu:    add(250, "virtual"); break;
+    case vk::PhysicalDeviceType::eCpu:           add(-500, "cpu"); break;
+    default: break;
+  }
+
+  // -- 10 per GiB of the largest device-local heap, capped so memory can't
+  //    outweigh the device type
+  constexpr vk::DeviceSize gib = 1024ull*1024ull*1024ull;
+  auto const heapGib =
+    std::min<vk::DeviceSize>(candidate.deviceLocalBytes / gib, 32);
+  add(static_cast<int64_t>(heapGib) * 10, fmt::format("{}GiB local", heapGib));
+
+  // -- queue topology, async compute & copies need their own families
+  if (candidate.dedicatedCompute) { add(100, "dedicated compute"); }
+  if (candidate.dedicatedTransfer) { add(50, "dedicated transfer"); }
+
+  // -- features & extensions worth having
+  if (candidate.descriptorIndexing) { add(50, "descriptor indexing"); }
+  for (auto const & ext : requirements.optionalExtensions) {
+    if (HasExtension(candidate, ext)) { add(10, ext); }
+  }
+
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::optional<DeviceOverride> ParseDeviceOverride(std::string_view spec) {
+  if (spec.empty()) { return std::nullopt; }
+
+  DeviceOverride self;
+
+  if (std::all_of(spec.begin(), spec.end(), [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+  })) {
+    self.kind = DeviceOverride::Kind::Index;
+    self.index =
+      static_cast<uint32_t>(
+        std::strtoul(std::string(spec).c_str(), nullptr, 10)
+      );
+    return self;
+  }
+
+  std::string hex;
+  for (char const c : spec) {
+    if (c != '-') { hex.push_back(c); }
+  }
+  if (
+    hex.size() == 2*VK_UUID_SIZE
+ && std::all_of(hex.begin(), hex.end(), [](char c) {
+      return std::isxdigit(static_cast<unsigned char>(c));
+    })
+  ) {
+    self.kind = DeviceOverride::Kind::Uuid;
+    for (size_t i = 0; i < VK_UUID_SIZE; ++ i) {
+      self.uuid[i] =
+        static_cast<uint8_t>(
+          std::strtoul(hex.substr(2*i, 2).c_str(), nullptr, 16)
+        );
+    }
+    return self;
+  }
+
+  self.kind = DeviceOverride::Kind::Name;
+  self.name = Lowercase(spec);
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool MatchesOverride(
+  DeviceCandidate const & candidate
+, DeviceOverride const & override_
+) {
+  switch (override_.kind) {
+    case DeviceOverride::Kind::Index:
+      return candidate.index == override_.index;
+    case DeviceOverride::Kind::Uuid:
+      return candidate.uuid == override_.uuid;
+    case DeviceOverride::Kind::Name:
+      return
+        Lowercase(candidate.name).find(override_.name) != std::string::npos;
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeviceSelection SelectDevice(
+  std::vector<DeviceCandidate> const & candidates
+, DeviceRequirements const & requirements
+, std::optional<DeviceOverride> const & override_
+) {
+  DeviceSelection self;
+  for (auto const & candidate : candidates)
+    { self.scores.emplace_back(ScoreDevice(candidate, requirements)); }
+
+  if (override_) {
+    bool matchedRejected = false;
+    for (size_t i = 0; i < candidates.size(); ++ i) {
+      if (!MatchesOverride(candidates[i], *override_)) { continue; }
+      if (!self.scores[i].eligible) {
+        matchedRejected = true;
+        continue;
+      }
+      self.chosen = i;
+      self.reason = "matches the override";
+      return self;
+    }
+    self.reason =
+      matchedRejected
+      ? "override only matches rejected devices, scored instead"
+      : "override matches no device, scored instead";
+  }
+
+  for (size_t i = 0; i < candidates.size(); ++ i) {
+    if (!self.scores[i].eligible) { continue; }
+    if (!self.chosen || self.scores[i].score > self.scores[*self.chosen].score)
+      { self.chosen = i; }
+  }
+
+  if (self.reason.empty()) {
+    self.reason = self.chosen ? "highest score" : "every device was rejected";
+  } else {
+    self.reason +=
+      self.chosen ? ", highest score" : ", every device was rejected";
+  }
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LogDeviceSelection(
+  std::vector<DeviceCandidate> const & candidates
+, DeviceSelection const & selection
+) {
+  for (size_t i = 0; i < candidates.size(); ++ i) {
+    auto const & candidate = candidates[i];
+    auto const & score = selection.scores[i];
+    std::string reasons;
+    for (auto const & reason : score.reasons)
+      { reasons += (reasons.empty() ? "" : ", ") + reason; }
+
+    if (score.eligible) {
+      spdlog::info(
+        "Device {} '{}' ({}) scored {}: {}"
+      , candidate.index, candidate.name, FormatUuid(candidate.uuid)
+      , score.score, reasons
+      );
+    } else {
+      spdlog::info(
+        "Device {} '{}' ({}) rejected: {}"
+      , candidate.index, candidate.name, FormatUuid(candidate.uuid), reasons
+      );
+    }
+  }
+
+  if (selection.chosen) {
+    spdlog::info(
+      "Selected device {} '{}', {}"
+    , candidates[*selection.chosen].index, candidates[*selection.chosen].name
+    , selection.reason
+    );
+  } else {
+    spdlog::critical("No usable device, {}", selection.reason);
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// picking the physical device is split in two: DescribeDevice boils a
+// vk::PhysicalDevice down to a DeviceCandidate, everything after that is pure
+// & runs just as well on hand-written candidates, ei. to check what a
+// machine with a given set of adapters would pick. DescribeDevice lives in
+// devicedescribe.cpp, so deviceselect.cpp builds without the Vulkan loader
+
+////////////////////////////////////////////////////////////////////////////////
+struct DeviceCandidate {
+  uint32_t index = 0; // into vkEnumeratePhysicalDevices
+  std::string name;
+  std::array<uint8_t, VK_UUID_SIZE> uuid {};
+  vk::PhysicalDeviceType type = vk::PhysicalDeviceType::eOther;
+  uint32_t apiVersion = 0;
+
+  vk::DeviceSize deviceLocalBytes = 0; // largest device-local heap
+
+  bool graphicsQueue = false;
+  bool presentQueue = false; // a graphics family can present to the surface
+  bool dedicatedCompute = false;  // a compute family without graphics
+  bool dedicatedTransfer = false; // a transfer family without either
+
+  std::vector<std::string> extensions;
+  bool timelineSemaphore = false;
+  bool descriptorIndexing = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct DeviceRequirements {
+  bool present = true; // false when headless
+  uint32_t minApiVersion = VK_API_VERSION_1_2;
+  std::vector<std::string> requiredExtensions;
+  // each one present is worth a little, ei. VK_EXT_memory_budget
+  std::vector<std::string> optionalExtensions;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct DeviceScore {
+  bool eligible = false;
+  int64_t score = 0;
+  // why it was rejected, or else what the score is made of
+  std::vector<std::string> reasons;
+};
+
+// index, name or UUID; ei. "1", "RTX" (case-insensitive substring of the
+// name) or the 32 hex digits of the UUID, dashes optional
+struct DeviceOverride {
+  enum class Kind { Index, Name, Uuid };
+  Kind kind = Kind::Name;
+  uint32_t index = 0;
+  std::string name;
+  std::array<uint8_t, VK_UUID_SIZE> uuid {};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct DeviceSelection {
+  std::optional<size_t> chosen; // into the candidates, none if all rejected
+  std::vector<DeviceScore> scores; // one per candidate
+  std::string reason;
+};
+
+DeviceScore ScoreDevice(
+  DeviceCandidate const & candidate
+, DeviceRequirements const & requirements
+);
+
+// empty spec gives nullopt, as does one that parses as nothing
+std::optional<DeviceOverride> ParseDeviceOverride(std::string_view spec);
+bool MatchesOverride(
+  DeviceCandidate const & candidate
+, DeviceOverride const & override_
+);
+
+// highest eligible score wins, ties go to the lower index; an override that
+// names an eligible device beats scoring, one naming a rejected device is
+// ignored
+DeviceSelection SelectDevice(
+  std::vector<DeviceCandidate> const & candidates
+, DeviceRequirements const & requirements
+, std::optional<DeviceOverride> const & override_ = std::nullopt
+);
+
+void LogDeviceSelection(
+  std::vector<DeviceCandidate> const & candidates
+, DeviceSelection const & selection
+);
+
+// surface may be null when headless
+DeviceCandidate DescribeDevice(
+  vk::PhysicalDevice const & physicalDevice
+, uint32_t index
+, vk::SurfaceKHR const & surface
+);
@@ -0,0 +1,141 @@
+#include "frame.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+FrameRing FrameRing::Construct(
+  GraphicsContext const & context
+, uint32_t framesInFlight
+, std::optional<FrameAllocatorCreateInfo> const & frameAllocatorCI
+) {
+  FrameRing self;
+  self.deletions = DeletionQueue(context);
+
+  if (framesInFlight == 0) {
+    spdlog::error("Frames in flight must be at least 1");
+    framesInFlight = 1;
+  }
+
+  auto & device = context.device;
+  self.frames.resize(framesInFlight);
+  for (auto & frame : self.frames) {
+    frame.acquireComplete =
+      CheckReturn(
+        device->createSemaphoreUnique({}),
+        "Creating frame acquire semaphore"
+      );
+
+    { // command pool
+      vk::CommandPoolCreateInfo commandPoolCI;
+      commandPoolCI.queueFamilyIndex = context.graphicsQueueIdx;
+      commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eTransient;
+      frame.commandPool =
+        CheckReturn(
+          device->createCommandPoolUnique(commandPoolCI),
+          "Creating frame command pool"
+        );
+    }
+
+    { // command buffer
+      vk::CommandBufferAllocateInfo commandBufferAI;
+      commandBufferAI.commandPool = *frame.commandPool;
+      commandBufferAI.commandBufferCount = 1;
+      commandBufferAI.level = vk::CommandBufferLevel::ePrimary;
+      frame.commandBuffer =
+        CheckReturn(
+          device->allocateCommandBuffers(commandBufferAI),
+          "Allocating frame command buffer"
+        )[0];
+    }
+  }
+
+  if (frameAllocatorCI) {
+    self.frameAllocator =
+      std::make_unique<FrameAllocator>(
+        context, framesInFlight, *frameAllocatorCI
+      );
+  }
+
+  return self;
+}
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// advances framesCompleted past every frame whose value the GPU reached
+void RetireFrames(FrameRing & self, uint64_t completedValue) {
+  for (auto const & frame : self.frames) {
+    if (frame.timelineValue != 0 && frame.timelineValue <= completedValue) {
+      self.framesCompleted =
+        std::max(self.framesCompleted, frame.frameIndex + 1);
+    }
+  }
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+FrameContext & BeginFrame(GraphicsContext const & context, FrameRing & self) {
+  auto & frame = self.frames[self.frameIndex % self.frames.size()];
+  auto & graphics = *context.graphicsSubmits;
+
+  graphics.Wait(frame.timelineValue);
+
+  // the timeline signals in submission order, so any frame at or below it is
+  // done too, including ones this context doesn't hold
+  RetireFrames(self, graphics.CompletedValue());
+
+  self.deletions.Collect(self.framesCompleted);
+
+  context.device->resetCommandPool(*frame.commandPool, {});
+  frame.frameIndex = self.frameIndex;
+  frame.timelineValue = 0;
+
+  if (self.frameAllocator)
+    { self.frameAllocator->BeginFrame(frame.frameIndex); }
+
+  return frame;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitFrame(
+  GraphicsContext const & context
+, FrameRing & self
+, FrameContext & frame
+, std::vector<SemaphoreSubmit> const & waits
+, std::vector<SemaphoreSubmit> const & signals
+) {
+  // host writes have to be flushed before the submit that reads them
+  if (self.frameAllocator) { self.frameAllocator->EndFrame(); }
+
+  auto & graphics = *context.graphicsSubmits;
+  frame.timelineValue =
+    graphics.Enqueue({ frame.commandBuffer }, waits, signals);
+  graphics.Flush();
+  return frame.timelineValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool IsFrameComplete(
+  GraphicsContext const & context
+, FrameRing & self
+, uint64_t frameIndex
+) {
+  if (frameIndex < self.framesCompleted) { return true; }
+  RetireFrames(self, context.graphicsSubmits->CompletedValue());
+  return frameIndex < self.framesCompleted;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void EndFrame(FrameRing & self) {
+  ++ self.frameIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FlushDeferred(FrameRing & self) {
+  self.deletions.Flush();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "deletion.hpp"
+#include "frameallocator.hpp"
+#include "submit.hpp"
+#include "vulkan.hpp"
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+struct FrameContext {
+  FrameContext() = default;
+
+  // binary, the swapchain can't take timelines; what presenting waits on is
+  // the acquired image's Swapchain::RenderComplete
+  vk::UniqueSemaphore acquireComplete;
+
+  // transient pool reset wholesale each time the frame comes around
+  vk::UniqueCommandPool commandPool;
+  vk::CommandBuffer     commandBuffer;
+
+  // monotonic index of the frame last recorded in this context, and the
+  // graphics timeline value that retires it, 0 until it reached the queue
+  uint64_t frameIndex = 0;
+  uint64_t timelineValue = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct FrameRing {
+  FrameRing() = default;
+
+  std::vector<FrameContext> frames;
+
+  // monotonic index of the next frame, its context is frames[idx % size]
+  uint64_t frameIndex = 0;
+
+  // every frame index below this is known to have finished on the GPU
+  uint64_t framesCompleted = 0;
+
+  // keyed on one past the last frame index that may use each resource, so
+  // collecting against framesCompleted frees exactly the retired ones
+  DeletionQueue deletions;
+
+  // null unless Construct was given its create info; a region per context,
+  // rewound by BeginFrame & flushed by SubmitFrame
+  std::unique_ptr<FrameAllocator> frameAllocator;
+
+  static FrameRing Construct(
+    GraphicsContext const & context
+  , uint32_t framesInFlight
+  , std::optional<FrameAllocatorCreateInfo> const & frameAllocatorCI
+      = std::nullopt
+  );
+};
+
+// blocks only while the CPU is framesInFlight frames ahead of the GPU, ei.
+// until the context about to be reused has retired, then resets its pool,
+// rewinds its frame allocator region and runs any deferred destruction that
+// is now safe
+FrameContext & BeginFrame(GraphicsContext const & context, FrameRing & self);
+
+// flushes the frame allocator, then enqueues the frame's command buffer on the
+// graphics SubmitQueue & flushes it, together with everything else enqueued
+// there this frame, in a single submit; returns the timeline value that
+// retires the frame
+uint64_t SubmitFrame(
+  GraphicsContext const & context
+, FrameRing & self
+, FrameContext & frame
+, std::vector<SemaphoreSubmit> const & waits = {}
+, std::vector<SemaphoreSubmit> const & signals = {}
+);
+
+// non-blocking, whether every frame up to frameIndex has retired
+bool IsFrameComplete(
+  GraphicsContext const & context
+, FrameRing & self
+, uint64_t frameIndex
+);
+
+void EndFrame(FrameRing & self);
+
+// queues destruction of resources referenced by frames up to the current one,
+// freed from BeginFrame once those frames have retired; anything
+// DeletionQueue::Destroy takes, ei. an Image, an ImageView or a callback
+template <typename Resource>
+void DeferDestroy(FrameRing & self, Resource && resource) {
+  self.deletions.Destroy(self.frameIndex + 1, std::forward<Resource>(resource));
+}
+
+// runs every pending destruction; only valid once the device is idle
+void FlushDeferred(FrameRing & self);
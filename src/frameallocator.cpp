@@ -0,0 +1,162 @@
+#include "frameallocator.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <bit>
+
+////////////////////////////////////////////////////////////////////////////////
+FrameAllocator::FrameAllocator(
+  GraphicsContext const & context_
+, uint32_t framesInFlight_
+, FrameAllocatorCreateInfo const & ci
+)
+: context{&context_}
+{
+  auto const & limits = this->context->deviceProperties.limits;
+  this->minUniformAlignment = limits.minUniformBufferOffsetAlignment;
+  this->minStorageAlignment = limits.minStorageBufferOffsetAlignment;
+  this->maxUniformRange = limits.maxUniformBufferRange;
+  this->dynamicRange = std::min(ci.dynamicRange, this->maxUniformRange);
+  this->framesInFlight = std::max(framesInFlight_, 1u);
+
+  // every region starts on an offset any allocation & flush can be aligned
+  // to; the limits are all powers of two
+  auto const regionAlignment =
+    std::max({
+      this->minUniformAlignment, this->minStorageAlignment
+    , limits.minTexelBufferOffsetAlignment, limits.nonCoherentAtomSize
+    , vk::DeviceSize { 256 }
+    });
+  this->regionSize = AlignUp(ci.bytesPerFrame, regionAlignment);
+
+  bool const deviceAddress =
+    this->context->enabledFeatures12.bufferDeviceAddress;
+
+  vk::BufferCreateInfo bufferCI;
+  // padded so offset + dynamicRange never runs past the end
+  bufferCI.size =
+    this->regionSize*this->framesInFlight
+  + AlignUp(this->dynamicRange, regionAlignment);
+  bufferCI.usage = ci.usage;
+  if (deviceAddress)
+    { bufferCI.usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress; }
+  bufferCI.sharingMode = vk::SharingMode::eExclusive;
+
+  AllocationCreateInfo allocationCI;
+  allocationCI.usage = MemoryUsage::CpuToGpu;
+  allocationCI.strategy = AllocationStrategy::Dedicated;
+  allocationCI.category = MemoryCategory::Transient;
+  this->ring = this->context->allocator->CreateBuffer(bufferCI, allocationCI);
+
+  if (!this->ring.allocation.mapped) {
+    spdlog::critical("Frame allocator ring could not be mapped");
+    this->regionSize = 0;
+    return;
+  }
+
+  if (deviceAddress) {
+    vk::BufferDeviceAddressInfo addressInfo;
+    addressInfo.buffer = this->ring.buffer;
+    this->baseAddress = this->context->device->getBufferAddress(addressInfo);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameAllocator::~FrameAllocator() {
+  this->context->allocator->DestroyBuffer(this->ring);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FrameAllocator::BeginFrame(uint64_t frameIndex) {
+  // shares its context's slot, so whatever the region held has retired
+  auto const slot = frameIndex % this->framesInFlight;
+  this->regionBegin = slot * this->regionSize;
+  this->regionEnd = this->regionBegin + this->regionSize;
+  this->head.store(this->regionBegin, std::memory_order_relaxed);
+  this->frameOverflows.store(0, std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameAllocation FrameAllocator::Allocate(
+  vk::DeviceSize size
+, vk::DeviceSize alignment
+) {
+  if (size == 0 || alignment == 0 || !std::has_single_bit(alignment)) {
+    spdlog::error(
+      "Frame allocation of {} bytes aligned to {} is invalid", size, alignment
+    );
+    return FrameAllocation {};
+  }
+
+  // a bump of the shared head, retried only when another thread won the race
+  auto current = this->head.load(std::memory_order_relaxed);
+  vk::DeviceSize offset;
+  do {
+    offset = AlignUp(current, alignment);
+    // the head never passes regionEnd, but aligning it may
+    if (offset > this->regionEnd || size > this->regionEnd - offset) {
+      this->frameOverflows.fetch_add(1, std::memory_order_relaxed);
+      return FrameAllocation {};
+    }
+  } while (
+    !this->head.compare_exchange_weak(
+      current, offset + size, std::memory_order_relaxed
+    )
+  );
+
+  FrameAllocation allocation;
+  allocation.data =
+    static_cast<std::byte*>(this->ring.allocation.mapped) + offset;
+  allocation.buffer = this->ring.buffer;
+  allocation.offset = offset;
+  allocation.size = size;
+  if (this->baseAddress != 0)
+    { allocation.address = this->baseAddress + offset; }
+  return allocation;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameAllocation FrameAllocator::AllocateUniform(vk::DeviceSize size) {
+  if (size > this->dynamicRange) {
+    spdlog::error(
+      "Uniform allocation of {} bytes exceeds the dynamic range of {}"
+    , size, this->dynamicRange
+    );
+    return FrameAllocation {};
+  }
+  return this->Allocate(size, this->minUniformAlignment);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameAllocation FrameAllocator::AllocateStorage(vk::DeviceSize size) {
+  return this->Allocate(size, this->minStorageAlignment);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FrameAllocator::EndFrame() {
+  auto const used =
+    this->head.load(std::memory_order_relaxed) - this->regionBegin;
+  if (used > 0) {
+    // a no-op for coherent memory
+    this->context->allocator->Flush(
+      this->ring.allocation, this->regionBegin, used
+    );
+  }
+  this->peakBytes = std::max(this->peakBytes, used);
+
+  auto const overflows = this->frameOverflows.load(std::memory_order_relaxed);
+  if (overflows > 0) {
+    // once, a region too small for the scene overflows every frame
+    if (this->overflowCount == 0) {
+      spdlog::warn(
+        "Frame allocator overflowed its {} bytes per frame, {} allocations "
+        "dropped"
+      , this->regionSize, overflows
+      );
+    }
+    this->overflowCount += overflows;
+  }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "vulkan.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+struct FrameAllocation {
+  std::byte* data = nullptr; // persistently mapped, write straight into it
+  vk::Buffer buffer;
+  vk::DeviceSize offset = 0; // into buffer, ei. the dynamic offset to bind
+  vk::DeviceSize size = 0;
+  // of the first byte, 0 unless bufferDeviceAddress is enabled
+  vk::DeviceAddress address = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct FrameAllocatorCreateInfo {
+  vk::DeviceSize bytesPerFrame = 4ull*1024ull*1024ull;
+  vk::BufferUsageFlags usage =
+    vk::BufferUsageFlagBits::eUniformBuffer
+  | vk::BufferUsageFlagBits::eStorageBuffer
+  | vk::BufferUsageFlagBits::eVertexBuffer
+  | vk::BufferUsageFlagBits::eIndexBuffer;
+  // largest range a dynamic uniform or storage descriptor over the ring may
+  // be written with, clamped to the device's maxUniformBufferRange
+  vk::DeviceSize dynamicRange = 64ull*1024ull;
+};
+
+// one persistently mapped host-visible buffer split into a region per frame
+// in flight, bump allocated for per-frame constants & dynamic geometry. Owned
+// by a FrameRing asked for one in Construct: its BeginFrame rewinds a region
+// once the frame that last used it has retired, so there is nothing to free,
+// and SubmitFrame flushes what the frame wrote. Allocate takes no lock &
+// never allocates, any number of threads may call it while the frame is
+// recorded as long as their writes are joined before SubmitFrame. Alignments
+// honour the device limits; the buffer is padded by dynamicRange so one
+// descriptor with dynamic offsets covers every allocation.
+class FrameAllocator {
+private:
+  GraphicsContext const* context = nullptr;
+
+  Buffer ring;
+  vk::DeviceAddress baseAddress = 0;
+  vk::DeviceSize regionSize = 0;
+  vk::DeviceSize dynamicRange = 0;
+  uint32_t framesInFlight = 0;
+
+  vk::DeviceSize minUniformAlignment = 1;
+  vk::DeviceSize minStorageAlignment = 1;
+  vk::DeviceSize maxUniformRange = 0;
+
+  // absolute offsets into the ring, the current region is [begin, end)
+  vk::DeviceSize regionBegin = 0;
+  vk::DeviceSize regionEnd = 0;
+  std::atomic<vk::DeviceSize> head {0};
+
+  std::atomic<uint64_t> frameOverflows {0};
+  uint64_t overflowCount = 0;
+  vk::DeviceSize peakBytes = 0;
+
+public:
+  FrameAllocator(
+    GraphicsContext const & context_
+  , uint32_t framesInFlight_
+  , FrameAllocatorCreateInfo const & ci = {}
+  );
+  // only once every frame that used it has retired
+  ~FrameAllocator();
+  FrameAllocator(FrameAllocator const &) = delete;
+  FrameAllocator(FrameAllocator &&) = delete;
+
+  // -- driven by FrameRing
+  // rewinds the region of frameIndex, whose previous user has retired
+  void BeginFrame(uint64_t frameIndex);
+  // flushes what was written to non-coherent memory & reports if the region
+  // overflowed; before the frame is submitted
+  void EndFrame();
+
+  // returns an empty allocation (null data) once the frame's region is full,
+  // for a size of 0 or an alignment that isn't a power of two
+  FrameAllocation Allocate(
+    vk::DeviceSize size
+  , vk::DeviceSize alignment = 16
+  );
+  // aligned to minUniformBufferOffsetAlignment, at most the dynamic range
+  FrameAllocation AllocateUniform(vk::DeviceSize size);
+  // aligned to minStorageBufferOffsetAlignment
+  FrameAllocation AllocateStorage(vk::DeviceSize size);
+
+  template <typename T>
+  FrameAllocation PushUniform(T const & value) {
+    auto allocation = this->AllocateUniform(sizeof(T));
+    if (allocation.data) { std::memcpy(allocation.data, &value, sizeof(T)); }
+    return allocation;
+  }
+
+  // to write descriptors against, every allocation's buffer
+  vk::Buffer const & RingBuffer() const { return ring.buffer; }
+  vk::DeviceSize DynamicRange() const { return dynamicRange; }
+  vk::DeviceSize BytesPerFrame() const { return regionSize; }
+  // high-water mark of a single frame
+  vk::DeviceSize PeakBytes() const { return peakBytes; }
+  // allocations that didn't fit, over every frame
+  uint64_t OverflowCount() const { return overflowCount; }
+};
@@ -3,6 +3,16 @@
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// the GlfwWindow a callback is for
+GlfwWindow * Self(GLFWwindow * window) {
+  return reinterpret_cast<GlfwWindow*>(glfwGetWindowUserPointer(window));
+}
+
+} // -- namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 GlfwWindow::GlfwWindow() {
   glfwInit();
@@ -20,6 +30,53 @@ void GlfwWindow::Construct(glm::uvec2 size) {
 
   this->window =
     glfwCreateWindow(size.x, size.y, "Demo Toad Quill", nullptr, nullptr);
+
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(this->window, &width, &height);
+  this->input.framebufferSize = glm::uvec2(width, height);
+
+  glfwSetWindowUserPointer(this->window, this);
+  glfwSetFramebufferSizeCallback(
+    this->window,
+    [](GLFWwindow * window, int width, int height) {
+      auto self = Self(window);
+      self->input.framebufferSize = glm::uvec2(width, height);
+      self->input.resized = true;
+    }
+  );
+  glfwSetKeyCallback(
+    this->window,
+    [](GLFWwindow * window, int key, int, int action, int) {
+      auto self = Self(window);
+      if (key < 0 || key >= static_cast<int>(inputKeyCount)) { return; }
+      if (action == GLFW_PRESS) { self->input.keys.set(key); }
+      if (action == GLFW_RELEASE) { self->input.keys.reset(key); }
+    }
+  );
+  glfwSetMouseButtonCallback(
+    this->window,
+    [](GLFWwindow * window, int button, int action, int) {
+      auto self = Self(window);
+      if (button < 0 || button >= 32) { return; }
+      auto & buttons = self->input.mouseButtons;
+      if (action == GLFW_PRESS) { buttons |= 1u << button; }
+      if (action == GLFW_RELEASE) { buttons &= ~(1u << button); }
+    }
+  );
+  glfwSetCursorPosCallback(
+    this->window,
+    [](GLFWwindow * window, double x, double y) {
+      auto self = Self(window);
+      self->input.cursor = glm::dvec2(x, y);
+    }
+  );
+  glfwSetScrollCallback(
+    this->window,
+    [](GLFWwindow * window, double x, double y) {
+      auto self = Self(window);
+      self->input.scroll += glm::dvec2(x, y);
+    }
+  );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -67,3 +124,46 @@ bool ShouldWindowClose(GlfwWindow & window) {
 void PollEvents(GlfwWindow & window) {
   glfwPollEvents();
 }
+
+////////////////////////////////////////////////////////////////////////////////
+void WaitEvents(GlfwWindow & window) {
+  glfwWaitEvents();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WaitEventsTimeout(GlfwWindow & window, double seconds) {
+  glfwWaitEventsTimeout(seconds);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WakeEventPump() {
+  glfwPostEmptyEvent();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+InputSnapshot TakeInputSnapshot(GlfwWindow & window) {
+  ++ window.input.sequence;
+  window.input.polledAt = std::chrono::steady_clock::now();
+  window.input.closeRequested = glfwWindowShouldClose(window.window);
+
+  auto const snapshot = window.input;
+  window.input.scroll = glm::dvec2(0.0);
+  window.input.resized = false;
+  return snapshot;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+glm::uvec2 FramebufferSize(GlfwWindow const & window) {
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(window.window, &width, &height);
+  return glm::uvec2(width, height);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double RefreshRate(GlfwWindow const & window) {
+  GLFWmonitor * monitor = glfwGetWindowMonitor(window.window);
+  if (!monitor) { monitor = glfwGetPrimaryMonitor(); }
+  if (!monitor) { return 0.0; }
+  GLFWvidmode const * mode = glfwGetVideoMode(monitor);
+  return mode ? static_cast<double>(mode->refreshRate) : 0.0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "input.hpp"
 #include "vulkan.hpp"
 
 #include <glm/glm.hpp>
@@ -9,6 +10,10 @@
 
 struct GLFWwindow; // -- fwd decl
 
+// GLFW may only be called from the main thread, besides WakeEventPump; jobs
+// that need it go through JobSystem::SubmitMain & the render thread only sees
+// the window through InputSnapshots
+
 struct GlfwWindow {
   GlfwWindow();
   ~GlfwWindow();
@@ -19,6 +24,10 @@ struct GlfwWindow {
 
   GLFWwindow* window = nullptr;
 
+  // kept current by the callbacks as events are pumped, deltas accumulate
+  // until TakeInputSnapshot
+  InputSnapshot input;
+
   void Construct(glm::uvec2 size);
 };
 
@@ -31,3 +40,17 @@ std::vector<std::string> RequiredInstanceExtensions(const GlfwWindow& self);
 
 bool ShouldWindowClose(GlfwWindow & window);
 void PollEvents(GlfwWindow & window);
+// blocks until an event arrives, ei. while the window is minimized
+void WaitEvents(GlfwWindow & window);
+void WaitEventsTimeout(GlfwWindow & window, double seconds);
+// makes a blocked WaitEvents return; callable from any thread
+void WakeEventPump();
+
+// the input as of the last pump, then resets the deltas
+InputSnapshot TakeInputSnapshot(GlfwWindow & window);
+
+glm::uvec2 FramebufferSize(GlfwWindow const & window);
+
+// of the monitor the window is fullscreen on, or else the primary monitor;
+// 0 if unknown
+double RefreshRate(GlfwWindow const & window);
@@ -2,21 +2,33 @@
 
 #include "util.hpp"
 
+#include "deviceselect.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <map>
 #include <set>
 
 #include <spdlog/spdlog.h>
 
 ////////////////////////////////////////////////////////////////////////////////
-GraphicsContext GraphicsContext::Construct() {
+GraphicsContext GraphicsContext::Construct(
+  GraphicsContextCreateInfo const & ci
+) {
   GraphicsContext self;
+  self.headless = ci.headless;
 
-  self.glfwWindow = std::make_unique<GlfwWindow>();
+  if (!self.headless)
+    { self.glfwWindow = std::make_unique<GlfwWindow>(); }
 
   // get extensions
   std::vector<char const*> extensions = {
     VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
   };
-  auto requiredInstanceExt = RequiredInstanceExtensions(*self.glfwWindow);
+  std::vector<std::string> requiredInstanceExt;
+  if (!self.headless)
+    { requiredInstanceExt = RequiredInstanceExtensions(*self.glfwWindow); }
   for (auto const & ext : requiredInstanceExt)
     extensions.emplace_back(ext.c_str());
 
@@ -50,18 +62,61 @@ GraphicsContext GraphicsContext::Construct() {
     self.instance = vk::UniqueInstance(vk::createInstance(info).value);
   }
 
+  // before picking the device, which has to be able to present to it
+  if (!self.headless) {
+    self.glfwWindow->Construct(ci.windowSize);
+    self.surface =
+      ConstructWindowSurface(*self.glfwWindow, self.instance.get());
+  }
+
   { // physical device
     self.physicalDevices = self.instance->enumeratePhysicalDevices().value;
-    self.physicalDevice         = self.physicalDevices[0];
+
+    std::vector<DeviceCandidate> candidates;
+    for (uint32_t i = 0; i < self.physicalDevices.size(); ++ i) {
+      candidates.emplace_back(
+        DescribeDevice(self.physicalDevices[i], i, self.surface)
+      );
+    }
+
+    DeviceRequirements requirements;
+    requirements.present = !self.headless;
+    if (!self.headless) {
+      requirements.requiredExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    }
+    requirements.optionalExtensions = {
+      "VK_EXT_memory_budget"
+    , "VK_KHR_present_id"
+    , "VK_KHR_present_wait"
+    , VK_EXT_DEBUG_MARKER_EXTENSION_NAME
+    };
+
+    char const * const envOverride = std::getenv("DTQ_DEVICE");
+    auto const overrideSpec =
+      envOverride ? std::string(envOverride) : ci.deviceOverride;
+
+    auto const selection =
+      SelectDevice(
+        candidates, requirements, ParseDeviceOverride(overrideSpec)
+      );
+    LogDeviceSelection(candidates, selection);
+
+    // already logged as critical, nothing further can be constructed
+    if (!selection.chosen) {
+      if (self.surface) {
+        self.instance->destroySurfaceKHR(self.surface);
+        self.surface = nullptr;
+      }
+      return self;
+    }
+
+    self.physicalDevice =
+      self.physicalDevices[candidates[*selection.chosen].index];
     self.deviceProperties       = self.physicalDevice.getProperties();
     self.deviceFeatures         = self.physicalDevice.getFeatures();
     self.deviceMemoryProperties = self.physicalDevice.getMemoryProperties();
   }
 
-  self.glfwWindow->Construct(glm::uvec2(640, 480));
-  self.surface =
-    ConstructWindowSurface(*self.glfwWindow, self.instance.get());
-
   { // queue
     self.queueFamilyProperties = self.physicalDevice.getQueueFamilyProperties();
     using QueueTuple = std::tuple<vk::QueueFlags, uint32_t*>;
@@ -117,7 +172,8 @@ GraphicsContext GraphicsContext::Construct() {
     }
 
     std::set<std::string> deviceExtensions;
-    deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    if (!self.headless)
+      { deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME }; }
     /* for (auto & ext : extensions) deviceExtensions.insert(ext); */
 
     for (auto const & ext : deviceExtensions)
@@ -137,12 +193,110 @@ GraphicsContext GraphicsContext::Construct() {
       self.enableDebugMarkers = true;
     }
 
+    // driver budget & usage per heap, polled by the texture streamer
+    if (
+      DeviceExtensionPresent(
+        self.physicalDevice
+      , VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+      )
+    ) {
+      enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+      self.enableMemoryBudget = true;
+    }
+
+    // present id/wait let the swapchain block until a given present reached
+    // the display, see PresentPacer; headers predating them compile it out
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+    vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures;
+    vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures;
+    if (
+      !self.headless
+   && DeviceExtensionPresent(
+        self.physicalDevice
+      , VK_KHR_PRESENT_ID_EXTENSION_NAME
+      )
+   && DeviceExtensionPresent(
+        self.physicalDevice
+      , VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+      )
+    ) {
+      auto const supportedPresent =
+        self.physicalDevice.getFeatures2<
+          vk::PhysicalDeviceFeatures2
+        , vk::PhysicalDevicePresentIdFeaturesKHR
+        , vk::PhysicalDevicePresentWaitFeaturesKHR
+        >();
+      presentIdFeatures.presentId =
+        supportedPresent.get<vk::PhysicalDevicePresentIdFeaturesKHR>()
+          .presentId;
+      presentWaitFeatures.presentWait =
+        supportedPresent.get<vk::PhysicalDevicePresentWaitFeaturesKHR>()
+          .presentWait;
+      if (presentIdFeatures.presentId && presentWaitFeatures.presentWait) {
+        enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        self.enablePresentWait = true;
+      }
+    }
+#endif
+
     if (!enabledExtensions.empty()) {
       deviceCI.enabledExtensionCount =
         static_cast<uint32_t>(enabledExtensions.size());
       deviceCI.ppEnabledExtensionNames = enabledExtensions.data();
     }
 
+    // -- features, only request what the device supports
+    auto const supportedFeatures =
+      self.physicalDevice.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features
+      >();
+    auto const & supported12 =
+      supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>();
+
+    auto const & supported =
+      supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features;
+
+    auto & features = self.enabledFeatures;
+    features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+
+    auto & features12 = self.enabledFeatures12;
+    features12.timelineSemaphore = supported12.timelineSemaphore;
+
+    if (!features12.timelineSemaphore)
+      { spdlog::error("Device does not support timeline semaphores"); }
+
+    // descriptor indexing, for the bindless heap
+    features12.descriptorIndexing = supported12.descriptorIndexing;
+    features12.runtimeDescriptorArray = supported12.runtimeDescriptorArray;
+    features12.descriptorBindingPartiallyBound =
+      supported12.descriptorBindingPartiallyBound;
+    features12.descriptorBindingUpdateUnusedWhilePending =
+      supported12.descriptorBindingUpdateUnusedWhilePending;
+    features12.descriptorBindingSampledImageUpdateAfterBind =
+      supported12.descriptorBindingSampledImageUpdateAfterBind;
+    features12.descriptorBindingStorageBufferUpdateAfterBind =
+      supported12.descriptorBindingStorageBufferUpdateAfterBind;
+    features12.shaderSampledImageArrayNonUniformIndexing =
+      supported12.shaderSampledImageArrayNonUniformIndexing;
+    features12.shaderStorageBufferArrayNonUniformIndexing =
+      supported12.shaderStorageBufferArrayNonUniformIndexing;
+
+    // lets per-frame data be handed to shaders as raw pointers
+    features12.bufferDeviceAddress = supported12.bufferDeviceAddress;
+
+    vk::PhysicalDeviceFeatures2 features2;
+    features2.features = features;
+    features2.pNext = &features12;
+    deviceCI.pNext = &features2;
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+    if (self.enablePresentWait) {
+      features12.pNext = &presentIdFeatures;
+      presentIdFeatures.pNext = &presentWaitFeatures;
+    }
+#endif
+
     self.device =
       vk::UniqueDevice(
         CheckReturn(
@@ -150,10 +304,23 @@ GraphicsContext GraphicsContext::Construct() {
           "Could not create device"
         )
       );
+
+    features12.pNext = nullptr;
   }
 
   { // queue again
-    self.graphicsQueue = self.device->getQueue(self.graphicsQueueIdx, 0);
+    // every queue of a family is created, so families aliasing graphics still
+    // get a queue of their own when the family has enough; otherwise the
+    // vk::Queue is shared and submits to it must be externally synchronized
+    std::map<uint32_t, uint32_t> nextQueueInFamily;
+    auto const getQueue = [&](uint32_t family) {
+      auto const queueCount = self.queueFamilyProperties[family].queueCount;
+      auto const idx = std::min(nextQueueInFamily[family]++, queueCount-1);
+      return self.device->getQueue(family, idx);
+    };
+    self.graphicsQueue = getQueue(self.graphicsQueueIdx);
+    self.computeQueue  = getQueue(self.computeQueueIdx);
+    self.transferQueue = getQueue(self.transferQueueIdx);
   }
 
   { // command pool
@@ -169,6 +336,31 @@ GraphicsContext GraphicsContext::Construct() {
       );
   }
 
+  self.allocator = std::make_unique<DeviceAllocator>(self);
+
+  { // submit queues
+    auto const getSubmits = [&](vk::Queue const & queue, uint32_t family) {
+      for (auto const & submits : self.submitQueues)
+        { if (submits->Queue() == queue) { return submits.get(); } }
+      return
+        self.submitQueues.emplace_back(
+          std::make_unique<SubmitQueue>(self, queue, family)
+        ).get();
+    };
+    self.graphicsSubmits =
+      getSubmits(self.graphicsQueue, self.graphicsQueueIdx);
+    self.computeSubmits = getSubmits(self.computeQueue, self.computeQueueIdx);
+    self.transferSubmits =
+      getSubmits(self.transferQueue, self.transferQueueIdx);
+
+    for (auto const & submits : self.submitQueues) {
+      std::vector<SubmitQueue*> peers;
+      for (auto const & other : self.submitQueues)
+        { if (other != submits) { peers.emplace_back(other.get()); } }
+      submits->SetPeers(std::move(peers));
+    }
+  }
+
   return self;
 }
 
@@ -199,6 +391,36 @@ void LogDiagnosticInfo(GraphicsContext const & self) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> QueryMemoryBudget(
+  GraphicsContext const & context
+) {
+  std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> heaps {};
+  auto const heapCount = context.deviceMemoryProperties.memoryHeapCount;
+
+  if (context.enableMemoryBudget) {
+    auto const properties =
+      context.physicalDevice.getMemoryProperties2<
+        vk::PhysicalDeviceMemoryProperties2
+      , vk::PhysicalDeviceMemoryBudgetPropertiesEXT
+      >();
+    auto const & budget =
+      properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    for (uint32_t i = 0; i < heapCount; ++ i) {
+      heaps[i].budget = budget.heapBudget[i];
+      heaps[i].usage = budget.heapUsage[i];
+    }
+    return heaps;
+  }
+
+  auto const stats = context.allocator->Stats();
+  for (uint32_t i = 0; i < heapCount; ++ i) {
+    heaps[i].budget = context.deviceMemoryProperties.memoryHeaps[i].size;
+    heaps[i].usage = stats.heaps[i].reservedBytes;
+  }
+  return heaps;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 uint32_t FindQueue(
   GraphicsContext const & self
@@ -254,26 +476,53 @@ bool DeviceExtensionPresent(
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Submit(
+vk::UniqueSemaphore CreateTimelineSemaphore(
   GraphicsContext const & context
-, vk::CommandBuffer const & commandBuffer
-, vk::Semaphore const & wait
-, vk::PipelineStageFlags waitStage
-, vk::Semaphore const & signal
-, vk::Fence const & fence
+, uint64_t initialValue
 ) {
-  vk::SubmitInfo submitInfo;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
+  vk::SemaphoreTypeCreateInfo semaphoreTypeCI;
+  semaphoreTypeCI.semaphoreType = vk::SemaphoreType::eTimeline;
+  semaphoreTypeCI.initialValue = initialValue;
 
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = &signal;
+  vk::SemaphoreCreateInfo semaphoreCI;
+  semaphoreCI.pNext = &semaphoreTypeCI;
 
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = &wait;
+  return
+    CheckReturn(
+      context.device->createSemaphoreUnique(semaphoreCI),
+      "Creating timeline semaphore"
+    );
+}
 
-  submitInfo.pWaitDstStageMask = &waitStage;
+////////////////////////////////////////////////////////////////////////////////
+uint64_t TimelineValue(
+  GraphicsContext const & context
+, vk::Semaphore const & timeline
+) {
+  return
+    CheckReturn(
+      context.device->getSemaphoreCounterValue(timeline),
+      "Querying timeline semaphore"
+    );
+}
 
-  submitInfo.signalSemaphoreCount = 1;
-  context.graphicsQueue.submit(submitInfo, fence);
+////////////////////////////////////////////////////////////////////////////////
+void WaitTimeline(
+  GraphicsContext const & context
+, vk::Semaphore const & timeline
+, uint64_t value
+) {
+  vk::SemaphoreWaitInfo waitInfo;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &timeline;
+  waitInfo.pValues = &value;
+
+  vk::Result result = vk::Result::eTimeout;
+  while (vk::Result::eTimeout == result) {
+    result =
+      context.device->waitSemaphores(
+        waitInfo
+      , std::numeric_limits<uint64_t>::max()
+      );
+  }
 }
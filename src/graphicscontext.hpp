@@ -1,10 +1,27 @@
 #pragma once
 
+#include "allocator.hpp"
 #include "glfw.hpp"
+#include "submit.hpp"
 #include "vulkan.hpp"
 
+#include <glm/glm.hpp>
+
+#include <array>
+#include <string>
 #include <vector>
 
+////////////////////////////////////////////////////////////////////////////////
+struct GraphicsContextCreateInfo {
+  // skips GLFW, the surface and the swapchain extension entirely, so the
+  // context can run on machines without a display (e.g. lavapipe in CI)
+  bool headless = false;
+  glm::uvec2 windowSize { 640, 480 };
+  // picks the physical device by index, name or UUID (see DeviceOverride)
+  // instead of by score; the DTQ_DEVICE environment variable wins over it
+  std::string deviceOverride;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 struct GraphicsContext {
   GraphicsContext() = default;
@@ -16,10 +33,16 @@ struct GraphicsContext {
   vk::PhysicalDeviceFeatures deviceFeatures;
   std::vector<vk::QueueFamilyProperties> queueFamilyProperties;
   vk::PhysicalDeviceMemoryProperties deviceMemoryProperties;
+  // the subset of supported features enabled on the device
+  vk::PhysicalDeviceFeatures enabledFeatures;
+  vk::PhysicalDeviceVulkan12Features enabledFeatures12;
   vk::UniqueDevice device;
 
   vk::UniqueCommandPool commandPool;
 
+  // declared after the device so it is destroyed before it
+  std::unique_ptr<DeviceAllocator> allocator;
+
   vk::Queue graphicsQueue;
   vk::Queue computeQueue;
   vk::Queue transferQueue;
@@ -28,16 +51,42 @@ struct GraphicsContext {
   uint32_t computeQueueIdx  = 0;
   uint32_t transferQueueIdx = 0;
 
+  // one per distinct vk::Queue, declared after the device so they are
+  // destroyed (waiting on their work) before it; the pointers below alias
+  // into it and share a SubmitQueue where the queues themselves alias
+  std::vector<std::unique_ptr<SubmitQueue>> submitQueues;
+  SubmitQueue* graphicsSubmits = nullptr;
+  SubmitQueue* computeSubmits  = nullptr;
+  SubmitQueue* transferSubmits = nullptr;
+
   std::unique_ptr<GlfwWindow> glfwWindow;
   vk::SurfaceKHR surface;
 
   bool enableDebugMarkers = false;
+  // VK_KHR_present_id & VK_KHR_present_wait are enabled
+  bool enablePresentWait = false;
+  // VK_EXT_memory_budget is enabled, see QueryMemoryBudget
+  bool enableMemoryBudget = false;
+  bool headless = false;
 
-  static GraphicsContext Construct();
+  // the returned context has no device if no physical device is usable
+  static GraphicsContext Construct(GraphicsContextCreateInfo const & ci = {});
 };
 
 void LogDiagnosticInfo(GraphicsContext const & self);
 
+////////////////////////////////////////////////////////////////////////////////
+struct HeapBudget {
+  vk::DeviceSize budget = 0; // what the process can use before paging starts
+  vk::DeviceSize usage  = 0; // by this process
+};
+
+// per memory heap; from VK_EXT_memory_budget when enabled, otherwise the heap
+// size & what the allocator has reserved out of it
+std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> QueryMemoryBudget(
+  GraphicsContext const & context
+);
+
 uint32_t FindQueue(
   GraphicsContext const & self
 , vk::QueueFlags const & desiredFlags
@@ -49,11 +98,19 @@ bool DeviceExtensionPresent(
 , std::string const & extension
 );
 
-void Submit(
+vk::UniqueSemaphore CreateTimelineSemaphore(
+  GraphicsContext const & context
+, uint64_t initialValue = 0
+);
+
+// non-blocking, the last value the GPU (or host) signalled
+uint64_t TimelineValue(
+  GraphicsContext const & context
+, vk::Semaphore const & timeline
+);
+
+void WaitTimeline(
   GraphicsContext const & context
-, vk::CommandBuffer const & commandBuffer
-, vk::Semaphore const & wait
-, vk::PipelineStageFlags waitStage
-, vk::Semaphore const & signal
-, vk::Fence const & fence
+, vk::Semaphore const & timeline
+, uint64_t value
 );
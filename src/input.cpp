@@ -0,0 +1,42 @@
+#include "input.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+void MergeInput(InputSnapshot & into, InputSnapshot const & next) {
+  auto const scroll = into.scroll + next.scroll;
+  bool const resized = into.resized || next.resized;
+  bool const closeRequested = into.closeRequested || next.closeRequested;
+
+  into = next;
+  into.scroll = scroll;
+  into.resized = resized;
+  into.closeRequested = closeRequested;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void InputChannel::Publish(InputSnapshot const & snapshot) {
+  if (!this->hasPending) {
+    if (this->queue.TryPush(snapshot)) { return; }
+    this->pending = snapshot;
+    this->hasPending = true;
+    return;
+  }
+
+  MergeInput(this->pending, snapshot);
+  if (this->queue.TryPush(this->pending))
+    { this->hasPending = false; }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool InputChannel::Drain(InputSnapshot & latest) {
+  // the deltas only ever cover what this call drained
+  latest.scroll = glm::dvec2(0.0);
+  latest.resized = false;
+
+  bool drained = false;
+  InputSnapshot snapshot;
+  while (this->queue.TryPop(snapshot)) {
+    MergeInput(latest, snapshot);
+    drained = true;
+  }
+  return drained;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "spscqueue.hpp"
+
+#include <glm/glm.hpp>
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+
+// covers every GLFW key code (GLFW_KEY_LAST is 348)
+constexpr size_t inputKeyCount = 512;
+
+////////////////////////////////////////////////////////////////////////////////
+// the window's input as of one pass of the event pump on the main thread
+struct InputSnapshot {
+  uint64_t sequence = 0;
+  std::chrono::steady_clock::time_point polledAt;
+
+  std::bitset<inputKeyCount> keys; // held, by GLFW key code
+  uint32_t mouseButtons = 0;       // held, a bit per GLFW mouse button
+  glm::dvec2 cursor { 0.0 };
+  glm::dvec2 scroll { 0.0 };       // since the previous snapshot
+
+  glm::uvec2 framebufferSize { 0 };
+  bool resized = false; // framebufferSize changed since the previous snapshot
+  bool closeRequested = false;
+};
+
+// folds next into into: latest state, summed scroll, sticky resize & close
+void MergeInput(InputSnapshot & into, InputSnapshot const & next);
+
+// carries snapshots from the main thread's event pump to the render thread
+// without either ever waiting on the other. When the render thread falls so
+// far behind the queue fills, the pump merges into a pending snapshot instead
+// of dropping input & retries on its next pass
+class InputChannel {
+private:
+  SpscQueue<InputSnapshot, 64> queue;
+
+  // -- producer only
+  InputSnapshot pending;
+  bool hasPending = false;
+
+public:
+  // -- main thread
+  void Publish(InputSnapshot const & snapshot);
+  // a snapshot is held back, so the pump shouldn't block on events
+  bool HasPending() const { return hasPending; }
+
+  // -- render thread
+  // merges everything queued into latest, false if nothing was
+  bool Drain(InputSnapshot & latest);
+  // blocks until a snapshot is queued
+  void WaitForInput() const { queue.WaitForItem(); }
+};
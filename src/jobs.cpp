@@ -0,0 +1,287 @@
+#include "jobs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace {
+
+// which system the current thread belongs to & its index in it
+thread_local JobSystem const * currentSystem = nullptr;
+thread_local uint32_t currentThreadIdx = JobSystem::invalidThreadIndex;
+
+// spread thieves over the victims instead of all hitting the next one
+thread_local uint32_t stealOffset = 0;
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::JobSystem(uint32_t workerCount) {
+  this->workers.reserve(workerCount + 1);
+  for (uint32_t i = 0; i < workerCount + 1; ++ i)
+    { this->workers.emplace_back(std::make_unique<Worker>()); }
+
+  currentSystem = this;
+  currentThreadIdx = 0;
+
+  // started once every deque exists, as workers steal from all of them
+  for (uint32_t i = 1; i < workerCount + 1; ++ i) {
+    this->workers[i]->thread =
+      std::thread([this, i]() {
+        currentSystem = this;
+        currentThreadIdx = i;
+        stealOffset = i;
+        this->WorkerLoop(i);
+      });
+  }
+
+  spdlog::info("Running jobs on {} threads", this->ThreadCount());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(this->sleepMutex);
+    this->quit = true;
+  }
+  this->wake.notify_all();
+  for (auto & worker : this->workers) {
+    if (worker->thread.joinable()) { worker->thread.join(); }
+  }
+
+  if (currentSystem == this) {
+    currentSystem = nullptr;
+    currentThreadIdx = invalidThreadIndex;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t JobSystem::DefaultWorkerCount() {
+  // hardware_concurrency may report 0 when it can't tell
+  auto const cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t JobSystem::ThreadIndex() const {
+  return currentSystem == this ? currentThreadIdx : invalidThreadIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Submit(JobFunction function, JobCounter * counter) {
+  if (counter)
+    { counter->pending.fetch_add(1, std::memory_order_relaxed); }
+  this->Push(new Job { std::move(function), counter });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::SubmitMain(JobFunction function, JobCounter * counter) {
+  if (counter)
+    { counter->pending.fetch_add(1, std::memory_order_relaxed); }
+  {
+    std::lock_guard<std::mutex> lock(this->mainMutex);
+    this->mainJobs.push_back(new Job { std::move(function), counter });
+    this->mainJobCount.fetch_add(1, std::memory_order_release);
+  }
+  if (this->mainThreadWake) { this->mainThreadWake(); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::PumpMainThread() {
+  if (!this->IsMainThread()) {
+    spdlog::error("Main thread jobs pumped from another thread");
+    return;
+  }
+  if (this->mainJobCount.load(std::memory_order_acquire) == 0) { return; }
+
+  std::deque<Job*> jobs;
+  {
+    std::lock_guard<std::mutex> lock(this->mainMutex);
+    jobs.swap(this->mainJobs);
+    this->mainJobCount.store(0, std::memory_order_relaxed);
+  }
+  for (auto * job : jobs)
+    { this->Execute(job); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Wait(JobCounter & counter) {
+  auto const threadIdx = this->ThreadIndex();
+  while (!counter.Done()) {
+    if (threadIdx == 0) { this->PumpMainThread(); }
+    if (Job * job = this->FindJob(threadIdx)) {
+      this->Execute(job);
+      continue;
+    }
+    std::this_thread::yield();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::ParallelFor(
+  uint32_t begin
+, uint32_t end
+, uint32_t grain
+, std::function<void(uint32_t first, uint32_t last)> const & function
+) {
+  if (end <= begin) { return; }
+
+  // a few chunks per thread balances uneven work without drowning the deques
+  uint32_t const count = end - begin;
+  uint32_t const maxChunks = this->ThreadCount() * 4;
+  grain = std::max(grain, 1u);
+  uint32_t const chunks = std::min((count + grain - 1) / grain, maxChunks);
+  if (chunks <= 1) {
+    function(begin, end);
+    return;
+  }
+
+  uint32_t const step = (count + chunks - 1) / chunks;
+  JobCounter counter;
+  for (uint32_t first = begin + step; first < end; first += step) {
+    uint32_t const last = std::min(first + step, end);
+    this->Submit(
+      [&function, first, last]() { function(first, last); }, &counter
+    );
+  }
+  function(begin, begin + step);
+  this->Wait(counter);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::WorkerLoop(uint32_t threadIdx) {
+  for (;;) {
+    if (Job * job = this->FindJob(threadIdx)) {
+      this->Execute(job);
+      continue;
+    }
+
+    // a frame's jobs arrive in bursts, so spin a little before sleeping
+    bool found = false;
+    for (uint32_t spin = 0; spin < 64 && !found; ++ spin) {
+      std::this_thread::yield();
+      found = this->queuedJobs.load(std::memory_order_relaxed) > 0;
+    }
+    if (found) { continue; }
+
+    std::unique_lock<std::mutex> lock(this->sleepMutex);
+    this->sleeping.fetch_add(1);
+    this->wake.wait(lock, [this]() {
+      return this->quit || this->queuedJobs.load() > 0;
+    });
+    this->sleeping.fetch_sub(1);
+    if (this->quit) { return; }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Push(Job * job) {
+  auto const threadIdx = this->ThreadIndex();
+  if (threadIdx != invalidThreadIndex) {
+    this->workers[threadIdx]->deque.Push(job);
+  } else {
+    std::lock_guard<std::mutex> lock(this->injectedMutex);
+    this->injected.push_back(job);
+    this->injectedCount.fetch_add(1, std::memory_order_release);
+  }
+
+  // pairs with the sleeper bumping sleeping before it checks queuedJobs, so
+  // one of the two always sees the other
+  this->queuedJobs.fetch_add(1);
+  if (this->sleeping.load() > 0) {
+    std::lock_guard<std::mutex> lock(this->sleepMutex);
+    this->wake.notify_one();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::Job* JobSystem::FindJob(uint32_t threadIdx) {
+  Job * job = nullptr;
+
+  bool found =
+    threadIdx != invalidThreadIndex
+ && this->workers[threadIdx]->deque.Pop(job);
+
+  if (!found && this->injectedCount.load(std::memory_order_acquire) > 0) {
+    std::lock_guard<std::mutex> lock(this->injectedMutex);
+    if (!this->injected.empty()) {
+      job = this->injected.front();
+      this->injected.pop_front();
+      this->injectedCount.fetch_sub(1, std::memory_order_relaxed);
+      found = true;
+    }
+  }
+
+  auto const threadCount = this->ThreadCount();
+  for (uint32_t i = 0; !found && i < threadCount; ++ i) {
+    auto const victim = (stealOffset + i) % threadCount;
+    if (victim == threadIdx) { continue; }
+    found = this->workers[victim]->deque.Steal(job);
+  }
+  ++ stealOffset;
+
+  if (!found) { return nullptr; }
+  this->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+  return job;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Execute(Job * job) {
+  job->function();
+  if (job->counter)
+    { job->counter->pending.fetch_sub(1, std::memory_order_acq_rel); }
+  delete job;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+JobGraph::NodeId JobGraph::Add(
+  JobFunction function
+, std::vector<NodeId> const & dependencies
+) {
+  auto const id = static_cast<NodeId>(this->nodes.size());
+  auto node = std::make_unique<Node>();
+  node->function = std::move(function);
+  for (auto const dependency : dependencies) {
+    if (dependency >= id) {
+      spdlog::error(
+        "Job graph node {} depends on later node {}", id, dependency
+      );
+      continue;
+    }
+    this->nodes[dependency]->successors.emplace_back(id);
+    ++ node->dependencyCount;
+  }
+  this->nodes.emplace_back(std::move(node));
+  return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobGraph::Run(JobSystem & jobs) {
+  for (auto & node : this->nodes)
+    { node->remaining.store(node->dependencyCount, std::memory_order_relaxed); }
+
+  // a node's successors are submitted before it finishes, so the counter
+  // can't reach 0 while anything is left to launch
+  JobCounter counter;
+  for (NodeId id = 0; id < this->nodes.size(); ++ id) {
+    if (this->nodes[id]->dependencyCount == 0)
+      { this->Launch(jobs, counter, id); }
+  }
+  jobs.Wait(counter);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JobGraph::Launch(JobSystem & jobs, JobCounter & counter, NodeId id) {
+  jobs.Submit(
+    [this, &jobs, &counter, id]() {
+      auto & node = *this->nodes[id];
+      node.function();
+      for (auto const successor : node.successors) {
+        auto & next = *this->nodes[successor];
+        if (next.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          { this->Launch(jobs, counter, successor); }
+      }
+    }
+  , &counter
+  );
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using JobFunction = std::function<void()>;
+
+// lock-free deque of Chase & Lev, with the memory orderings of Lê et al.'s C11
+// version: the owning thread pushes & pops at the bottom, any thread steals
+// from the top. Grows when full; outgrown rings are kept until destruction as
+// a thief may still be reading from one
+template <typename T>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+private:
+  struct Ring {
+    int64_t capacity;
+    std::unique_ptr<std::atomic<T>[]> slots;
+
+    explicit Ring(int64_t capacity_)
+    : capacity{capacity_}, slots{std::make_unique<std::atomic<T>[]>(capacity_)}
+    {}
+
+    T Load(int64_t i) const
+      { return slots[i & (capacity-1)].load(std::memory_order_relaxed); }
+    void Store(int64_t i, T value)
+      { slots[i & (capacity-1)].store(value, std::memory_order_relaxed); }
+  };
+
+  std::atomic<int64_t> top { 0 };
+  std::atomic<int64_t> bottom { 0 };
+  std::atomic<Ring*> ring;
+  std::vector<std::unique_ptr<Ring>> rings; // only touched by the owner
+
+public:
+  // capacity must be a power of two
+  explicit WorkStealingDeque(int64_t capacity = 256) {
+    rings.emplace_back(std::make_unique<Ring>(capacity));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+  }
+  WorkStealingDeque(WorkStealingDeque const &) = delete;
+  WorkStealingDeque(WorkStealingDeque &&) = delete;
+
+  // -- owner only
+  void Push(T value) {
+    int64_t const b = bottom.load(std::memory_order_relaxed);
+    int64_t const t = top.load(std::memory_order_acquire);
+    Ring* r = ring.load(std::memory_order_relaxed);
+    if (b - t > r->capacity - 1) {
+      auto grown = std::make_unique<Ring>(r->capacity * 2);
+      for (int64_t i = t; i < b; ++ i)
+        { grown->Store(i, r->Load(i)); }
+      r = grown.get();
+      rings.emplace_back(std::move(grown));
+      ring.store(r, std::memory_order_release);
+    }
+    r->Store(b, value);
+    // publishes the slot to thieves, which read bottom with acquire
+    bottom.store(b + 1, std::memory_order_release);
+  }
+
+  bool Pop(T & value) {
+    int64_t const b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring* r = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    value = r->Load(b);
+    if (t < b) { return true; }
+
+    // the last one left, which a thief may be taking at the same time
+    bool const won =
+      top.compare_exchange_strong(
+        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed
+      );
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  // -- any thread; fails when empty or when another thread got there first
+  bool Steal(T & value) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t const b = bottom.load(std::memory_order_acquire);
+    if (t >= b) { return false; }
+
+    T const stolen = ring.load(std::memory_order_acquire)->Load(t);
+    if (
+      !top.compare_exchange_strong(
+        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed
+      )
+    ) {
+      return false;
+    }
+    value = stolen;
+    return true;
+  }
+};
+
+// the number of jobs submitted against it that have yet to finish; lets a
+// group of jobs be waited on as a whole. Must outlive the jobs it counts
+class JobCounter {
+private:
+  friend class JobSystem;
+  std::atomic<uint32_t> pending { 0 };
+
+public:
+  JobCounter() = default;
+  JobCounter(JobCounter const &) = delete;
+
+  bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// one worker thread per core besides the thread that constructs it, which
+// counts as the main thread & takes part whenever it waits. Every thread owns
+// a WorkStealingDeque: jobs submitted from it go to its own deque and idle
+// threads steal from the others, so there's no shared queue to contend on.
+// Jobs submitted from threads outside the system go through a locked queue.
+// Work that has to stay on the main thread, such as GLFW calls, goes through
+// SubmitMain & only runs when the main thread pumps or waits. Every job must
+// be waited on before the system is destroyed.
+class JobSystem {
+private:
+  struct Job {
+    JobFunction function;
+    JobCounter * counter = nullptr;
+  };
+
+  struct Worker {
+    WorkStealingDeque<Job*> deque;
+    std::thread thread; // not joinable for the main thread
+  };
+
+  // [0] is the main thread
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  // from threads outside the system
+  std::mutex injectedMutex;
+  std::deque<Job*> injected;
+  std::atomic<uint32_t> injectedCount { 0 };
+
+  std::mutex mainMutex;
+  std::deque<Job*> mainJobs;
+  std::atomic<uint32_t> mainJobCount { 0 };
+  std::function<void()> mainThreadWake;
+
+  // jobs that could be picked up by a worker, may briefly dip below zero as a
+  // job can be taken before it's counted
+  std::atomic<int64_t> queuedJobs { 0 };
+
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<uint32_t> sleeping { 0 };
+  bool quit = false;
+
+  void WorkerLoop(uint32_t threadIdx);
+  void Push(Job * job);
+  Job* FindJob(uint32_t threadIdx);
+  void Execute(Job * job);
+
+public:
+  explicit JobSystem(uint32_t workerCount = DefaultWorkerCount());
+  ~JobSystem();
+  JobSystem(JobSystem const &) = delete;
+  JobSystem(JobSystem &&) = delete;
+
+  // one worker per core besides the main thread
+  static uint32_t DefaultWorkerCount();
+
+  static constexpr uint32_t invalidThreadIndex = ~0u;
+
+  // the main thread included
+  uint32_t ThreadCount() const
+    { return static_cast<uint32_t>(workers.size()); }
+  // 0 on the main thread, 1.. on workers, invalidThreadIndex on threads
+  // outside the system
+  uint32_t ThreadIndex() const;
+  bool IsMainThread() const { return ThreadIndex() == 0; }
+
+  // counter, if any, is incremented now & decremented once function returns
+  void Submit(JobFunction function, JobCounter * counter = nullptr);
+  // runs function on the main thread, the next time it pumps or waits
+  void SubmitMain(JobFunction function, JobCounter * counter = nullptr);
+  // runs the main thread's jobs queued so far; main thread only
+  void PumpMainThread();
+  // called after every SubmitMain, so a main thread blocked outside the
+  // system (ei. in WaitEvents) returns to pump; only set or cleared while
+  // nothing can call SubmitMain
+  void SetMainThreadWake(std::function<void()> wake_)
+    { mainThreadWake = std::move(wake_); }
+
+  // runs other jobs until counter reaches 0, main thread jobs too when
+  // called from the main thread
+  void Wait(JobCounter & counter);
+
+  // calls function over [begin, end) split into contiguous chunks of at least
+  // grain indices, one of them on the calling thread, and waits for all
+  void ParallelFor(
+    uint32_t begin
+  , uint32_t end
+  , uint32_t grain
+  , std::function<void(uint32_t first, uint32_t last)> const & function
+  );
+};
+
+// frame work as a dependency graph, ei. culling & animation before command
+// recording, built once & run every frame. A node starts once all of its
+// dependencies have finished, on whichever thread the last of them finished
+// on; dependencies can only name nodes added earlier, so there are no cycles
+class JobGraph {
+public:
+  using NodeId = uint32_t;
+
+private:
+  struct Node {
+    JobFunction function;
+    std::vector<NodeId> successors;
+    uint32_t dependencyCount = 0;
+    std::atomic<uint32_t> remaining { 0 };
+  };
+
+  std::vector<std::unique_ptr<Node>> nodes;
+
+  void Launch(JobSystem & jobs, JobCounter & counter, NodeId id);
+
+public:
+  NodeId Add(
+    JobFunction function
+  , std::vector<NodeId> const & dependencies = {}
+  );
+
+  size_t Size() const { return nodes.size(); }
+
+  // runs every node once & returns when all have finished, the calling
+  // thread helps; not reentrant
+  void Run(JobSystem & jobs);
+};
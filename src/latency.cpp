@@ -0,0 +1,201 @@
+#include "latency.hpp"
+
+#include "swapchain.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////
+char const * ToString(PresentPolicy policy) {
+  switch (policy) {
+    case PresentPolicy::LowLatencyFifo: return "fifo";
+    case PresentPolicy::Mailbox:        return "mailbox";
+    case PresentPolicy::Paced:          return "paced";
+  }
+  return "?";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::optional<PresentPolicy> PresentPolicyFromString(std::string_view name) {
+  for (
+    auto const policy
+  : { PresentPolicy::LowLatencyFifo, PresentPolicy::Mailbox
+    , PresentPolicy::Paced
+    }
+  ) {
+    if (name == ToString(policy)) { return policy; }
+  }
+  return std::nullopt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ApplyPresentPolicy(Swapchain & swapchain, PresentPolicy policy) {
+  switch (policy) {
+    case PresentPolicy::LowLatencyFifo:
+      swapchain.preferredPresentModes = { vk::PresentModeKHR::eFifo };
+      swapchain.extraImages = 0;
+    break;
+    case PresentPolicy::Mailbox:
+      swapchain.preferredPresentModes = {
+        vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate
+      };
+      swapchain.extraImages = 1;
+    break;
+    case PresentPolicy::Paced:
+      // the pacer keeps the queue empty itself, the spare image only spares
+      // acquire from blocking on a late frame
+      swapchain.preferredPresentModes = { vk::PresentModeKHR::eFifo };
+      swapchain.extraImages = 1;
+    break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameLimiter::FrameLimiter(double ratePerSecond) {
+  this->SetRate(ratePerSecond);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FrameLimiter::SetRate(double ratePerSecond) {
+  this->interval =
+    ratePerSecond > 0.0
+    ? std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / ratePerSecond)
+      )
+    : Clock::duration {};
+  this->next = Clock::now();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FrameLimiter::Wait() {
+  if (!this->Enabled()) { return; }
+
+  auto const now = Clock::now();
+  if (now > this->next + this->interval) {
+    this->next = now;
+  } else {
+    this->WaitUntil(this->next);
+  }
+  this->next += this->interval;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FrameLimiter::WaitUntil(Clock::time_point deadline) {
+  using namespace std::chrono;
+
+  // sleep in 1ms steps while a step, even a long one, can't overshoot; each
+  // step refines the estimate of how long a step really takes
+  while (true) {
+    double const remainingUs =
+      duration<double, std::micro>(deadline - Clock::now()).count();
+    double const stepEstimateUs =
+      this->sleepMeanUs + std::sqrt(this->sleepVarianceUs);
+    if (remainingUs <= stepEstimateUs) { break; }
+
+    auto const before = Clock::now();
+    std::this_thread::sleep_for(milliseconds(1));
+    double const observedUs =
+      duration<double, std::micro>(Clock::now() - before).count();
+
+    constexpr double weight = 0.05;
+    double const delta = observedUs - this->sleepMeanUs;
+    this->sleepMeanUs += weight * delta;
+    this->sleepVarianceUs =
+      (1.0 - weight) * (this->sleepVarianceUs + weight * delta * delta);
+  }
+
+  // the remainder is below the sleep granularity
+  while (Clock::now() < deadline) {}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PresentPacer::PresentPacer(
+  Swapchain & swapchain_
+, PresentPolicy policy_
+, double refreshRate
+, double rateLimit
+)
+: swapchain{&swapchain_}, policy{policy_}
+{
+  if (refreshRate > 0.0) {
+    this->refreshInterval =
+      std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / refreshRate)
+      );
+  }
+
+  this->presentWait =
+    this->policy == PresentPolicy::Paced
+ && this->swapchain->SupportsPresentWait()
+ && this->refreshInterval.count() > 0;
+
+  if (rateLimit > 0.0) {
+    this->limiter.SetRate(rateLimit);
+  } else if (this->policy == PresentPolicy::Paced && !this->presentWait) {
+    this->limiter.SetRate(refreshRate);
+  }
+
+  spdlog::info(
+    "Present policy '{}', {}{}"
+  , ToString(this->policy)
+  , this->presentWait ? "paced off present wait" : "no present wait"
+  , this->limiter.Enabled()
+    ? fmt::format(
+        ", frames limited to {:.1f}Hz"
+      , 1.0 / std::chrono::duration<double>(this->limiter.Interval()).count()
+      )
+    : std::string()
+  );
+  if (this->policy == PresentPolicy::Paced && !this->presentWait
+   && !this->limiter.Enabled()
+  ) {
+    spdlog::warn("Paced presents without present wait or a refresh rate");
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PresentPacer::WaitForFrame() {
+  if (this->presentWait && this->swapchain->LastPresentId() > 0) {
+    // once the last present is on screen the next vblank is a refresh away,
+    // start late enough that the frame only just makes it
+    auto const timeoutNs =
+      static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          this->refreshInterval * 4
+        ).count()
+      );
+    if (
+      this->swapchain->WaitForPresent(
+        this->swapchain->LastPresentId(), timeoutNs
+      )
+    ) {
+      auto const work =
+        std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double, std::micro>(this->frameWorkUs)
+        );
+      this->limiter.WaitUntil(
+        Clock::now() + this->refreshInterval - work - presentSlack
+      );
+    }
+  }
+
+  this->limiter.Wait();
+  this->frameStart = Clock::now();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PresentPacer::FramePresented() {
+  double const workUs =
+    std::chrono::duration<double, std::micro>(
+      Clock::now() - this->frameStart
+    ).count();
+
+  // quick to grow so a heavy frame isn't late twice, slow to shrink
+  constexpr double riseWeight = 0.5, fallWeight = 0.05;
+  this->frameWorkUs +=
+    (workUs > this->frameWorkUs ? riseWeight : fallWeight)
+  * (workUs - this->frameWorkUs);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+class Swapchain; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+enum class PresentPolicy {
+  // FIFO with as few images as the surface allows, never tears & keeps the
+  // present queue short; pair with a single frame in flight
+  LowLatencyFifo,
+  // mailbox (or immediate) with a spare image, for throughput
+  Mailbox,
+  // FIFO where CPU work for a frame starts just in time for the next vblank,
+  // timed off VK_KHR_present_wait when present or the frame limiter if not
+  Paced,
+};
+
+char const * ToString(PresentPolicy policy);
+std::optional<PresentPolicy> PresentPolicyFromString(std::string_view name);
+
+// sets the present modes & image count of the next Swapchain::Construct
+void ApplyPresentPolicy(Swapchain & swapchain, PresentPolicy policy);
+
+// holds frames to a fixed rate by sleeping most of the way to the deadline
+// and spinning the rest; how far short of the deadline sleeping stops tracks
+// how much the OS has been oversleeping, so the spin stays short
+class FrameLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+private:
+  Clock::duration interval {};
+  Clock::time_point next {};
+
+  // smoothed duration (& its variance) of a 1ms sleep, in microseconds
+  double sleepMeanUs = 1200.0;
+  double sleepVarianceUs = 0.0;
+
+public:
+  explicit FrameLimiter(double ratePerSecond = 0.0);
+
+  // 0 disables the limiter
+  void SetRate(double ratePerSecond);
+  bool Enabled() const { return interval.count() > 0; }
+  Clock::duration Interval() const { return interval; }
+
+  // blocks until the next frame may start; a frame that is already more than
+  // an interval late resets the schedule rather than bursting to catch up
+  void Wait();
+
+  // the hybrid sleep & spin on its own
+  void WaitUntil(Clock::time_point deadline);
+};
+
+// decides when the CPU starts on the next frame under a PresentPolicy, call
+// WaitForFrame before polling input so that input is sampled as late as
+// possible, and FramePresented right after each Swapchain::QueuePresent
+class PresentPacer {
+private:
+  using Clock = FrameLimiter::Clock;
+
+  Swapchain* swapchain = nullptr;
+  PresentPolicy policy;
+  FrameLimiter limiter;
+  Clock::duration refreshInterval {};
+  bool presentWait = false;
+
+  Clock::time_point frameStart {};
+  // smoothed time from WaitForFrame returning to the present, microseconds
+  double frameWorkUs = 0.0;
+
+public:
+  // slack before the vblank the paced mode aims to present by
+  static constexpr auto presentSlack = std::chrono::microseconds(1000);
+
+  // refreshRate of 0 leaves Paced without a limiter if present wait is
+  // missing; rateLimit, if not 0, caps every policy
+  PresentPacer(
+    Swapchain & swapchain_
+  , PresentPolicy policy_
+  , double refreshRate
+  , double rateLimit = 0.0
+  );
+
+  PresentPolicy Policy() const { return policy; }
+
+  void WaitForFrame();
+  void FramePresented();
+};
@@ -0,0 +1,121 @@
+#include "memorytelemetry.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// a heap is back to Ok only this far below the warning share, so usage
+// hovering around it doesn't warn every other frame
+constexpr float recoveryMargin = 0.05f;
+
+////////////////////////////////////////////////////////////////////////////////
+vk::DeviceSize ToMiB(vk::DeviceSize bytes) { return bytes/(1024*1024); }
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+MemoryTelemetry::MemoryTelemetry(
+  GraphicsContext & context_
+, float warnShare_
+)
+: context{&context_}, warnShare{warnShare_}
+{
+  auto const & memoryProperties = this->context->deviceMemoryProperties;
+  this->heapCount = memoryProperties.memoryHeapCount;
+  for (uint32_t i = 0; i < this->heapCount; ++ i) {
+    this->heaps[i].deviceLocal =
+      static_cast<bool>(
+        memoryProperties.memoryHeaps[i].flags
+      & vk::MemoryHeapFlagBits::eDeviceLocal
+      );
+  }
+
+  if (!this->context->enableMemoryBudget) {
+    spdlog::info(
+      "VK_EXT_memory_budget unavailable, memory budgets are the heap sizes"
+    );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MemoryTelemetry::Poll() {
+  auto const budgets = QueryMemoryBudget(*this->context);
+  this->allocations = this->context->allocator->Stats();
+  ++ this->pollCount;
+
+  for (uint32_t i = 0; i < this->heapCount; ++ i) {
+    auto & heap = this->heaps[i];
+    heap.current = budgets[i];
+    heap.peakUsage = std::max(heap.peakUsage, heap.current.usage);
+
+    if (heap.current.budget == 0) { continue; }
+    double const share =
+      static_cast<double>(heap.current.usage) / heap.current.budget;
+
+    auto pressure = MemoryPressure::Ok;
+    if (share > 1.0) {
+      pressure = MemoryPressure::Over;
+    } else if (
+      share >= this->warnShare
+   || (
+        share >= this->warnShare - recoveryMargin
+     && heap.pressure != MemoryPressure::Ok
+      )
+    ) {
+      pressure = MemoryPressure::High;
+    }
+    if (pressure == heap.pressure) { continue; }
+    heap.pressure = pressure;
+
+    auto const & allocatorHeap = this->allocations.heaps[i];
+    switch (pressure) {
+      case MemoryPressure::Over:
+        spdlog::warn(
+          "Heap {} over budget: {} MiB used of {} MiB ({} MiB ours)"
+        , i, ToMiB(heap.current.usage), ToMiB(heap.current.budget)
+        , ToMiB(allocatorHeap.reservedBytes)
+        );
+      break;
+      case MemoryPressure::High:
+        spdlog::warn(
+          "Heap {} nearing its budget: {} MiB used of {} MiB ({} MiB ours)"
+        , i, ToMiB(heap.current.usage), ToMiB(heap.current.budget)
+        , ToMiB(allocatorHeap.reservedBytes)
+        );
+      break;
+      case MemoryPressure::Ok:
+        spdlog::info(
+          "Heap {} back within budget: {} MiB used of {} MiB"
+        , i, ToMiB(heap.current.usage), ToMiB(heap.current.budget)
+        );
+      break;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MemoryTelemetry::Log() const {
+  spdlog::info("Memory over {} polls:", this->pollCount);
+  for (uint32_t i = 0; i < this->heapCount; ++ i) {
+    auto const & heap = this->heaps[i];
+    auto const & allocatorHeap = this->allocations.heaps[i];
+    spdlog::info(
+      "\tHeap {}{} {} MiB used of {} MiB, peak {} MiB; ours {} MiB in {} MiB,"
+      " peak {} MiB in {} MiB"
+    , i, heap.deviceLocal ? " (device local)" : ""
+    , ToMiB(heap.current.usage), ToMiB(heap.current.budget)
+    , ToMiB(heap.peakUsage)
+    , ToMiB(allocatorHeap.allocatedBytes), ToMiB(allocatorHeap.reservedBytes)
+    , ToMiB(allocatorHeap.peakAllocatedBytes)
+    , ToMiB(allocatorHeap.peakReservedBytes)
+    );
+  }
+  for (size_t i = 0; i < memoryCategoryCount; ++ i) {
+    auto const & category = this->allocations.categories[i];
+    spdlog::info(
+      "\t{} {} allocations {} MiB, peak {} MiB"
+    , ToString(static_cast<MemoryCategory>(i)), category.allocationCount
+    , ToMiB(category.allocatedBytes), ToMiB(category.peakAllocatedBytes)
+    );
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "graphicscontext.hpp"
+#include "vulkan.hpp"
+
+#include <array>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+enum class MemoryPressure {
+  Ok,
+  High, // past the warning share of the budget
+  Over, // past the budget itself, the driver may start paging
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct HeapTelemetry {
+  HeapBudget current; // as of the last Poll
+  vk::DeviceSize peakUsage = 0;
+  bool deviceLocal = false;
+  MemoryPressure pressure = MemoryPressure::Ok;
+};
+
+// per-heap budget & usage polled each frame, through VK_EXT_memory_budget
+// when it's enabled (see QueryMemoryBudget), next to the allocator's own
+// accounting by category. Warns through spdlog as a heap's usage crosses
+// warnShare of its budget and again past the budget, and once it recovers,
+// rather than every frame. Not thread safe, owned by the render thread.
+class MemoryTelemetry {
+private:
+  GraphicsContext* context = nullptr;
+  float warnShare = 0.9f;
+
+  std::array<HeapTelemetry, VK_MAX_MEMORY_HEAPS> heaps {};
+  uint32_t heapCount = 0;
+  AllocatorStats allocations;
+  uint64_t pollCount = 0;
+
+public:
+  MemoryTelemetry(GraphicsContext & context_, float warnShare_ = 0.9f);
+
+  // once per frame; a driver query & a copy of the allocator's stats
+  void Poll();
+
+  HeapTelemetry const & Heap(uint32_t idx) const { return heaps[idx]; }
+  uint32_t HeapCount() const { return heapCount; }
+  // as of the last Poll
+  AllocatorStats const & Allocations() const { return allocations; }
+
+  // current usage & high-water marks of every heap & category
+  void Log() const;
+};
@@ -0,0 +1,84 @@
+#include "offscreen.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+Offscreen::Offscreen(
+  GraphicsContext & context_
+, uint32_t imageCount
+, vk::Format colorFormat_
+)
+: context{&context_}, colorFormat{colorFormat_}
+{
+  this->images.resize(imageCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Offscreen::Construct(const glm::uvec2& size)
+{
+  this->Cleanup();
+
+  imageExtent.width = size.x;
+  imageExtent.height = size.y;
+
+  vk::ImageCreateInfo imageCI;
+  imageCI.imageType = vk::ImageType::e2D;
+  imageCI.format = colorFormat;
+  imageCI.extent = vk::Extent3D { imageExtent.width, imageExtent.height, 1 };
+  imageCI.mipLevels = 1;
+  imageCI.arrayLayers = 1;
+  imageCI.samples = vk::SampleCountFlagBits::e1;
+  imageCI.tiling = vk::ImageTiling::eOptimal;
+  imageCI.usage =
+    vk::ImageUsageFlagBits::eColorAttachment
+  | vk::ImageUsageFlagBits::eTransferSrc
+  | vk::ImageUsageFlagBits::eTransferDst
+  | vk::ImageUsageFlagBits::eSampled
+  ;
+  imageCI.sharingMode = vk::SharingMode::eExclusive;
+  imageCI.initialLayout = vk::ImageLayout::eUndefined;
+
+  vk::ImageViewCreateInfo colorAttachmentView;
+  colorAttachmentView.format = colorFormat;
+  colorAttachmentView.viewType = vk::ImageViewType::e2D;
+  { // subresource range
+    auto & range = colorAttachmentView.subresourceRange;
+    range.aspectMask     = vk::ImageAspectFlagBits::eColor;
+    range.levelCount     = 1;
+    range.layerCount     = 1;
+    range.baseMipLevel   = 0;
+    range.baseArrayLayer = 0;
+  }
+
+  auto & device = this->context->device;
+  for (auto & image : this->images) {
+    AllocationCreateInfo allocationCI;
+    allocationCI.usage = MemoryUsage::GpuOnly;
+    image.image = this->context->allocator->CreateImage(imageCI, allocationCI);
+
+    colorAttachmentView.image = image.image.image;
+    image.view =
+      CheckReturn(
+        device->createImageView(colorAttachmentView),
+        "Offscreen image view creation"
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t Offscreen::AcquireNextImage() {
+  this->currentImage =
+    (this->currentImage + 1) % static_cast<uint32_t>(this->images.size());
+  return this->currentImage;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Offscreen::Cleanup() {
+  for (auto & image : images) {
+    context->device->destroyImageView(image.view);
+    context->allocator->DestroyImage(image.image);
+    image = OffscreenImage {};
+  }
+}
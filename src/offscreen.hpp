@@ -0,0 +1,51 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "vulkan.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+struct OffscreenImage {
+  OffscreenImage() = default;
+
+  Image         image;
+  vk::ImageView view;
+};
+
+// ring of device-local color images standing in for a Swapchain when running
+// headless; images are handed out round-robin and never presented, so the
+// ring must be at least as deep as the frames in flight using it
+class Offscreen {
+private:
+  GraphicsContext* context = nullptr;
+
+  std::vector<OffscreenImage> images {};
+
+public:
+  Offscreen(
+    GraphicsContext & context_
+  , uint32_t imageCount = 3
+  , vk::Format colorFormat = vk::Format::eR8G8B8A8Unorm
+  );
+  ~Offscreen() { Cleanup(); }
+  Offscreen(Offscreen const &) = delete;
+  Offscreen(Offscreen &&) = delete;
+
+  vk::Extent2D imageExtent;
+  vk::Format colorFormat;
+  uint32_t currentImage { 0 };
+
+  size_t ImageLength() { return images.size(); }
+  vk::Image const & ImageHandle(uint32_t idx) const
+    { return images[idx].image.image; }
+  vk::ImageView const & ImageView(uint32_t idx) const
+    { return images[idx].view; }
+
+  void Construct(const glm::uvec2& size);
+  uint32_t AcquireNextImage();
+  void Cleanup();
+};
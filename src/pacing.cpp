@@ -0,0 +1,275 @@
+#include "pacing.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////
+char const * ToString(FrameStage stage) {
+  switch (stage) {
+    case FrameStage::Pace:      return "pace";
+    case FrameStage::FenceWait: return "fence wait";
+    case FrameStage::Acquire:   return "acquire";
+    case FrameStage::Record:    return "record";
+    case FrameStage::Submit:    return "submit";
+    case FrameStage::Present:   return "present";
+    case FrameStage::Frame:     return "frame";
+    case FrameStage::Count:     break;
+  }
+  return "?";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RollingHistogram::RollingHistogram(size_t windowCapacity)
+: window(std::max<size_t>(windowCapacity, 1))
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t RollingHistogram::BucketOf(uint32_t us) {
+  constexpr uint32_t subBuckets = 1u << subBucketBits;
+  // exact below 2*subBuckets, then subBuckets buckets per power of two
+  if (us < 2*subBuckets) { return us; }
+  uint32_t const shift = std::bit_width(us) - 1 - subBucketBits;
+  return (shift + 1)*subBuckets + ((us >> shift) & (subBuckets - 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double RollingHistogram::BucketValueUs(uint32_t bucket) {
+  constexpr uint32_t subBuckets = 1u << subBucketBits;
+  if (bucket < 2*subBuckets) { return static_cast<double>(bucket); }
+  uint32_t const shift = bucket/subBuckets - 1;
+  uint32_t const sub = bucket % subBuckets;
+  double const lower = static_cast<double>(uint64_t{subBuckets + sub} << shift);
+  double const width = static_cast<double>(uint64_t{1} << shift);
+  return lower + (width - 1.0)*0.5; // middle of the bucket
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RollingHistogram::Add(uint32_t us) {
+  if (this->windowSize == this->window.size()) {
+    auto const oldest = this->window[this->windowHead];
+    -- this->buckets[BucketOf(oldest)];
+    this->sumUs -= oldest;
+    if (oldest == this->maxUs) { this->maxStale = true; }
+  } else {
+    ++ this->windowSize;
+  }
+
+  this->window[this->windowHead] = us;
+  this->windowHead = (this->windowHead + 1) % this->window.size();
+  ++ this->buckets[BucketOf(us)];
+  this->sumUs += us;
+  if (us >= this->maxUs) {
+    this->maxUs = us;
+    this->maxStale = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RollingHistogram::Clear() {
+  this->windowHead = 0;
+  this->windowSize = 0;
+  this->buckets.fill(0);
+  this->sumUs = 0;
+  this->maxUs = 0;
+  this->maxStale = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t RollingHistogram::MaxUs() const {
+  if (!this->maxStale) { return this->maxUs; }
+  // the first windowSize entries are the window, whether or not it's full
+  return
+    *std::max_element(
+      this->window.begin()
+    , this->window.begin() + static_cast<std::ptrdiff_t>(this->windowSize)
+    );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double RollingHistogram::Percentile(double fraction) const {
+  if (this->windowSize == 0) { return 0.0; }
+
+  auto const target =
+    std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(fraction * this->windowSize))
+    );
+
+  uint64_t cumulative = 0;
+  for (uint32_t bucket = 0; bucket < bucketCount; ++ bucket) {
+    cumulative += this->buckets[bucket];
+    if (cumulative >= target) { return BucketValueUs(bucket) / 1000.0; }
+  }
+  return BucketValueUs(bucketCount - 1) / 1000.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameStageStats RollingHistogram::Stats() const {
+  FrameStageStats stats;
+  stats.count = this->windowSize;
+  if (this->windowSize == 0) { return stats; }
+
+  stats.meanMs =
+    static_cast<double>(this->sumUs) / this->windowSize / 1000.0;
+  stats.p50Ms  = this->Percentile(0.5);
+  stats.p99Ms  = this->Percentile(0.99);
+  stats.p999Ms = this->Percentile(0.999);
+  stats.maxMs  = this->MaxUs() / 1000.0;
+  return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FramePacing::FramePacing()
+: lastSummary{std::chrono::steady_clock::now()}
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+FramePacing::~FramePacing() {
+  for (auto & ring : this->rings)
+    { delete ring.load(std::memory_order_acquire); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FramePacing::Ring* FramePacing::ThreadRing() {
+  // a thread only ever registers itself, so its own ring is always published;
+  // the rings live & die with this instance, threads keep no state of it
+  auto const self = std::this_thread::get_id();
+  auto const count =
+    std::min(this->ringCount.load(std::memory_order_acquire), maxThreads);
+  for (size_t i = 0; i < count; ++ i) {
+    auto * ring = this->rings[i].load(std::memory_order_acquire);
+    if (ring && ring->owner == self) { return ring; }
+  }
+
+  auto const idx = this->ringCount.fetch_add(1, std::memory_order_acq_rel);
+  if (idx >= maxThreads) {
+    // undone, so the count stays bounded & the error is logged once
+    this->ringCount.fetch_sub(1, std::memory_order_relaxed);
+    if (!this->overflowLogged.exchange(true, std::memory_order_relaxed)) {
+      spdlog::error(
+        "Frame pacing supports {} threads, ignoring more", maxThreads
+      );
+    }
+    return nullptr;
+  }
+
+  auto * ring = new Ring;
+  ring->owner = self;
+  this->rings[idx].store(ring, std::memory_order_release);
+  return ring;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FramePacing::Record(
+  FrameStage stage
+, std::chrono::steady_clock::time_point begin
+, std::chrono::steady_clock::time_point end
+) {
+  auto * ring = this->ThreadRing();
+  if (!ring) { return; }
+
+  auto const head = ring->head.load(std::memory_order_relaxed);
+  auto const tail = ring->tail.load(std::memory_order_acquire);
+  if (head - tail >= Ring::capacity) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto const us =
+    std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+  ring->samples[head % Ring::capacity] = Sample {
+    stage,
+    static_cast<uint32_t>(
+      std::clamp<int64_t>(us, 0, std::numeric_limits<uint32_t>::max())
+    )
+  };
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FramePacing::Collect() {
+  auto const count =
+    std::min(this->ringCount.load(std::memory_order_relaxed), maxThreads);
+
+  for (size_t i = 0; i < count; ++ i) {
+    // registered but not yet published rings are picked up next time
+    auto * ring = this->rings[i].load(std::memory_order_acquire);
+    if (!ring) { continue; }
+
+    auto const tail = ring->tail.load(std::memory_order_relaxed);
+    auto const head = ring->head.load(std::memory_order_acquire);
+    for (auto idx = tail; idx != head; ++ idx) {
+      auto const & sample = ring->samples[idx % Ring::capacity];
+      this->histograms[static_cast<size_t>(sample.stage)].Add(
+        sample.durationUs
+      );
+    }
+    ring->tail.store(head, std::memory_order_release);
+
+    this->dropped +=
+      ring->dropped.exchange(0, std::memory_order_relaxed);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FramePacing::EndFrame() {
+  auto const now = std::chrono::steady_clock::now();
+  if (!this->firstFrame)
+    { this->Record(FrameStage::Frame, this->lastFrameEnd, now); }
+  this->lastFrameEnd = now;
+  this->firstFrame = false;
+
+  this->Collect();
+
+  if (
+    this->summaryInterval.count() > 0
+ && now - this->lastSummary >= this->summaryInterval
+  ) {
+    this->LogSummary();
+    this->lastSummary = now;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FramePacing::Reset() {
+  this->Collect();
+  for (auto & histogram : this->histograms)
+    { histogram.Clear(); }
+  this->dropped = 0;
+  this->firstFrame = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FramePacing::SetSummaryInterval(
+  std::chrono::steady_clock::duration interval
+) {
+  this->summaryInterval = interval;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FrameStageStats FramePacing::Stats(FrameStage stage) const {
+  return this->histograms[static_cast<size_t>(stage)].Stats();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FramePacing::LogSummary() const {
+  for (uint32_t i = 0; i < static_cast<uint32_t>(FrameStage::Count); ++ i) {
+    auto const stage = static_cast<FrameStage>(i);
+    auto const stats = this->Stats(stage);
+    if (stats.count == 0) { continue; }
+    spdlog::info(
+      "{:>10}: mean {:7.3f} p50 {:7.3f} p99 {:7.3f} p99.9 {:7.3f} "
+      "max {:7.3f} ms ({} samples)"
+    , ToString(stage)
+    , stats.meanMs, stats.p50Ms, stats.p99Ms, stats.p999Ms, stats.maxMs
+    , stats.count
+    );
+  }
+  if (this->dropped > 0)
+    { spdlog::warn("{} frame pacing samples dropped", this->dropped); }
+}
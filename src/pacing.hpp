@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+enum class FrameStage : uint32_t {
+  Pace,      // PresentPacer/FrameLimiter, idling so the frame starts late
+  FenceWait, // BeginFrame, blocked on the frame in flight retiring
+  Acquire,   // Swapchain::AcquireNextImage
+  Record,
+  Submit,
+  Present,   // Swapchain::QueuePresent
+  Frame,     // EndFrame to EndFrame, the frame time
+  Count
+};
+
+char const * ToString(FrameStage stage);
+
+////////////////////////////////////////////////////////////////////////////////
+struct FrameStageStats {
+  uint64_t count = 0; // samples in the rolling window
+  double meanMs = 0.0;
+  double p50Ms = 0.0, p99Ms = 0.0, p999Ms = 0.0;
+  double maxMs = 0.0;
+};
+
+// rolling window of durations in log-linear buckets (~3% resolution), so
+// percentiles cost a walk over the buckets rather than a sort; the max is
+// exact, tracked beside the buckets
+class RollingHistogram {
+private:
+  static constexpr uint32_t subBucketBits = 5;
+  static constexpr uint32_t bucketCount =
+    (32 - subBucketBits + 1) << subBucketBits;
+
+  std::vector<uint32_t> window; // microseconds, oldest at windowHead once full
+  size_t windowHead = 0;
+  size_t windowSize = 0;
+  std::array<uint32_t, bucketCount> buckets {};
+  uint64_t sumUs = 0;
+  // stale once the max left the window, until a sample at least as large
+  uint32_t maxUs = 0;
+  bool maxStale = false;
+
+  uint32_t MaxUs() const;
+  static uint32_t BucketOf(uint32_t us);
+  static double BucketValueUs(uint32_t bucket);
+
+public:
+  RollingHistogram(size_t windowCapacity = 8192);
+
+  void Add(uint32_t us);
+  void Clear();
+  FrameStageStats Stats() const;
+  // 0 <= fraction <= 1, in milliseconds
+  double Percentile(double fraction) const;
+};
+
+// timestamps of each stage of the frame loop, recorded from any thread into
+// per-thread single-producer rings without locks, drained into rolling
+// histograms by Collect. Recording may happen on any thread; Collect, Stats,
+// EndFrame & LogSummary belong to the one thread driving the frame loop.
+class FramePacing {
+private:
+  struct Sample {
+    FrameStage stage;
+    uint32_t durationUs;
+  };
+
+  // single producer (the owning thread), single consumer (Collect)
+  struct Ring {
+    static constexpr size_t capacity = 4096;
+    std::array<Sample, capacity> samples;
+    std::atomic<uint64_t> head { 0 }; // written by the producer
+    std::atomic<uint64_t> tail { 0 }; // written by the consumer
+    std::atomic<uint64_t> dropped { 0 };
+    std::thread::id owner; // set before the ring is published
+  };
+
+  // rings are registered once per thread & never move; owned raw pointers
+  // since registration must not take a lock
+  static constexpr size_t maxThreads = 64;
+  std::array<std::atomic<Ring*>, maxThreads> rings {};
+  std::atomic<size_t> ringCount { 0 };
+  std::atomic<bool> overflowLogged { false };
+
+  std::array<RollingHistogram, static_cast<size_t>(FrameStage::Count)>
+    histograms;
+  uint64_t dropped = 0;
+
+  std::chrono::steady_clock::time_point lastFrameEnd;
+  bool firstFrame = true;
+
+  std::chrono::steady_clock::duration summaryInterval {};
+  std::chrono::steady_clock::time_point lastSummary;
+
+  Ring* ThreadRing();
+
+public:
+  FramePacing();
+  ~FramePacing();
+  FramePacing(FramePacing const &) = delete;
+  FramePacing(FramePacing &&) = delete;
+
+  // lock-free, any thread; samples are dropped (and counted) if the thread's
+  // ring is full because nothing has collected in a while
+  void Record(
+    FrameStage stage
+  , std::chrono::steady_clock::time_point begin
+  , std::chrono::steady_clock::time_point end
+  );
+
+  // drains every ring into the histograms
+  void Collect();
+
+  // records the Frame stage, collects, and logs a summary when due
+  void EndFrame();
+
+  // collects & then forgets everything so far, ei. to skip warm-up frames;
+  // the next EndFrame starts a new frame time
+  void Reset();
+
+  // 0 disables the periodic summary
+  void SetSummaryInterval(std::chrono::steady_clock::duration interval);
+
+  FrameStageStats Stats(FrameStage stage) const;
+  void LogSummary() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class ScopedFrameStage {
+private:
+  FramePacing & pacing;
+  FrameStage stage;
+  std::chrono::steady_clock::time_point begin;
+
+public:
+  ScopedFrameStage(FramePacing & pacing_, FrameStage stage_)
+  : pacing{pacing_}, stage{stage_}, begin{std::chrono::steady_clock::now()}
+  {}
+  ~ScopedFrameStage()
+    { pacing.Record(stage, begin, std::chrono::steady_clock::now()); }
+  ScopedFrameStage(ScopedFrameStage const &) = delete;
+};
+
+// runs fn as one stage of the frame loop, passing its result through
+template <typename Fn>
+decltype(auto) TimeStage(FramePacing & pacing, FrameStage stage, Fn && fn) {
+  ScopedFrameStage scope(pacing, stage);
+  return fn();
+}
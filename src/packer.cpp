@@ -0,0 +1,240 @@
+#include "packformat.hpp"
+#include "packwriter.hpp"
+
+#include <spdlog/spdlog.h>
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// builds an asset pack for AssetPack to map at runtime:
+//
+//   dtq_pack -o <out.pack> [--align N] [--srgb] [--no-mips] <name>=<path> ...
+//
+// binary PPMs become RGBA8 images with their mip chain box filtered down to
+// 1x1, anything else is stored as is
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+struct PackInput {
+  std::string name;
+  std::string path;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct PackOptions {
+  std::string outputPath;
+  uint64_t alignment = packDefaultAlignment;
+  bool srgb = false;
+  bool mips = true;
+  std::vector<PackInput> inputs;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+bool ParseOptions(int argc, char ** argv, PackOptions & options) {
+  for (int i = 1; i < argc; ++ i) {
+    std::string_view const arg = argv[i];
+    bool const hasValue = i+1 < argc;
+    if (arg == "-o" && hasValue) {
+      options.outputPath = argv[++i];
+    } else if (arg == "--align" && hasValue) {
+      options.alignment = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--srgb") {
+      options.srgb = true;
+    } else if (arg == "--no-mips") {
+      options.mips = false;
+    } else if (auto const split = arg.find('='); split != arg.npos) {
+      options.inputs.emplace_back(PackInput {
+        std::string(arg.substr(0, split)), std::string(arg.substr(split+1))
+      });
+    } else {
+      spdlog::error("Unknown argument '{}'", arg);
+      return false;
+    }
+  }
+
+  if (options.outputPath.empty() || options.inputs.empty()) {
+    spdlog::error(
+      "usage: dtq_pack -o <out.pack> [--align N] [--srgb] [--no-mips]"
+      " <name>=<path> ..."
+    );
+    return false;
+  }
+  if (
+      options.alignment < alignof(PackEntry)
+   || (options.alignment & (options.alignment - 1))
+  ) {
+    spdlog::error("--align must be a power of two of at least 8");
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ReadFile(std::string const & path, std::vector<uint8_t> & data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    spdlog::error("Could not open '{}'", path);
+    return false;
+  }
+  data.assign(
+    std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()
+  );
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the next header token of a binary PPM, skipping whitespace & comments
+std::string_view PpmToken(std::vector<uint8_t> const & ppm, size_t & at) {
+  auto const isSpace = [](uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  };
+  while (at < ppm.size()) {
+    if (ppm[at] == '#') {
+      while (at < ppm.size() && ppm[at] != '\n') { ++ at; }
+    } else if (isSpace(ppm[at])) {
+      ++ at;
+    } else {
+      break;
+    }
+  }
+  size_t const begin = at;
+  while (at < ppm.size() && !isSpace(ppm[at]) && ppm[at] != '#') { ++ at; }
+  return {
+    reinterpret_cast<char const *>(ppm.data()) + begin, at - begin
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RGB8 P6 into tightly packed RGBA8 with an opaque alpha
+bool DecodePpm(
+  std::vector<uint8_t> const & ppm
+, std::vector<uint8_t> & rgba
+, uint32_t & width
+, uint32_t & height
+) {
+  size_t at = 0;
+  if (PpmToken(ppm, at) != "P6") { return false; }
+  auto const number = [&]() {
+    return std::strtoul(std::string(PpmToken(ppm, at)).c_str(), nullptr, 10);
+  };
+  width = static_cast<uint32_t>(number());
+  height = static_cast<uint32_t>(number());
+  auto const maxValue = number();
+  // the single whitespace before the raster
+  if (at >= ppm.size()) { return false; }
+  ++ at;
+
+  size_t const texels = size_t(width) * height;
+  if (width == 0 || height == 0 || maxValue != 255) { return false; }
+  if (texels*3 > ppm.size() - at) { return false; }
+
+  rgba.resize(texels * 4);
+  for (size_t i = 0; i < texels; ++ i) {
+    std::memcpy(rgba.data() + i*4, ppm.data() + at + i*3, 3);
+    rgba[i*4 + 3] = 255;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// appends every level below the one at the end of levels, 2x2 box filtered;
+// odd edges clamp, so a 5 wide level averages 4:5 into its last texel
+void BuildMips(
+  std::vector<uint8_t> & levels
+, uint32_t width
+, uint32_t height
+, uint32_t & mipLevels
+) {
+  size_t srcOffset = 0;
+  mipLevels = 1;
+  while (width > 1 || height > 1) {
+    uint32_t const dstWidth = std::max(width / 2, 1u);
+    uint32_t const dstHeight = std::max(height / 2, 1u);
+    size_t const dstOffset = levels.size();
+    levels.resize(dstOffset + size_t(dstWidth) * dstHeight * 4);
+
+    auto const * src = levels.data() + srcOffset;
+    auto * dst = levels.data() + dstOffset;
+    for (uint32_t y = 0; y < dstHeight; ++ y)
+    for (uint32_t x = 0; x < dstWidth; ++ x) {
+      uint32_t const x0 = std::min(x*2, width-1);
+      uint32_t const x1 = std::min(x*2 + 1, width-1);
+      uint32_t const y0 = std::min(y*2, height-1);
+      uint32_t const y1 = std::min(y*2 + 1, height-1);
+      for (uint32_t c = 0; c < 4; ++ c) {
+        uint32_t const sum =
+          src[(size_t(y0)*width + x0)*4 + c]
+        + src[(size_t(y0)*width + x1)*4 + c]
+        + src[(size_t(y1)*width + x0)*4 + c]
+        + src[(size_t(y1)*width + x1)*4 + c];
+        dst[(size_t(y)*dstWidth + x)*4 + c] = static_cast<uint8_t>((sum+2)/4);
+      }
+    }
+
+    srcOffset = dstOffset;
+    width = dstWidth;
+    height = dstHeight;
+    ++ mipLevels;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoadAsset(
+  PackInput const & input
+, PackOptions const & options
+, PackedAsset & asset
+) {
+  std::vector<uint8_t> file;
+  if (!ReadFile(input.path, file)) { return false; }
+
+  asset.name = input.name;
+
+  bool const isPpm =
+    input.path.size() >= 4
+ && input.path.compare(input.path.size()-4, 4, ".ppm") == 0;
+  if (!isPpm) {
+    asset.entry.kind = PackEntryKind::Blob;
+    asset.data = std::move(file);
+    return true;
+  }
+
+  auto & entry = asset.entry;
+  entry.kind = PackEntryKind::Image;
+  entry.format =
+    options.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  entry.texelSize = 4;
+  if (!DecodePpm(file, asset.data, entry.width, entry.height)) {
+    spdlog::error("'{}' isn't an 8-bit binary PPM", input.path);
+    return false;
+  }
+  entry.mipLevels = 1;
+  if (options.mips)
+    { BuildMips(asset.data, entry.width, entry.height, entry.mipLevels); }
+  return true;
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char ** argv) {
+  PackOptions options;
+  if (!ParseOptions(argc, argv, options)) { return 1; }
+
+  std::vector<PackedAsset> assets(options.inputs.size());
+  for (size_t i = 0; i < options.inputs.size(); ++ i) {
+    if (!LoadAsset(options.inputs[i], options, assets[i])) { return 1; }
+  }
+
+  bool const written =
+    WritePack(options.outputPath, std::move(assets), options.alignment);
+  return written ? 0 : 1;
+}
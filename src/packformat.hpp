@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+// the on-disk layout of a dtq asset pack, shared by the dtq_pack tool & the
+// runtime reader. Little-endian, every offset is from the start of the file:
+//
+//   PackHeader | PackEntry[entryCount] sorted by nameHash | name table
+//   | entry data, each starting on a multiple of dataAlignment
+//
+// so the reader can map the file & hand out pointers into it as is, and an
+// entry's data can be copied straight out of the mapping
+
+constexpr char packMagic[8] = { 'D', 'T', 'Q', 'P', 'A', 'C', 'K', '\0' };
+// bumped whenever the layout changes, packs of another version are rejected
+constexpr uint32_t packVersion = 1;
+// a page, so entries can be prefetched & dropped from the mapping on their own
+constexpr uint64_t packDefaultAlignment = 4096;
+
+////////////////////////////////////////////////////////////////////////////////
+enum class PackEntryKind : uint32_t {
+  Blob  = 0, // raw bytes, ei. vertex & index data
+  Image = 1, // texels of a 2D image with its mip chain
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct PackHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t entryCount;
+  uint64_t indexOffset;
+  uint64_t namesOffset;
+  uint64_t namesSize;
+  uint64_t dataAlignment;
+  uint64_t fileSize; // catches truncated packs
+  uint64_t reserved;
+};
+static_assert(sizeof(PackHeader) == 64);
+
+////////////////////////////////////////////////////////////////////////////////
+struct PackEntry {
+  uint64_t nameHash; // PackHash of the name
+  uint64_t nameOffset; // into the name table, not null terminated
+  uint64_t dataOffset;
+  uint64_t dataSize;
+  uint32_t nameLength;
+  PackEntryKind kind;
+
+  // -- images only; levels are stored largest first & tightly packed
+  uint32_t format; // a VkFormat
+  uint32_t texelSize; // bytes
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  uint32_t reserved;
+};
+static_assert(sizeof(PackEntry) == 64);
+
+////////////////////////////////////////////////////////////////////////////////
+// 64-bit FNV-1a
+constexpr uint64_t PackHash(std::string_view name) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char const c : name) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+constexpr uint32_t PackMipExtent(uint32_t extent, uint32_t level) {
+  return std::max(extent >> level, 1u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+constexpr uint64_t PackMipSize(PackEntry const & entry, uint32_t level) {
+  return
+    uint64_t(PackMipExtent(entry.width, level))
+  * PackMipExtent(entry.height, level)
+  * entry.texelSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// relative to the entry's dataOffset
+constexpr uint64_t PackMipOffset(PackEntry const & entry, uint32_t level) {
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < level; ++ i)
+    { offset += PackMipSize(entry, i); }
+  return offset;
+}
@@ -0,0 +1,114 @@
+#include "packwriter.hpp"
+
+#include "util.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+void WritePadding(std::ofstream & out, uint64_t from, uint64_t to) {
+  static char const zeros[256] = {};
+  while (from < to) {
+    auto const count = std::min<uint64_t>(to - from, sizeof(zeros));
+    out.write(zeros, static_cast<std::streamsize>(count));
+    from += count;
+  }
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+bool WritePack(
+  std::string const & path
+, std::vector<PackedAsset> assets
+, uint64_t alignment
+) {
+  for (auto & asset : assets) {
+    asset.entry.nameHash = PackHash(asset.name);
+    asset.entry.nameLength = static_cast<uint32_t>(asset.name.size());
+  }
+
+  // the reader binary searches the index by hash, names break ties
+  std::sort(
+    assets.begin(), assets.end()
+  , [](PackedAsset const & a, PackedAsset const & b) {
+      return
+        a.entry.nameHash != b.entry.nameHash
+      ? a.entry.nameHash < b.entry.nameHash
+      : a.name < b.name;
+    }
+  );
+  for (size_t i = 1; i < assets.size(); ++ i) {
+    if (assets[i-1].name == assets[i].name) {
+      spdlog::error("Asset '{}' is listed twice", assets[i].name);
+      return false;
+    }
+  }
+
+  // -- lay out header, index, names, then the aligned data
+  PackHeader header {};
+  std::memcpy(header.magic, packMagic, sizeof(packMagic));
+  header.version = packVersion;
+  header.entryCount = static_cast<uint32_t>(assets.size());
+  header.indexOffset = sizeof(PackHeader);
+  header.namesOffset =
+    header.indexOffset + assets.size() * sizeof(PackEntry);
+  header.dataAlignment = alignment;
+
+  for (auto & asset : assets) {
+    asset.entry.nameOffset = header.namesSize;
+    header.namesSize += asset.name.size();
+  }
+
+  uint64_t end = header.namesOffset + header.namesSize;
+  for (auto & asset : assets) {
+    asset.entry.dataOffset = AlignUp(end, alignment);
+    asset.entry.dataSize = asset.data.size();
+    end = asset.entry.dataOffset + asset.entry.dataSize;
+  }
+  header.fileSize = end;
+
+  // -- write it out in that order
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    spdlog::error("Could not open '{}' for writing", path);
+    return false;
+  }
+
+  out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  for (auto const & asset : assets) {
+    out.write(
+      reinterpret_cast<char const *>(&asset.entry), sizeof(asset.entry)
+    );
+  }
+  for (auto const & asset : assets)
+    { out.write(asset.name.data(), std::streamsize(asset.name.size())); }
+
+  uint64_t at = header.namesOffset + header.namesSize;
+  for (auto const & asset : assets) {
+    WritePadding(out, at, asset.entry.dataOffset);
+    out.write(
+      reinterpret_cast<char const *>(asset.data.data())
+    , std::streamsize(asset.data.size())
+    );
+    at = asset.entry.dataOffset + asset.entry.dataSize;
+  }
+
+  // buffered writes only fail once flushed, ei. a full disk
+  out.close();
+  if (!out) {
+    spdlog::error("Could not write '{}'", path);
+    return false;
+  }
+
+  spdlog::info(
+    "Packed {} assets into '{}', {} bytes"
+  , assets.size(), path, header.fileSize
+  );
+  return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "packformat.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// an asset on its way into a pack; the kind & image fields of entry are the
+// caller's, the name & data fields are filled in by WritePack
+struct PackedAsset {
+  std::string name;
+  PackEntry entry {};
+  std::vector<uint8_t> data;
+};
+
+// lays assets out in the pack format & writes them to path, sorted the way
+// AssetPack searches them; false, logged, on a duplicate name or a failed
+// write. Shared by dtq_pack & anything generating packs, ei. dtq_bench
+bool WritePack(
+  std::string const & path
+, std::vector<PackedAsset> assets
+, uint64_t alignment = packDefaultAlignment
+);
@@ -0,0 +1,482 @@
+#include "pipeline.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// FNV-1a, only used to key pipelines within a process & its cache file
+struct Hasher {
+  uint64_t value = 14695981039346656037ull;
+
+  void AddBytes(void const * data, size_t size) {
+    auto const * bytes = static_cast<uint8_t const *>(data);
+    for (size_t i = 0; i < size; ++ i) {
+      value ^= bytes[i];
+      value *= 1099511628211ull;
+    }
+  }
+
+  template <typename T> void Add(T const & v) { AddBytes(&v, sizeof(T)); }
+
+  template <typename T> void AddVector(std::vector<T> const & v) {
+    Add(v.size());
+    AddBytes(v.data(), v.size() * sizeof(T));
+  }
+
+  void Add(ShaderStageDesc const & stage) {
+    Add(stage.stage);
+    AddVector(stage.spirv);
+    Add(stage.entryPoint.size());
+    AddBytes(stage.entryPoint.data(), stage.entryPoint.size());
+    AddVector(stage.specialization);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct ShaderStages {
+  std::vector<vk::UniqueShaderModule> modules;
+  std::vector<vk::PipelineShaderStageCreateInfo> infos;
+  // reserved up front, infos point into these
+  std::vector<std::vector<vk::SpecializationMapEntry>> specializationEntries;
+  std::vector<vk::SpecializationInfo> specializations;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+ShaderStages CreateShaderStages(
+  GraphicsContext const & context
+, std::vector<ShaderStageDesc> const & stages
+) {
+  ShaderStages self;
+  self.specializationEntries.reserve(stages.size());
+  self.specializations.reserve(stages.size());
+  for (auto const & stage : stages) {
+    vk::ShaderModuleCreateInfo moduleCI;
+    moduleCI.codeSize = stage.spirv.size() * sizeof(uint32_t);
+    moduleCI.pCode = stage.spirv.data();
+    self.modules.emplace_back(
+      CheckReturn(
+        context.device->createShaderModuleUnique(moduleCI),
+        "Creating shader module"
+      )
+    );
+
+    vk::PipelineShaderStageCreateInfo stageCI;
+    stageCI.stage = stage.stage;
+    stageCI.module = *self.modules.back();
+    stageCI.pName = stage.entryPoint.c_str();
+
+    if (!stage.specialization.empty()) {
+      auto & entries = self.specializationEntries.emplace_back();
+      for (size_t i = 0; i < stage.specialization.size(); ++ i) {
+        entries.emplace_back(
+          stage.specialization[i].id
+        , static_cast<uint32_t>(
+            i*sizeof(SpecializationConstant)
+          + offsetof(SpecializationConstant, value)
+          )
+        , sizeof(uint32_t)
+        );
+      }
+
+      // the constant values are read straight out of the desc
+      auto & specialization = self.specializations.emplace_back();
+      specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+      specialization.pMapEntries = entries.data();
+      specialization.dataSize =
+        stage.specialization.size() * sizeof(SpecializationConstant);
+      specialization.pData = stage.specialization.data();
+      stageCI.pSpecializationInfo = &specialization;
+    }
+
+    self.infos.emplace_back(stageCI);
+  }
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::Pipeline CreatePipeline(
+  GraphicsContext const & context
+, vk::PipelineCache const & cache
+, GraphicsPipelineDesc const & desc
+) {
+  auto const stages = CreateShaderStages(context, desc.stages);
+
+  vk::PipelineVertexInputStateCreateInfo vertexInput;
+  vertexInput.vertexBindingDescriptionCount =
+    static_cast<uint32_t>(desc.vertexBindings.size());
+  vertexInput.pVertexBindingDescriptions = desc.vertexBindings.data();
+  vertexInput.vertexAttributeDescriptionCount =
+    static_cast<uint32_t>(desc.vertexAttributes.size());
+  vertexInput.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+  vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+  inputAssembly.topology = desc.topology;
+
+  // counts only, both are dynamic
+  vk::PipelineViewportStateCreateInfo viewport;
+  viewport.viewportCount = 1;
+  viewport.scissorCount = 1;
+
+  vk::PipelineRasterizationStateCreateInfo rasterization;
+  rasterization.polygonMode = vk::PolygonMode::eFill;
+  rasterization.cullMode = desc.cullMode;
+  rasterization.frontFace = desc.frontFace;
+  rasterization.lineWidth = 1.0f;
+
+  vk::PipelineMultisampleStateCreateInfo multisample;
+  multisample.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+  vk::PipelineDepthStencilStateCreateInfo depthStencil;
+  depthStencil.depthTestEnable = desc.depthTest;
+  depthStencil.depthWriteEnable = desc.depthWrite;
+  depthStencil.depthCompareOp = desc.depthCompare;
+
+  vk::PipelineColorBlendAttachmentState blendAttachment;
+  blendAttachment.colorWriteMask =
+    vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
+  | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+  if (desc.alphaBlend) {
+    blendAttachment.blendEnable = VK_TRUE;
+    blendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+    blendAttachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+    blendAttachment.colorBlendOp = vk::BlendOp::eAdd;
+    blendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+    blendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+    blendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
+  }
+  std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(
+    desc.colorAttachmentCount, blendAttachment
+  );
+
+  vk::PipelineColorBlendStateCreateInfo colorBlend;
+  colorBlend.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+  colorBlend.pAttachments = blendAttachments.data();
+
+  std::array<vk::DynamicState, 2> const dynamicStates {
+    vk::DynamicState::eViewport, vk::DynamicState::eScissor
+  };
+  vk::PipelineDynamicStateCreateInfo dynamic;
+  dynamic.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamic.pDynamicStates = dynamicStates.data();
+
+  vk::GraphicsPipelineCreateInfo pipelineCI;
+  pipelineCI.stageCount = static_cast<uint32_t>(stages.infos.size());
+  pipelineCI.pStages = stages.infos.data();
+  pipelineCI.pVertexInputState = &vertexInput;
+  pipelineCI.pInputAssemblyState = &inputAssembly;
+  pipelineCI.pViewportState = &viewport;
+  pipelineCI.pRasterizationState = &rasterization;
+  pipelineCI.pMultisampleState = &multisample;
+  pipelineCI.pDepthStencilState = &depthStencil;
+  pipelineCI.pColorBlendState = &colorBlend;
+  pipelineCI.pDynamicState = &dynamic;
+  pipelineCI.layout = desc.layout;
+  pipelineCI.renderPass = desc.renderPass;
+  pipelineCI.subpass = desc.subpass;
+
+  auto result = context.device->createGraphicsPipeline(cache, pipelineCI);
+  if (result.result != vk::Result::eSuccess) {
+    spdlog::error(
+      "Creating graphics pipeline: {}", vk::to_string(result.result)
+    );
+    return nullptr;
+  }
+  return result.value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::Pipeline CreatePipeline(
+  GraphicsContext const & context
+, vk::PipelineCache const & cache
+, ComputePipelineDesc const & desc
+) {
+  std::vector<ShaderStageDesc> const stageDescs { desc.stage };
+  auto const stages = CreateShaderStages(context, stageDescs);
+
+  vk::ComputePipelineCreateInfo pipelineCI;
+  pipelineCI.stage = stages.infos[0];
+  pipelineCI.layout = desc.layout;
+
+  auto result = context.device->createComputePipeline(cache, pipelineCI);
+  if (result.result != vk::Result::eSuccess) {
+    spdlog::error(
+      "Creating compute pipeline: {}", vk::to_string(result.result)
+    );
+    return nullptr;
+  }
+  return result.value;
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t HashPipelineDesc(GraphicsPipelineDesc const & desc) {
+  Hasher hasher;
+  hasher.Add(desc.stages.size());
+  for (auto const & stage : desc.stages)
+    { hasher.Add(stage); }
+  // handles hash by value; a pipeline stays valid for any compatible render
+  // pass, but recreating the layout or pass yields a new key
+  hasher.Add(static_cast<VkPipelineLayout>(desc.layout));
+  hasher.Add(static_cast<VkRenderPass>(desc.renderPass));
+  hasher.Add(desc.subpass);
+  hasher.AddVector(desc.vertexBindings);
+  hasher.AddVector(desc.vertexAttributes);
+  hasher.Add(desc.topology);
+  hasher.Add(static_cast<VkCullModeFlags>(desc.cullMode));
+  hasher.Add(desc.frontFace);
+  hasher.Add(desc.depthTest);
+  hasher.Add(desc.depthWrite);
+  hasher.Add(desc.depthCompare);
+  hasher.Add(desc.alphaBlend);
+  hasher.Add(desc.colorAttachmentCount);
+  return hasher.value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t HashPipelineDesc(ComputePipelineDesc const & desc) {
+  Hasher hasher;
+  hasher.Add(desc.stage);
+  hasher.Add(static_cast<VkPipelineLayout>(desc.layout));
+  return hasher.value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PipelineManager::PipelineManager(
+  GraphicsContext & context_
+, std::string cachePath_
+, uint32_t workerCount
+)
+: context{&context_}
+, cachePath{std::move(cachePath_)}
+{
+  auto const initialData = this->LoadCacheData();
+
+  vk::PipelineCacheCreateInfo cacheCI;
+  cacheCI.initialDataSize = initialData.size();
+  cacheCI.pInitialData = initialData.data();
+  this->cache =
+    CheckReturn(
+      this->context->device->createPipelineCacheUnique(cacheCI),
+      "Creating pipeline cache"
+    );
+
+  if (workerCount == 0) {
+    workerCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  this->workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; ++ i)
+    { this->workers.emplace_back([this]() { this->WorkerLoop(); }); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PipelineManager::~PipelineManager() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->quit = true;
+  }
+  // workers drain the queue before quitting
+  this->queueReady.notify_all();
+  for (auto & worker : this->workers)
+    { worker.join(); }
+
+  this->Save();
+
+  for (auto & [key, entry] : this->pipelines) {
+    auto const pipeline = entry.pipeline.get();
+    if (pipeline) { this->context->device->destroyPipeline(pipeline); }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t> PipelineManager::LoadCacheData() const {
+  std::ifstream file(this->cachePath, std::ios::binary | std::ios::ate);
+  if (!file) {
+    spdlog::info("No pipeline cache at '{}', starting cold", this->cachePath);
+    return {};
+  }
+
+  std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(data.data()), data.size());
+  if (!file) {
+    spdlog::error("Reading pipeline cache '{}'", this->cachePath);
+    return {};
+  }
+
+  // VkPipelineCacheHeaderVersionOne, drivers are meant to reject foreign
+  // data themselves but not all of them do so gracefully
+  struct Header {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t  uuid[VK_UUID_SIZE];
+  } header;
+
+  if (data.size() < sizeof(Header)) {
+    spdlog::warn("Discarding pipeline cache '{}': truncated", this->cachePath);
+    return {};
+  }
+  std::memcpy(&header, data.data(), sizeof(Header));
+
+  auto const & properties = this->context->deviceProperties;
+  bool const valid =
+    header.headerSize >= sizeof(Header)
+ && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+ && header.vendorID == properties.vendorID
+ && header.deviceID == properties.deviceID
+ && std::memcmp(
+      header.uuid, properties.pipelineCacheUUID.data(), VK_UUID_SIZE
+    ) == 0;
+
+  if (!valid) {
+    spdlog::warn(
+      "Discarding pipeline cache '{}': built for another device or driver"
+    , this->cachePath
+    );
+    return {};
+  }
+
+  spdlog::info(
+    "Loaded pipeline cache '{}' ({} bytes)", this->cachePath, data.size()
+  );
+  return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PipelineManager::Save() const {
+  auto const data =
+    CheckReturn(
+      this->context->device->getPipelineCacheData(*this->cache),
+      "Reading pipeline cache data"
+    );
+  if (data.empty()) { return; }
+
+  // written aside then renamed, so a crash never leaves a torn cache behind
+  auto const tmpPath = this->cachePath + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const *>(data.data()), data.size());
+    if (!file) {
+      spdlog::error("Writing pipeline cache '{}'", tmpPath);
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tmpPath, this->cachePath, error);
+  if (error) {
+    spdlog::error(
+      "Saving pipeline cache '{}': {}", this->cachePath, error.message()
+    );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PipelineManager::WorkerLoop() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->queueReady.wait(lock, [this]() {
+        return this->quit || !this->queue.empty();
+      });
+      if (this->queue.empty()) { return; } // quitting
+      task = std::move(this->queue.front());
+      this->queue.pop_front();
+    }
+    task();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PipelineKey PipelineManager::Enqueue(
+  PipelineKey key
+, std::function<vk::Pipeline()> build
+) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->pipelines.contains(key)) { return key; }
+
+    auto promise = std::make_shared<std::promise<vk::Pipeline>>();
+    this->pipelines[key].pipeline = promise->get_future().share();
+    this->queue.emplace_back(
+      [promise, build = std::move(build)]() {
+        promise->set_value(build());
+      }
+    );
+  }
+  this->queueReady.notify_one();
+  return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PipelineKey PipelineManager::Request(GraphicsPipelineDesc desc) {
+  auto const key = HashPipelineDesc(desc);
+  return
+    this->Enqueue(key, [this, desc = std::move(desc)]() {
+      return CreatePipeline(*this->context, *this->cache, desc);
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+PipelineKey PipelineManager::Request(ComputePipelineDesc desc) {
+  auto const key = HashPipelineDesc(desc);
+  return
+    this->Enqueue(key, [this, desc = std::move(desc)]() {
+      return CreatePipeline(*this->context, *this->cache, desc);
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool PipelineManager::IsReady(PipelineKey key) {
+  std::shared_future<vk::Pipeline> pipeline;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto const entry = this->pipelines.find(key);
+    if (entry == this->pipelines.end()) { return false; }
+    pipeline = entry->second.pipeline;
+  }
+  return
+    pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::Pipeline PipelineManager::Get(PipelineKey key) {
+  std::shared_future<vk::Pipeline> pipeline;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto const entry = this->pipelines.find(key);
+    if (entry == this->pipelines.end()) {
+      spdlog::error("Unknown pipeline key {:016x}", key);
+      return nullptr;
+    }
+    pipeline = entry->second.pipeline;
+  }
+  return pipeline.get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PipelineManager::WaitAll() {
+  std::vector<std::shared_future<vk::Pipeline>> pending;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto const & [key, entry] : this->pipelines)
+      { pending.emplace_back(entry.pipeline); }
+  }
+  for (auto const & pipeline : pending)
+    { pipeline.wait(); }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+struct SpecializationConstant {
+  uint32_t id;
+  uint32_t value; // 32-bit constants only, bools & floats as their bits
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct ShaderStageDesc {
+  vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eVertex;
+  std::vector<uint32_t> spirv;
+  std::string entryPoint = "main";
+  std::vector<SpecializationConstant> specialization;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// the fixed-function state the demos vary; viewport & scissor are always
+// dynamic so pipelines survive swapchain resizes
+struct GraphicsPipelineDesc {
+  std::vector<ShaderStageDesc> stages;
+  vk::PipelineLayout layout;
+  vk::RenderPass renderPass;
+  uint32_t subpass = 0;
+
+  std::vector<vk::VertexInputBindingDescription> vertexBindings;
+  std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+  vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+  vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
+  vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+  bool depthTest = false;
+  bool depthWrite = false;
+  vk::CompareOp depthCompare = vk::CompareOp::eLessOrEqual;
+  bool alphaBlend = false;
+  uint32_t colorAttachmentCount = 1;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct ComputePipelineDesc {
+  ShaderStageDesc stage { vk::ShaderStageFlagBits::eCompute };
+  vk::PipelineLayout layout;
+};
+
+uint64_t HashPipelineDesc(GraphicsPipelineDesc const & desc);
+uint64_t HashPipelineDesc(ComputePipelineDesc const & desc);
+
+using PipelineKey = uint64_t;
+
+// owns every pipeline & a vk::PipelineCache persisted to cachePath. Requests
+// are keyed by a hash of their description, so asking twice for the same
+// pipeline returns the first request; creation runs on worker threads and
+// warm starts hit the driver's cache instead of compiling. The cache file is
+// only trusted if its header matches this device's vendor, device and
+// pipeline cache UUID. Thread safe.
+class PipelineManager {
+private:
+  struct Entry {
+    std::shared_future<vk::Pipeline> pipeline;
+  };
+
+  GraphicsContext* context = nullptr;
+  std::string cachePath;
+  vk::UniquePipelineCache cache;
+
+  std::mutex mutex;
+  std::unordered_map<PipelineKey, Entry> pipelines;
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> queue;
+  std::condition_variable queueReady;
+  bool quit = false;
+
+  std::vector<uint8_t> LoadCacheData() const;
+  void WorkerLoop();
+  PipelineKey Enqueue(
+    PipelineKey key
+  , std::function<vk::Pipeline()> build
+  );
+
+public:
+  PipelineManager(
+    GraphicsContext & context_
+  , std::string cachePath = "dtq-pipeline-cache.bin"
+  , uint32_t workerCount = 0 // 0 picks one per core
+  );
+  // waits for outstanding builds, saves the cache & destroys every pipeline;
+  // the caller must ensure none is in use
+  ~PipelineManager();
+  PipelineManager(PipelineManager const &) = delete;
+  PipelineManager(PipelineManager &&) = delete;
+
+  vk::PipelineCache const & Cache() const { return *cache; }
+
+  // queue creation on a worker, a no-op if the key was already requested
+  PipelineKey Request(GraphicsPipelineDesc desc);
+  PipelineKey Request(ComputePipelineDesc desc);
+
+  bool IsReady(PipelineKey key);
+  // blocks until built; null if the key is unknown or creation failed
+  vk::Pipeline Get(PipelineKey key);
+  void WaitAll();
+
+  // writes the cache out, also done on destruction
+  void Save() const;
+};
@@ -0,0 +1,402 @@
+#include "profiler.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+constexpr vk::QueryPipelineStatisticFlags statisticFlags =
+  vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices
+| vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives
+| vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations
+| vk::QueryPipelineStatisticFlagBits::eClippingPrimitives
+| vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations
+| vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+
+// results come back in flag bit order, which matches GpuPipelineStatistics
+constexpr uint32_t statisticCount = 6;
+static_assert(sizeof(GpuPipelineStatistics) == statisticCount*sizeof(uint64_t));
+
+////////////////////////////////////////////////////////////////////////////////
+// small stable ids for the trace, thread ids themselves are opaque
+uint32_t TraceThreadId() {
+  static std::atomic<uint32_t> nextId { 0 };
+  thread_local uint32_t const id = nextId++;
+  return id;
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+GpuProfiler::GpuProfiler(
+  GraphicsContext & context_
+, uint32_t framesInFlight
+, uint32_t maxZonesPerFrame
+)
+: context{&context_}
+, maxZones{maxZonesPerFrame}
+, epoch{std::chrono::steady_clock::now()}
+{
+  auto & device = this->context->device;
+
+  this->timestampPeriodNs =
+    this->context->deviceProperties.limits.timestampPeriod;
+
+  auto const validBits =
+    this->context
+      ->queueFamilyProperties[this->context->graphicsQueueIdx]
+      .timestampValidBits;
+  if (validBits == 0) {
+    spdlog::error("Graphics queue does not support timestamps, no GPU zones");
+    this->maxZones = 0;
+  }
+  this->timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  this->statisticsEnabled =
+    this->context->enabledFeatures.pipelineStatisticsQuery;
+  if (!this->statisticsEnabled)
+    { spdlog::info("Pipeline statistics queries unsupported, timing only"); }
+
+  this->frames.resize(this->maxZones > 0 ? framesInFlight : 0);
+  for (auto & frame : this->frames) {
+    vk::QueryPoolCreateInfo timestampsCI;
+    timestampsCI.queryType = vk::QueryType::eTimestamp;
+    timestampsCI.queryCount = this->maxZones * 2;
+    frame.timestamps =
+      CheckReturn(
+        device->createQueryPoolUnique(timestampsCI),
+        "Creating timestamp query pool"
+      );
+
+    if (this->statisticsEnabled) {
+      vk::QueryPoolCreateInfo statisticsCI;
+      statisticsCI.queryType = vk::QueryType::ePipelineStatistics;
+      statisticsCI.queryCount = this->maxZones;
+      statisticsCI.pipelineStatistics = statisticFlags;
+      frame.statistics =
+        CheckReturn(
+          device->createQueryPoolUnique(statisticsCI),
+          "Creating pipeline statistics query pool"
+        );
+    }
+
+    frame.zones.reserve(this->maxZones);
+  }
+
+  // zones double as debug markers, so captures in RenderDoc & co. show them
+  if (this->context->enableDebugMarkers) {
+    this->cmdDebugMarkerBegin =
+      reinterpret_cast<PFN_vkCmdDebugMarkerBeginEXT>(
+        device->getProcAddr("vkCmdDebugMarkerBeginEXT")
+      );
+    this->cmdDebugMarkerEnd =
+      reinterpret_cast<PFN_vkCmdDebugMarkerEndEXT>(
+        device->getProcAddr("vkCmdDebugMarkerEndEXT")
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::BeginFrame(
+  vk::CommandBuffer const & commandBuffer
+, uint64_t frameIndex
+) {
+  if (!this->openZones.empty()) {
+    spdlog::error("{} GPU zones left open last frame", this->openZones.size());
+    this->openZones.clear();
+  }
+
+  if (this->frames.empty()) { return; }
+
+  auto & frame = this->frames[frameIndex % this->frames.size()];
+  this->Resolve(frame);
+
+  frame.zones.clear();
+  frame.timestampCount = 0;
+  frame.statisticsCount = 0;
+  frame.frameIndex = frameIndex;
+  frame.cpuBeginUs = this->NowUs();
+
+  commandBuffer.resetQueryPool(*frame.timestamps, 0, this->maxZones * 2);
+  if (frame.statistics)
+    { commandBuffer.resetQueryPool(*frame.statistics, 0, this->maxZones); }
+
+  this->current = &frame;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool GpuProfiler::BeginZone(
+  vk::CommandBuffer const & commandBuffer
+, char const * name
+) {
+  if (!this->current || this->current->zones.size() == this->maxZones)
+    { return false; }
+
+  auto & frame = *this->current;
+
+  Zone zone;
+  zone.name = name;
+  zone.depth = static_cast<uint32_t>(this->openZones.size());
+  zone.timestampQuery = frame.timestampCount;
+  frame.timestampCount += 2;
+
+  if (this->cmdDebugMarkerBegin) {
+    VkDebugMarkerMarkerInfoEXT markerInfo = {};
+    markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
+    markerInfo.pMarkerName = name;
+    this->cmdDebugMarkerBegin(
+      static_cast<VkCommandBuffer>(commandBuffer), &markerInfo
+    );
+  }
+
+  commandBuffer.writeTimestamp(
+    vk::PipelineStageFlagBits::eTopOfPipe
+  , *frame.timestamps
+  , zone.timestampQuery
+  );
+
+  if (this->statisticsEnabled && zone.depth == 0) {
+    zone.statisticsQuery = frame.statisticsCount++;
+    commandBuffer.beginQuery(*frame.statistics, zone.statisticsQuery, {});
+  }
+
+  this->openZones.push_back(static_cast<uint32_t>(frame.zones.size()));
+  frame.zones.emplace_back(std::move(zone));
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::EndZone(vk::CommandBuffer const & commandBuffer) {
+  if (this->openZones.empty()) {
+    spdlog::error("GPU zone ended without one open");
+    return;
+  }
+
+  auto & frame = *this->current;
+  auto const & zone = frame.zones[this->openZones.back()];
+  this->openZones.pop_back();
+
+  if (zone.statisticsQuery != ~0u)
+    { commandBuffer.endQuery(*frame.statistics, zone.statisticsQuery); }
+
+  commandBuffer.writeTimestamp(
+    vk::PipelineStageFlagBits::eBottomOfPipe
+  , *frame.timestamps
+  , zone.timestampQuery + 1
+  );
+
+  if (this->cmdDebugMarkerEnd) {
+    this->cmdDebugMarkerEnd(static_cast<VkCommandBuffer>(commandBuffer));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::Resolve(FrameQueries & frame) {
+  if (frame.zones.empty()) { return; }
+
+  // the slot has retired, so this never waits; a frame that was recorded but
+  // never submitted reports not ready and is dropped
+  auto const timestamps =
+    this->context->device->getQueryPoolResults<uint64_t>(
+      *frame.timestamps
+    , 0, frame.timestampCount
+    , frame.timestampCount * sizeof(uint64_t), sizeof(uint64_t)
+    , vk::QueryResultFlagBits::e64
+    );
+  if (timestamps.result != vk::Result::eSuccess) { return; }
+
+  std::vector<GpuPipelineStatistics> statistics;
+  if (frame.statisticsCount > 0) {
+    auto result =
+      this->context->device->getQueryPoolResults<GpuPipelineStatistics>(
+        *frame.statistics
+      , 0, frame.statisticsCount
+      , frame.statisticsCount * sizeof(GpuPipelineStatistics)
+      , sizeof(GpuPipelineStatistics)
+      , vk::QueryResultFlagBits::e64
+      );
+    if (result.result == vk::Result::eSuccess)
+      { statistics = std::move(result.value); }
+  }
+
+  auto const & ticks = timestamps.value;
+  auto const mask = this->timestampMask;
+  uint64_t const base = ticks[0] & mask;
+
+  // ticks may wrap within timestampValidBits, differences stay correct
+  auto const toMs = [&](uint64_t tick) {
+    return
+      static_cast<double>((tick - base) & mask) * this->timestampPeriodNs
+    / 1'000'000.0;
+  };
+
+  this->lastResults.clear();
+  for (auto const & zone : frame.zones) {
+    GpuZoneResult result;
+    result.name = zone.name;
+    result.depth = zone.depth;
+    result.frameIndex = frame.frameIndex;
+    result.beginMs = toMs(ticks[zone.timestampQuery]);
+    result.endMs = toMs(ticks[zone.timestampQuery + 1]);
+    if (zone.statisticsQuery < statistics.size()) {
+      result.hasStatistics = true;
+      result.statistics = statistics[zone.statisticsQuery];
+    }
+    this->lastResults.emplace_back(std::move(result));
+  }
+
+  // GPU & CPU clocks are unrelated, the first resolved frame is pinned to
+  // when it was recorded; later frames keep the GPU's own spacing
+  double const baseUs =
+    static_cast<double>(base) * this->timestampPeriodNs / 1000.0;
+  if (!this->gpuOffsetKnown) {
+    this->gpuOffsetUs = frame.cpuBeginUs - baseUs;
+    this->gpuOffsetKnown = true;
+  }
+
+  for (auto const & result : this->lastResults) {
+    TraceEvent event;
+    event.name = result.name;
+    event.pid = 1;
+    event.tid = 0;
+    event.beginUs = this->gpuOffsetUs + baseUs + result.beginMs * 1000.0;
+    event.durationUs = (result.endMs - result.beginMs) * 1000.0;
+    event.hasStatistics = result.hasStatistics;
+    event.statistics = result.statistics;
+    this->AppendTrace(std::move(event));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::Flush() {
+  std::vector<FrameQueries*> pending;
+  for (auto & frame : this->frames) {
+    if (!frame.zones.empty()) { pending.emplace_back(&frame); }
+  }
+  std::sort(pending.begin(), pending.end(), [](auto const * a, auto const * b) {
+    return a->frameIndex < b->frameIndex;
+  });
+
+  for (auto * frame : pending) {
+    this->Resolve(*frame);
+    frame->zones.clear();
+  }
+  this->current = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::LogLastResults() const {
+  for (auto const & result : this->lastResults) {
+    spdlog::info(
+      "GPU frame {} {}{}: {:.3f} ms"
+    , result.frameIndex
+    , std::string(result.depth * 2, ' ')
+    , result.name
+    , result.endMs - result.beginMs
+    );
+    if (result.hasStatistics) {
+      spdlog::info(
+        "  vertices {} primitives {} fragments {} compute {}"
+      , result.statistics.inputAssemblyVertices
+      , result.statistics.inputAssemblyPrimitives
+      , result.statistics.fragmentShaderInvocations
+      , result.statistics.computeShaderInvocations
+      );
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double GpuProfiler::NowUs() const {
+  return
+    std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - this->epoch
+    ).count();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::AddCpuZone(char const * name, double beginUs, double endUs) {
+  TraceEvent event;
+  event.name = name;
+  event.pid = 0;
+  event.tid = TraceThreadId();
+  event.beginUs = beginUs;
+  event.durationUs = endUs - beginUs;
+  this->AppendTrace(std::move(event));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::AppendTrace(TraceEvent event) {
+  std::lock_guard<std::mutex> lock(this->traceMutex);
+  if (!this->capture) { return; }
+
+  if (this->trace.size() >= this->maxTraceEvents) {
+    spdlog::warn("Trace full at {} events, capture stopped", this->trace.size());
+    this->capture = false;
+    return;
+  }
+
+  this->trace.emplace_back(std::move(event));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GpuProfiler::SetCapture(bool enabled, size_t maxEvents) {
+  std::lock_guard<std::mutex> lock(this->traceMutex);
+  this->capture = enabled;
+  this->maxTraceEvents = maxEvents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool GpuProfiler::WriteChromeTrace(std::string const & path) const {
+  std::lock_guard<std::mutex> lock(this->traceMutex);
+
+  std::ofstream file(path, std::ios::trunc);
+  if (!file) {
+    spdlog::error("Could not open trace '{}'", path);
+    return false;
+  }
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file
+    << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+       "\"args\":{\"name\":\"CPU\"}},\n"
+    << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+       "\"args\":{\"name\":\"GPU (graphics queue)\"}}";
+
+  for (auto const & event : this->trace) {
+    file
+      << fmt::format(
+           ",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":{},\"tid\":{},"
+           "\"ts\":{:.3f},\"dur\":{:.3f}"
+         , EscapeJson(event.name), event.pid, event.tid
+         , event.beginUs, event.durationUs
+         );
+    if (event.hasStatistics) {
+      auto const & stats = event.statistics;
+      file
+        << fmt::format(
+             ",\"args\":{{\"vertices\":{},\"primitives\":{},"
+             "\"vertexInvocations\":{},\"clippedPrimitives\":{},"
+             "\"fragmentInvocations\":{},\"computeInvocations\":{}}}"
+           , stats.inputAssemblyVertices, stats.inputAssemblyPrimitives
+           , stats.vertexShaderInvocations, stats.clippingPrimitives
+           , stats.fragmentShaderInvocations, stats.computeShaderInvocations
+           );
+    }
+    file << "}";
+  }
+  file << "\n]}\n";
+
+  if (!file) {
+    spdlog::error("Writing trace '{}'", path);
+    return false;
+  }
+  spdlog::info("Wrote {} trace events to '{}'", this->trace.size(), path);
+  return true;
+}
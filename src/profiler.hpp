@@ -0,0 +1,169 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+struct GpuPipelineStatistics {
+  uint64_t inputAssemblyVertices = 0;
+  uint64_t inputAssemblyPrimitives = 0;
+  uint64_t vertexShaderInvocations = 0;
+  uint64_t clippingPrimitives = 0;
+  uint64_t fragmentShaderInvocations = 0;
+  uint64_t computeShaderInvocations = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct GpuZoneResult {
+  std::string name;
+  uint32_t depth = 0;
+  uint64_t frameIndex = 0;
+  // relative to the first timestamp of the frame
+  double beginMs = 0.0, endMs = 0.0;
+  // only gathered for outermost zones, statistics queries can't nest
+  bool hasStatistics = false;
+  GpuPipelineStatistics statistics;
+};
+
+// GPU timestamps & pipeline statistics around nested, named zones, plus CPU
+// zones on any thread, exportable as a Chrome trace (chrome://tracing or
+// ui.perfetto.dev). Queries live in one pool per frame in flight and are read
+// back without waiting when the slot comes around again, so results lag by
+// framesInFlight frames. Zones must be recorded into command buffers that are
+// submitted to the graphics queue; a zone must begin & end on the same side
+// of a render pass boundary.
+class GpuProfiler {
+private:
+  struct Zone {
+    std::string name;
+    uint32_t depth = 0;
+    uint32_t timestampQuery = 0;
+    uint32_t statisticsQuery = ~0u; // ~0u if not gathered
+  };
+
+  struct FrameQueries {
+    vk::UniqueQueryPool timestamps;
+    vk::UniqueQueryPool statistics;
+    std::vector<Zone> zones;
+    uint32_t timestampCount = 0;
+    uint32_t statisticsCount = 0;
+    uint64_t frameIndex = 0;
+    double cpuBeginUs = 0.0; // when the frame was recorded, for the trace
+  };
+
+  struct TraceEvent {
+    std::string name;
+    uint32_t pid, tid;
+    double beginUs, durationUs;
+    bool hasStatistics = false;
+    GpuPipelineStatistics statistics;
+  };
+
+  GraphicsContext* context = nullptr;
+
+  double timestampPeriodNs = 1.0;
+  uint64_t timestampMask = ~0ull;
+  bool statisticsEnabled = false;
+  uint32_t maxZones = 0;
+
+  std::vector<FrameQueries> frames;
+  FrameQueries* current = nullptr;
+  std::vector<uint32_t> openZones;
+
+  std::vector<GpuZoneResult> lastResults;
+
+  PFN_vkCmdDebugMarkerBeginEXT cmdDebugMarkerBegin = nullptr;
+  PFN_vkCmdDebugMarkerEndEXT cmdDebugMarkerEnd = nullptr;
+
+  std::chrono::steady_clock::time_point epoch;
+  // GPU microseconds + offset gives trace time, set from the first frame
+  bool gpuOffsetKnown = false;
+  double gpuOffsetUs = 0.0;
+
+  mutable std::mutex traceMutex;
+  bool capture = false;
+  std::vector<TraceEvent> trace;
+  size_t maxTraceEvents = 0;
+
+  void Resolve(FrameQueries & frame);
+  void AppendTrace(TraceEvent event);
+
+public:
+  GpuProfiler(
+    GraphicsContext & context_
+  , uint32_t framesInFlight
+  , uint32_t maxZonesPerFrame = 256
+  );
+  GpuProfiler(GpuProfiler const &) = delete;
+  GpuProfiler(GpuProfiler &&) = delete;
+
+  // reads back the results of the frame that last used the slot & resets its
+  // pools on commandBuffer, which must be the frame's first command buffer on
+  // the graphics queue and outside of a render pass. The slot must have
+  // retired, ei. call right after BeginFrame on the FrameRing
+  void BeginFrame(vk::CommandBuffer const & commandBuffer, uint64_t frameIndex);
+
+  // returns false (recording nothing) once the frame is out of zones
+  bool BeginZone(vk::CommandBuffer const & commandBuffer, char const * name);
+  void EndZone(vk::CommandBuffer const & commandBuffer);
+
+  // resolves every frame still waiting on readback, only once the device is
+  // idle; ei. before writing the trace on exit
+  void Flush();
+
+  // zones of the most recently resolved frame, in begin order
+  std::vector<GpuZoneResult> const & LastResults() const { return lastResults; }
+  void LogLastResults() const;
+
+  // CPU time since the profiler was created, the time base of the trace
+  double NowUs() const;
+  // records a completed CPU zone of the calling thread, thread safe
+  void AddCpuZone(char const * name, double beginUs, double endUs);
+
+  // starts/stops collecting trace events; capped so a forgotten capture
+  // can't grow without bound
+  void SetCapture(bool enabled, size_t maxEvents = 1u << 20);
+  bool WriteChromeTrace(std::string const & path) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class ScopedGpuZone {
+private:
+  GpuProfiler & profiler;
+  vk::CommandBuffer commandBuffer;
+  bool open;
+
+public:
+  ScopedGpuZone(
+    GpuProfiler & profiler_
+  , vk::CommandBuffer const & commandBuffer_
+  , char const * name
+  )
+  : profiler{profiler_}
+  , commandBuffer{commandBuffer_}
+  , open{profiler.BeginZone(commandBuffer, name)}
+  {}
+  ~ScopedGpuZone() { if (open) { profiler.EndZone(commandBuffer); } }
+  ScopedGpuZone(ScopedGpuZone const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class ScopedCpuZone {
+private:
+  GpuProfiler & profiler;
+  char const * name;
+  double beginUs;
+
+public:
+  ScopedCpuZone(GpuProfiler & profiler_, char const * name_)
+  : profiler{profiler_}, name{name_}, beginUs{profiler.NowUs()}
+  {}
+  ~ScopedCpuZone() { profiler.AddCpuZone(name, beginUs, profiler.NowUs()); }
+  ScopedCpuZone(ScopedCpuZone const &) = delete;
+};
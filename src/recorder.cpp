@@ -0,0 +1,116 @@
+#include "recorder.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+#include "jobs.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+CommandRecorder::CommandRecorder(
+  GraphicsContext & context_
+, JobSystem & jobs_
+, uint32_t framesInFlight
+)
+: context{&context_}, jobs{&jobs_}
+{
+  this->pools.resize(framesInFlight);
+  for (auto & framePools : this->pools) {
+    framePools.resize(this->jobs->ThreadCount() + 1);
+    for (auto & pool : framePools) {
+      vk::CommandPoolCreateInfo commandPoolCI;
+      commandPoolCI.queueFamilyIndex = this->context->graphicsQueueIdx;
+      commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eTransient;
+      pool.commandPool =
+        CheckReturn(
+          this->context->device->createCommandPoolUnique(commandPoolCI),
+          "Creating recorder command pool"
+        );
+    }
+  }
+
+  spdlog::info("Recording command buffers on {} threads", this->ThreadCount());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CommandRecorder::ThreadCount() const {
+  return this->jobs->ThreadCount();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CommandRecorder::BeginFrame(uint64_t frameIndex) {
+  this->currentFrame = static_cast<uint32_t>(frameIndex % this->pools.size());
+
+  for (auto & pool : this->pools[this->currentFrame]) {
+    this->context->device->resetCommandPool(*pool.commandPool, {});
+    pool.usedCommandBuffers = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CommandRecorder::RecordSecondaries(
+  vk::CommandBuffer const & primary
+, vk::RenderPassBeginInfo const & renderPassBI
+, std::vector<RecordTask> const & tasks
+) {
+  std::vector<vk::CommandBuffer> secondaries(tasks.size());
+
+  vk::CommandBufferInheritanceInfo inheritance;
+  inheritance.renderPass = renderPassBI.renderPass;
+  inheritance.subpass = 0;
+  inheritance.framebuffer = renderPassBI.framebuffer;
+
+  vk::CommandBufferBeginInfo commandBufferBI;
+  commandBufferBI.flags =
+    vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+  | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+  commandBufferBI.pInheritanceInfo = &inheritance;
+
+  // one task per job at most, a job costs more than recording a tiny task
+  this->jobs->ParallelFor(
+    0, static_cast<uint32_t>(tasks.size()), 1
+  , [&](uint32_t first, uint32_t last) {
+      for (uint32_t taskIdx = first; taskIdx < last; ++ taskIdx) {
+        auto const commandBuffer = this->AllocateSecondary();
+        commandBuffer.begin(commandBufferBI);
+        tasks[taskIdx](commandBuffer);
+        commandBuffer.end();
+
+        // each slot is written by exactly one job, published by its counter
+        secondaries[taskIdx] = commandBuffer;
+      }
+    }
+  );
+
+  // merged in task order regardless of which thread recorded what
+  if (!secondaries.empty())
+    { primary.executeCommands(secondaries); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::CommandBuffer CommandRecorder::AllocateSecondary() {
+  // only ever touched by one thread at a time, so the pool needs no lock;
+  // threads outside the job system all land on the last slot
+  auto const threadIdx =
+    std::min(this->jobs->ThreadIndex(), this->ThreadCount());
+  auto & pool = this->pools[this->currentFrame][threadIdx];
+
+  if (pool.usedCommandBuffers == pool.commandBuffers.size()) {
+    vk::CommandBufferAllocateInfo commandBufferAI;
+    commandBufferAI.commandPool = *pool.commandPool;
+    commandBufferAI.commandBufferCount =
+      std::max<uint32_t>(4u, static_cast<uint32_t>(pool.commandBuffers.size()));
+    commandBufferAI.level = vk::CommandBufferLevel::eSecondary;
+    auto const allocated =
+      CheckReturn(
+        this->context->device->allocateCommandBuffers(commandBufferAI),
+        "Allocating secondary command buffers"
+      );
+    pool.commandBuffers.insert(
+      pool.commandBuffers.end(), allocated.begin(), allocated.end()
+    );
+  }
+
+  return pool.commandBuffers[pool.usedCommandBuffers++];
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <functional>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+class JobSystem; // -- fwd decl
+
+using RecordTask = std::function<void(vk::CommandBuffer const &)>;
+
+// records the contents of a render pass in parallel: every task gets its own
+// secondary command buffer, recorded as a job on whichever thread of the
+// JobSystem picks it up, and the secondaries are executed into the primary in
+// task order, so the result does not depend on scheduling. Each thread of the
+// system owns a transient command pool per frame in flight, plus one shared by
+// threads outside it, of which only one may record at a time; pools are reset
+// wholesale in BeginFrame instead of per command buffer.
+class CommandRecorder {
+private:
+  struct ThreadPool {
+    vk::UniqueCommandPool commandPool;
+    std::vector<vk::CommandBuffer> commandBuffers;
+    uint32_t usedCommandBuffers = 0;
+  };
+
+  GraphicsContext* context = nullptr;
+  JobSystem* jobs = nullptr;
+
+  // [frame slot][thread], the last thread slot is for threads outside jobs
+  std::vector<std::vector<ThreadPool>> pools;
+  uint32_t currentFrame = 0;
+
+  vk::CommandBuffer AllocateSecondary();
+
+public:
+  CommandRecorder(
+    GraphicsContext & context_
+  , JobSystem & jobs_
+  , uint32_t framesInFlight
+  );
+  CommandRecorder(CommandRecorder const &) = delete;
+  CommandRecorder(CommandRecorder &&) = delete;
+
+  uint32_t ThreadCount() const;
+
+  // resets every pool of the frame slot; the frame that last used it must
+  // have retired, ei. call right after BeginFrame on the FrameRing
+  void BeginFrame(uint64_t frameIndex);
+
+  // records the tasks in parallel into secondaries continuing renderPassBI's
+  // render pass & executes them in order; primary must be inside that render
+  // pass, begun with secondary contents, ei. by a RenderGraph pass. Blocks
+  // until every task has been recorded, running jobs meanwhile.
+  void RecordSecondaries(
+    vk::CommandBuffer const & primary
+  , vk::RenderPassBeginInfo const & renderPassBI
+  , std::vector<RecordTask> const & tasks
+  );
+};
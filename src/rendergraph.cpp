@@ -0,0 +1,813 @@
+#include "rendergraph.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+struct AccessInfo {
+  vk::PipelineStageFlags stage;
+  vk::AccessFlags access;
+  vk::ImageLayout layout;
+  vk::ImageUsageFlags usage;
+  bool write;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+AccessInfo Info(RGAccessType type) {
+  using Stage = vk::PipelineStageFlagBits;
+  using Access = vk::AccessFlagBits;
+  using Layout = vk::ImageLayout;
+  using Usage = vk::ImageUsageFlagBits;
+
+  switch (type) {
+    case RGAccessType::ColorAttachment:
+      return {
+        Stage::eColorAttachmentOutput
+      , Access::eColorAttachmentRead | Access::eColorAttachmentWrite
+      , Layout::eColorAttachmentOptimal
+      , Usage::eColorAttachment
+      , true
+      };
+    case RGAccessType::DepthStencilAttachment:
+      return {
+        Stage::eEarlyFragmentTests | Stage::eLateFragmentTests
+      , Access::eDepthStencilAttachmentRead
+      | Access::eDepthStencilAttachmentWrite
+      , Layout::eDepthStencilAttachmentOptimal
+      , Usage::eDepthStencilAttachment
+      , true
+      };
+    case RGAccessType::StorageWrite:
+      return {
+        Stage::eComputeShader
+      , Access::eShaderRead | Access::eShaderWrite
+      , Layout::eGeneral
+      , Usage::eStorage
+      , true
+      };
+    case RGAccessType::TransferDst:
+      return {
+        Stage::eTransfer, Access::eTransferWrite
+      , Layout::eTransferDstOptimal, Usage::eTransferDst, true
+      };
+    case RGAccessType::SampledFragment:
+      return {
+        Stage::eFragmentShader, Access::eShaderRead
+      , Layout::eShaderReadOnlyOptimal, Usage::eSampled, false
+      };
+    case RGAccessType::SampledCompute:
+      return {
+        Stage::eComputeShader, Access::eShaderRead
+      , Layout::eShaderReadOnlyOptimal, Usage::eSampled, false
+      };
+    case RGAccessType::StorageRead:
+      return {
+        Stage::eComputeShader, Access::eShaderRead
+      , Layout::eGeneral, Usage::eStorage, false
+      };
+    case RGAccessType::TransferSrc:
+      return {
+        Stage::eTransfer, Access::eTransferRead
+      , Layout::eTransferSrcOptimal, Usage::eTransferSrc, false
+      };
+  }
+  return {};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool IsAttachment(RGAccessType type) {
+  return
+    type == RGAccessType::ColorAttachment
+ || type == RGAccessType::DepthStencilAttachment;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::ImageAspectFlags AspectOf(vk::Format format) {
+  switch (format) {
+    case vk::Format::eD16Unorm:
+    case vk::Format::eX8D24UnormPack32:
+    case vk::Format::eD32Sfloat:
+      return vk::ImageAspectFlagBits::eDepth;
+    case vk::Format::eD16UnormS8Uint:
+    case vk::Format::eD24UnormS8Uint:
+    case vk::Format::eD32SfloatS8Uint:
+      return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+    default:
+      return vk::ImageAspectFlagBits::eColor;
+  }
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+RenderGraph::RenderGraph(GraphicsContext & context_)
+: context{&context_}
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+RenderGraph::~RenderGraph() {
+  this->Retire()();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RGResourceId RenderGraph::CreateImage(
+  std::string const & name
+, RGImageDesc const & desc
+) {
+  Resource resource;
+  resource.name = name;
+  resource.desc = desc;
+  resource.aspect = AspectOf(desc.format);
+  this->resources.emplace_back(std::move(resource));
+  return static_cast<RGResourceId>(this->resources.size() - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RGResourceId RenderGraph::ImportImage(
+  std::string const & name
+, RGImageDesc const & desc
+, vk::ImageLayout initialLayout
+, vk::ImageLayout finalLayout
+) {
+  auto const id = this->CreateImage(name, desc);
+  auto & resource = this->resources[id];
+  resource.imported = true;
+  resource.importedInitialLayout = initialLayout;
+  resource.importedFinalLayout = finalLayout;
+  return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::SetImported(
+  RGResourceId resource
+, vk::Image const & image
+, vk::ImageView const & view
+) {
+  this->resources[resource].image = image;
+  this->resources[resource].view = view;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::function<void()> RenderGraph::InvalidateImported(RGResourceId resource) {
+  this->resources[resource].image = nullptr;
+  this->resources[resource].view = nullptr;
+
+  // every view the import was ever bound to is gone, not just the last one
+  std::vector<vk::Framebuffer> evicted;
+  for (auto & pass : this->passes) {
+    auto const & attachments = pass.attachments;
+    if (
+      std::find(attachments.begin(), attachments.end(), resource)
+   == attachments.end()
+    ) {
+      continue;
+    }
+    for (auto const & framebuffer : pass.framebuffers)
+      { evicted.emplace_back(framebuffer.framebuffer); }
+    pass.framebuffers.clear();
+  }
+
+  return [evicted = std::move(evicted), device = this->context->device.get()] {
+    for (auto const & framebuffer : evicted)
+      { device.destroyFramebuffer(framebuffer); }
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::ResizeImported(
+  RGResourceId resource
+, vk::Extent2D const & extent
+) {
+  this->resources[resource].desc.extent = extent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::AddPass(RGPassDesc desc) {
+  Pass pass;
+  pass.desc = std::move(desc);
+  this->passes.emplace_back(std::move(pass));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::function<void()> RenderGraph::Compile() {
+  auto retire = this->Retire();
+
+  this->Cull();
+  this->ComputeLifetimes();
+  this->CreateTransients();
+  this->DeriveBarriers();
+  this->CreateRenderPasses();
+
+  return retire;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::Cull() {
+  // outputs are imports the graph hands back in a defined layout
+  std::vector<bool> needed(this->resources.size(), false);
+  for (size_t i = 0; i < this->resources.size(); ++ i) {
+    auto const & resource = this->resources[i];
+    needed[i] =
+      resource.imported
+   && resource.importedFinalLayout != vk::ImageLayout::eUndefined;
+  }
+
+  for (auto pass = this->passes.rbegin(); pass != this->passes.rend(); ++ pass)
+  {
+    bool alive = pass->desc.sideEffects;
+    for (auto const & write : pass->desc.writes)
+      { alive = alive || needed[write.resource]; }
+
+    pass->culled = !alive;
+    if (!alive) { continue; }
+
+    for (auto const & read : pass->desc.reads)
+      { needed[read.resource] = true; }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::ComputeLifetimes() {
+  for (auto & resource : this->resources) {
+    resource.used = false;
+    resource.usage = resource.desc.usage;
+    resource.aliasPredecessors.clear();
+  }
+
+  for (uint32_t i = 0; i < this->passes.size(); ++ i) {
+    auto const & pass = this->passes[i];
+    if (pass.culled) { continue; }
+
+    for (auto const * accesses : { &pass.desc.reads, &pass.desc.writes })
+    for (auto const & access : *accesses) {
+      auto & resource = this->resources[access.resource];
+      if (!resource.used) { resource.firstPass = i; }
+      resource.used = true;
+      resource.lastPass = i;
+      resource.usage |= Info(access.type).usage;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::CreateTransients() {
+  auto & device = this->context->device;
+
+  std::vector<RGResourceId> transients;
+  for (uint32_t i = 0; i < this->resources.size(); ++ i) {
+    auto const & resource = this->resources[i];
+    if (!resource.imported && resource.used) { transients.emplace_back(i); }
+  }
+  this->transientBytes = 0;
+  if (transients.empty()) { return; }
+
+  for (auto const id : transients) {
+    auto & resource = this->resources[id];
+
+    vk::ImageCreateInfo imageCI;
+    imageCI.imageType = vk::ImageType::e2D;
+    imageCI.format = resource.desc.format;
+    imageCI.extent =
+      vk::Extent3D {
+        resource.desc.extent.width, resource.desc.extent.height, 1
+      };
+    imageCI.mipLevels = 1;
+    imageCI.arrayLayers = 1;
+    imageCI.samples = vk::SampleCountFlagBits::e1;
+    imageCI.tiling = vk::ImageTiling::eOptimal;
+    imageCI.usage = resource.usage;
+    imageCI.sharingMode = vk::SharingMode::eExclusive;
+    imageCI.initialLayout = vk::ImageLayout::eUndefined;
+
+    resource.image =
+      CheckReturn(device->createImage(imageCI), "Creating transient image");
+
+    auto const requirements =
+      device->getImageMemoryRequirements(resource.image);
+    resource.size = requirements.size;
+    resource.alignment = requirements.alignment;
+    resource.memoryTypeBits = requirements.memoryTypeBits;
+    this->transientBytes += requirements.size;
+  }
+
+  // largest first, each placed at the lowest offset not overlapping anything
+  // that is alive at the same time
+  std::sort(
+    transients.begin(), transients.end()
+  , [this](RGResourceId a, RGResourceId b) {
+      return this->resources[a].size > this->resources[b].size;
+    }
+  );
+
+  vk::MemoryRequirements heapRequirements;
+  heapRequirements.memoryTypeBits = ~0u;
+  heapRequirements.alignment = 1;
+
+  std::vector<RGResourceId> placed;
+  for (auto const id : transients) {
+    auto & resource = this->resources[id];
+
+    auto const livesWith = [&](Resource const & other) {
+      return
+        other.firstPass <= resource.lastPass
+     && resource.firstPass <= other.lastPass;
+    };
+
+    vk::DeviceSize offset = 0;
+    for (bool moved = true; moved;) {
+      moved = false;
+      for (auto const otherId : placed) {
+        auto const & other = this->resources[otherId];
+        if (!livesWith(other)) { continue; }
+        if (offset < other.offset + other.size
+         && other.offset < offset + resource.size
+        ) {
+          offset = AlignUp(other.offset + other.size, resource.alignment);
+          moved = true;
+        }
+      }
+    }
+    resource.offset = offset;
+
+    for (auto const otherId : placed) {
+      auto const & other = this->resources[otherId];
+      if (other.lastPass < resource.firstPass
+       && offset < other.offset + other.size
+       && other.offset < offset + resource.size
+      ) {
+        resource.aliasPredecessors.emplace_back(otherId);
+      }
+    }
+    placed.emplace_back(id);
+
+    heapRequirements.size =
+      std::max(heapRequirements.size, offset + resource.size);
+    heapRequirements.alignment =
+      std::max(heapRequirements.alignment, resource.alignment);
+    heapRequirements.memoryTypeBits &= resource.memoryTypeBits;
+  }
+
+  // placement is order dependent, a resource placed later can still come
+  // before one placed earlier on the timeline
+  for (auto const id : transients) {
+    auto & resource = this->resources[id];
+    for (auto const otherId : transients) {
+      auto const & other = this->resources[otherId];
+      if (otherId == id || other.lastPass >= resource.firstPass) { continue; }
+      bool const overlaps =
+        resource.offset < other.offset + other.size
+     && other.offset < resource.offset + resource.size;
+      auto & predecessors = resource.aliasPredecessors;
+      if (overlaps
+       && std::find(predecessors.begin(), predecessors.end(), otherId)
+       == predecessors.end()
+      ) {
+        predecessors.emplace_back(otherId);
+      }
+    }
+  }
+
+  if (heapRequirements.memoryTypeBits == 0)
+    { spdlog::error("Transient images share no memory type to alias in"); }
+
+  AllocationCreateInfo allocationCI;
+  allocationCI.usage = MemoryUsage::GpuOnly;
+  allocationCI.strategy = AllocationStrategy::Dedicated;
+  allocationCI.category = MemoryCategory::Transient;
+  this->transientMemory =
+    this->context->allocator->Allocate(heapRequirements, allocationCI);
+
+  for (auto const id : transients) {
+    auto & resource = this->resources[id];
+    device->bindImageMemory(
+      resource.image
+    , this->transientMemory.memory
+    , this->transientMemory.offset + resource.offset
+    );
+
+    vk::ImageViewCreateInfo viewCI;
+    viewCI.image = resource.image;
+    viewCI.viewType = vk::ImageViewType::e2D;
+    viewCI.format = resource.desc.format;
+    viewCI.subresourceRange =
+      vk::ImageSubresourceRange { resource.aspect, 0, 1, 0, 1 };
+    resource.view =
+      CheckReturn(
+        device->createImageView(viewCI),
+        "Creating transient image view"
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::DeriveBarriers() {
+  struct State {
+    bool touched = false;
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    vk::PipelineStageFlags writeStage;
+    vk::AccessFlags writeAccess;
+    vk::PipelineStageFlags readStages;
+    // stages the last write has already been made visible to
+    vk::PipelineStageFlags visibleStages;
+  };
+  std::vector<State> states(this->resources.size());
+
+  // first uses of transients, which also wait on the previous frame's uses of
+  // the same memory once every pass has been walked
+  struct FirstUse {
+    BarrierBatch* batch;
+    size_t barrierIdx;
+  };
+  std::vector<FirstUse> firstUses;
+
+  for (auto & pass : this->passes) {
+    pass.barriers = BarrierBatch {};
+    if (pass.culled) { continue; }
+
+    // a resource both read & written in a pass is synchronized once
+    std::map<RGResourceId, AccessInfo> accesses;
+    for (auto const * list : { &pass.desc.reads, &pass.desc.writes })
+    for (auto const & access : *list) {
+      auto const info = Info(access.type);
+      auto [it, inserted] = accesses.emplace(access.resource, info);
+      if (inserted) { continue; }
+      it->second.stage  |= info.stage;
+      it->second.access |= info.access;
+      it->second.write  |= info.write;
+      if (info.write) { it->second.layout = info.layout; }
+    }
+
+    auto & batch = pass.barriers;
+    for (auto const & [id, info] : accesses) {
+      auto const & resource = this->resources[id];
+      auto & state = states[id];
+
+      Barrier barrier;
+      barrier.resource = id;
+      barrier.newLayout = info.layout;
+      barrier.dstAccess = info.access;
+      vk::PipelineStageFlags srcStage;
+      bool needed = false;
+
+      if (!state.touched) {
+        if (resource.imported) {
+          // the stage waiting on whatever semaphore delivered the image
+          barrier.oldLayout = resource.importedInitialLayout;
+          srcStage = vk::PipelineStageFlagBits::eAllCommands;
+        } else {
+          barrier.oldLayout = vk::ImageLayout::eUndefined;
+          for (auto const predecessor : resource.aliasPredecessors) {
+            auto const & previous = states[predecessor];
+            srcStage |= previous.writeStage | previous.readStages;
+            barrier.srcAccess |= previous.writeAccess;
+          }
+        }
+        needed = barrier.oldLayout != barrier.newLayout || srcStage;
+      } else {
+        barrier.oldLayout = state.layout;
+        bool const layoutChange = state.layout != info.layout;
+        bool const unseenWrite =
+          state.writeStage && (info.stage & ~state.visibleStages);
+
+        needed = info.write || layoutChange || unseenWrite;
+        srcStage = state.writeStage;
+        barrier.srcAccess = state.writeAccess;
+        // write-after-read & transitions also wait for earlier readers
+        if (info.write || layoutChange) { srcStage |= state.readStages; }
+      }
+
+      if (needed) {
+        if (!state.touched && !resource.imported)
+          { firstUses.push_back({ &batch, batch.barriers.size() }); }
+        batch.srcStage |= srcStage;
+        batch.dstStage |= info.stage;
+        batch.barriers.emplace_back(barrier);
+      }
+
+      state.touched = true;
+      state.layout = info.layout;
+      if (info.write) {
+        state.writeStage = info.stage;
+        state.writeAccess = info.access;
+        state.readStages = {};
+        state.visibleStages = {};
+      } else {
+        // a transition behaves as a write that later readers must see
+        if (needed && barrier.oldLayout != barrier.newLayout)
+          { state.writeStage |= info.stage; }
+        if (needed) { state.visibleStages |= info.stage; }
+        state.readStages |= info.stage;
+      }
+    }
+  }
+
+  // with frames in flight the previous frame may still be using the aliased
+  // memory; its last use of anything overlapping the transient, itself
+  // included, comes earlier in submission order on the same queue
+  for (auto const & firstUse : firstUses) {
+    auto & barrier = firstUse.batch->barriers[firstUse.barrierIdx];
+    auto const & resource = this->resources[barrier.resource];
+    for (uint32_t i = 0; i < this->resources.size(); ++ i) {
+      auto const & other = this->resources[i];
+      if (other.imported || !other.used) { continue; }
+      bool const overlaps =
+        resource.offset < other.offset + other.size
+     && other.offset < resource.offset + resource.size;
+      if (!overlaps) { continue; }
+      firstUse.batch->srcStage |= states[i].writeStage | states[i].readStages;
+      barrier.srcAccess |= states[i].writeAccess;
+    }
+  }
+
+  for (auto & pass : this->passes) {
+    auto & batch = pass.barriers;
+    if (!batch.barriers.empty() && !batch.srcStage)
+      { batch.srcStage = vk::PipelineStageFlagBits::eTopOfPipe; }
+  }
+
+  // hand imports back in the layout their owner expects
+  this->finalBarriers = BarrierBatch {};
+  for (uint32_t i = 0; i < this->resources.size(); ++ i) {
+    auto const & resource = this->resources[i];
+    auto const & state = states[i];
+    if (!resource.imported || !state.touched) { continue; }
+    if (resource.importedFinalLayout == vk::ImageLayout::eUndefined
+     || resource.importedFinalLayout == state.layout
+    ) {
+      continue;
+    }
+
+    Barrier barrier;
+    barrier.resource = i;
+    barrier.oldLayout = state.layout;
+    barrier.newLayout = resource.importedFinalLayout;
+    barrier.srcAccess = state.writeAccess;
+    barrier.dstAccess = {};
+    this->finalBarriers.srcStage |= state.writeStage | state.readStages;
+    this->finalBarriers.dstStage = vk::PipelineStageFlagBits::eBottomOfPipe;
+    this->finalBarriers.barriers.emplace_back(barrier);
+  }
+  if (
+    !this->finalBarriers.barriers.empty() && !this->finalBarriers.srcStage
+  ) {
+    this->finalBarriers.srcStage = vk::PipelineStageFlagBits::eTopOfPipe;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::CreateRenderPasses() {
+  for (auto & pass : this->passes) {
+    pass.attachments.clear();
+    pass.clearValues.clear();
+    if (pass.culled) { continue; }
+
+    std::vector<vk::AttachmentDescription> attachments;
+    std::vector<vk::AttachmentReference> colorReferences;
+    vk::AttachmentReference depthReference;
+    bool hasDepth = false;
+
+    for (auto const & write : pass.desc.writes) {
+      if (!IsAttachment(write.type)) { continue; }
+
+      auto const & resource = this->resources[write.resource];
+      auto const info = Info(write.type);
+
+      // the graph's barriers perform every transition, so the render pass
+      // keeps the attachment in the layout it was handed
+      vk::AttachmentDescription desc;
+      desc.format = resource.desc.format;
+      desc.samples = vk::SampleCountFlagBits::e1;
+      desc.loadOp = write.loadOp;
+      desc.storeOp = vk::AttachmentStoreOp::eStore;
+      desc.stencilLoadOp = write.loadOp;
+      desc.stencilStoreOp = vk::AttachmentStoreOp::eStore;
+      desc.initialLayout = info.layout;
+      desc.finalLayout = info.layout;
+
+      auto const idx = static_cast<uint32_t>(attachments.size());
+      if (write.type == RGAccessType::DepthStencilAttachment) {
+        depthReference = vk::AttachmentReference { idx, info.layout };
+        hasDepth = true;
+      } else {
+        colorReferences.emplace_back(idx, info.layout);
+      }
+
+      attachments.emplace_back(desc);
+      pass.attachments.emplace_back(write.resource);
+      pass.clearValues.emplace_back(write.clearValue);
+    }
+
+    if (attachments.empty()) { continue; }
+
+    vk::SubpassDescription subpass;
+    subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+    subpass.colorAttachmentCount =
+      static_cast<uint32_t>(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+    vk::RenderPassCreateInfo info;
+    info.attachmentCount = static_cast<uint32_t>(attachments.size());
+    info.pAttachments = attachments.data();
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+
+    pass.renderPass =
+      CheckReturn(
+        this->context->device->createRenderPassUnique(info),
+        "Creating render graph pass"
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RenderGraph::Pass const * RenderGraph::FindPass(
+  std::string const & passName
+) const {
+  for (auto const & pass : this->passes) {
+    if (pass.desc.name == passName) { return &pass; }
+  }
+  return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::Extent2D RenderGraph::ExtentOf(Pass const & pass) const {
+  // attachments of a pass share their extent, an import's may have changed
+  // since Compile
+  return this->resources[pass.attachments.front()].desc.extent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::Framebuffer const & RenderGraph::FramebufferFor(Pass & pass) {
+  std::vector<vk::ImageView> views;
+  for (auto const id : pass.attachments)
+    { views.emplace_back(this->resources[id].view); }
+
+  for (auto const & framebuffer : pass.framebuffers) {
+    if (framebuffer.views == views) { return framebuffer.framebuffer; }
+  }
+
+  vk::FramebufferCreateInfo framebufferCI;
+  framebufferCI.renderPass = *pass.renderPass;
+  framebufferCI.attachmentCount = static_cast<uint32_t>(views.size());
+  framebufferCI.pAttachments = views.data();
+  auto const extent = this->ExtentOf(pass);
+  framebufferCI.width = extent.width;
+  framebufferCI.height = extent.height;
+  framebufferCI.layers = 1;
+
+  Framebuffer framebuffer;
+  framebuffer.framebuffer =
+    CheckReturn(
+      this->context->device->createFramebuffer(framebufferCI),
+      "Creating render graph framebuffer"
+    );
+  framebuffer.views = std::move(views);
+  pass.framebuffers.emplace_back(std::move(framebuffer));
+  return pass.framebuffers.back().framebuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::RecordBarriers(
+  vk::CommandBuffer const & commandBuffer
+, BarrierBatch const & batch
+) const {
+  if (batch.barriers.empty()) { return; }
+
+  std::vector<vk::ImageMemoryBarrier> imageBarriers;
+  for (auto const & barrier : batch.barriers) {
+    auto const & resource = this->resources[barrier.resource];
+    vk::ImageMemoryBarrier imageBarrier;
+    imageBarrier.srcAccessMask = barrier.srcAccess;
+    imageBarrier.dstAccessMask = barrier.dstAccess;
+    imageBarrier.oldLayout = barrier.oldLayout;
+    imageBarrier.newLayout = barrier.newLayout;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = resource.image;
+    imageBarrier.subresourceRange =
+      vk::ImageSubresourceRange { resource.aspect, 0, 1, 0, 1 };
+    imageBarriers.emplace_back(imageBarrier);
+  }
+
+  commandBuffer.pipelineBarrier(
+    batch.srcStage, batch.dstStage, {}, {}, {}, imageBarriers
+  );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::Execute(vk::CommandBuffer const & commandBuffer) {
+  for (auto & pass : this->passes) {
+    if (pass.culled) { continue; }
+
+    this->RecordBarriers(commandBuffer, pass.barriers);
+
+    if (!pass.renderPass) {
+      if (pass.desc.execute) { pass.desc.execute(commandBuffer, *this); }
+      continue;
+    }
+
+    this->activeRenderPass =
+      vk::RenderPassBeginInfo {
+        *pass.renderPass,
+        this->FramebufferFor(pass),
+        { {}, this->ExtentOf(pass) },
+        static_cast<uint32_t>(pass.clearValues.size()),
+        pass.clearValues.data()
+      };
+    commandBuffer.beginRenderPass(this->activeRenderPass, pass.desc.contents);
+    if (pass.desc.execute) { pass.desc.execute(commandBuffer, *this); }
+    commandBuffer.endRenderPass();
+  }
+  this->activeRenderPass = vk::RenderPassBeginInfo {};
+
+  this->RecordBarriers(commandBuffer, this->finalBarriers);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::RenderPass RenderGraph::RenderPass(std::string const & passName) const {
+  auto const * pass = this->FindPass(passName);
+  if (!pass || !pass->renderPass) { return nullptr; }
+  return *pass->renderPass;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool RenderGraph::IsCulled(std::string const & passName) const {
+  auto const * pass = this->FindPass(passName);
+  return !pass || pass->culled;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RGBarrierBatch const & RenderGraph::Barriers(
+  std::string const & passName
+) const {
+  static RGBarrierBatch const none {};
+  auto const * pass = this->FindPass(passName);
+  return pass ? pass->barriers : none;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::function<void()> RenderGraph::Retire() {
+  struct Retired {
+    std::vector<vk::Image> images;
+    std::vector<vk::ImageView> views;
+    std::vector<vk::Framebuffer> framebuffers;
+    std::vector<vk::UniqueRenderPass> renderPasses;
+    Allocation memory;
+  };
+  auto retired = std::make_shared<Retired>();
+
+  for (auto & resource : this->resources) {
+    if (resource.imported || !resource.image) { continue; }
+    retired->images.emplace_back(resource.image);
+    retired->views.emplace_back(resource.view);
+    resource.image = nullptr;
+    resource.view = nullptr;
+  }
+
+  for (auto & pass : this->passes) {
+    for (auto const & framebuffer : pass.framebuffers)
+      { retired->framebuffers.emplace_back(framebuffer.framebuffer); }
+    pass.framebuffers.clear();
+    if (pass.renderPass)
+      { retired->renderPasses.emplace_back(std::move(pass.renderPass)); }
+  }
+
+  retired->memory = this->transientMemory;
+  this->transientMemory = Allocation {};
+
+  return [
+    retired
+  , device = this->context->device.get()
+  , allocator = this->context->allocator.get()
+  ] {
+    for (auto const & framebuffer : retired->framebuffers)
+      { device.destroyFramebuffer(framebuffer); }
+    for (auto const & view : retired->views)
+      { device.destroyImageView(view); }
+    for (auto const & image : retired->images)
+      { device.destroyImage(image); }
+    retired->renderPasses.clear();
+    allocator->Free(retired->memory);
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RenderGraph::LogStats() const {
+  size_t culled = 0;
+  for (auto const & pass : this->passes)
+    { culled += pass.culled ? 1 : 0; }
+
+  spdlog::info(
+    "Render graph: {} passes ({} culled), transients {} KiB aliased into {} KiB"
+  , this->passes.size(), culled
+  , this->transientBytes/1024, this->transientMemory.size/1024
+  );
+}
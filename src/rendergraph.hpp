@@ -0,0 +1,213 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "vulkan.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+class RenderGraph;      // -- fwd decl
+
+using RGResourceId = uint32_t;
+
+////////////////////////////////////////////////////////////////////////////////
+enum class RGAccessType {
+  // -- writes
+  ColorAttachment,
+  DepthStencilAttachment,
+  StorageWrite,       // compute shader image store
+  TransferDst,
+  // -- reads
+  SampledFragment,
+  SampledCompute,
+  StorageRead,        // compute shader image load
+  TransferSrc,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct RGImageDesc {
+  vk::Format format = vk::Format::eR8G8B8A8Unorm;
+  vk::Extent2D extent;
+  // added to the usage derived from the accesses of the passes
+  vk::ImageUsageFlags usage = {};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct RGAccess {
+  RGResourceId resource;
+  RGAccessType type;
+  // only meaningful for attachments
+  vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eDontCare;
+  vk::ClearValue clearValue = {};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct RGPassDesc {
+  std::string name;
+  std::vector<RGAccess> reads;
+  std::vector<RGAccess> writes;
+  // passes writing attachments are recorded inside a render pass the graph
+  // begins & ends around this; the graph only ever adds barriers outside it
+  std::function<void(vk::CommandBuffer const &, RenderGraph const &)> execute;
+  // eSecondaryCommandBuffers when execute only executes secondaries, ei.
+  // recorded in parallel by a CommandRecorder
+  vk::SubpassContents contents = vk::SubpassContents::eInline;
+  bool sideEffects = false; // never culled, even if nothing reads its output
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct RGBarrier {
+  RGResourceId resource;
+  vk::ImageLayout oldLayout, newLayout;
+  vk::AccessFlags srcAccess, dstAccess;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct RGBarrierBatch {
+  vk::PipelineStageFlags srcStage, dstStage;
+  std::vector<RGBarrier> barriers;
+};
+
+// frame graph over images: passes declare what they read & write, Compile
+// culls passes whose results are never consumed, derives the minimal set of
+// barriers & layout transitions and places transient images with disjoint
+// lifetimes over the same memory. The graph is built & compiled once, then
+// executed every frame; imported images (ei. the swapchain image) are rebound
+// per frame with SetImported & invalidated whenever they are recreated.
+class RenderGraph {
+private:
+  struct Resource {
+    std::string name;
+    RGImageDesc desc;
+    vk::ImageUsageFlags usage;
+    vk::ImageAspectFlags aspect;
+
+    bool imported = false;
+    vk::ImageLayout importedInitialLayout = vk::ImageLayout::eUndefined;
+    vk::ImageLayout importedFinalLayout   = vk::ImageLayout::eUndefined;
+
+    vk::Image image;
+    vk::ImageView view;
+
+    // -- compiled
+    bool used = false;
+    uint32_t firstPass = 0, lastPass = 0;
+    vk::DeviceSize size = 0, alignment = 0, offset = 0;
+    uint32_t memoryTypeBits = 0;
+    // transients that occupied overlapping memory before this one
+    std::vector<RGResourceId> aliasPredecessors;
+  };
+
+  using Barrier = RGBarrier;
+  using BarrierBatch = RGBarrierBatch;
+
+  struct Framebuffer {
+    std::vector<vk::ImageView> views;
+    vk::Framebuffer framebuffer;
+  };
+
+  struct Pass {
+    RGPassDesc desc;
+    bool culled = false;
+    BarrierBatch barriers;
+
+    // -- raster passes only
+    std::vector<RGResourceId> attachments;
+    std::vector<vk::ClearValue> clearValues;
+    vk::UniqueRenderPass renderPass;
+    std::vector<Framebuffer> framebuffers;
+  };
+
+  GraphicsContext* context = nullptr;
+
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  BarrierBatch finalBarriers;
+
+  Allocation transientMemory;
+  vk::DeviceSize transientBytes = 0; // sum over transients, before aliasing
+
+  // of the raster pass being executed
+  vk::RenderPassBeginInfo activeRenderPass;
+
+  void Cull();
+  void ComputeLifetimes();
+  void CreateTransients();
+  void DeriveBarriers();
+  void CreateRenderPasses();
+  Pass const * FindPass(std::string const & passName) const;
+  vk::Extent2D ExtentOf(Pass const & pass) const;
+  vk::Framebuffer const & FramebufferFor(Pass & pass);
+  void RecordBarriers(
+    vk::CommandBuffer const & commandBuffer
+  , BarrierBatch const & batch
+  ) const;
+  std::function<void()> Retire();
+
+public:
+  RenderGraph(GraphicsContext & context_);
+  ~RenderGraph();
+  RenderGraph(RenderGraph const &) = delete;
+  RenderGraph(RenderGraph &&) = delete;
+
+  RGResourceId CreateImage(std::string const & name, RGImageDesc const & desc);
+  // finalLayout is what the image is left in after the graph, ei.
+  // ePresentSrcKHR; eUndefined marks an import that is only read
+  RGResourceId ImportImage(
+    std::string const & name
+  , RGImageDesc const & desc
+  , vk::ImageLayout initialLayout
+  , vk::ImageLayout finalLayout
+  );
+  void SetImported(
+    RGResourceId resource
+  , vk::Image const & image
+  , vk::ImageView const & view
+  );
+  // once the images bound to an import are destroyed (ei. the swapchain was
+  // rebuilt), evicts the cached framebuffers over them so a reused handle
+  // can't match; the returned function destroys those framebuffers and must
+  // only run once no frame in flight uses them, ei. through DeferDestroy
+  std::function<void()> InvalidateImported(RGResourceId resource);
+  // the extent images bound to an import have from now on; render areas
+  // follow it, transients sized after it only change with the next Compile
+  void ResizeImported(RGResourceId resource, vk::Extent2D const & extent);
+
+  void AddPass(RGPassDesc desc);
+
+  // (re)builds everything derived from the declared passes; the returned
+  // function destroys the previous transients & render passes and must only
+  // run once no frame in flight uses them
+  std::function<void()> Compile();
+
+  void Execute(vk::CommandBuffer const & commandBuffer);
+
+  vk::Image const & ImageHandle(RGResourceId resource) const
+    { return resources[resource].image; }
+  vk::ImageView const & View(RGResourceId resource) const
+    { return resources[resource].view; }
+  RGImageDesc const & Desc(RGResourceId resource) const
+    { return resources[resource].desc; }
+  // the render pass a raster pass is recorded in, for pipeline creation
+  vk::RenderPass RenderPass(std::string const & passName) const;
+  // only valid inside a raster pass' execute, ei. for the inheritance of the
+  // secondaries it executes
+  vk::RenderPassBeginInfo const & ActiveRenderPass() const
+    { return activeRenderPass; }
+
+  // -- what Compile derived, ei. to check it
+  bool IsCulled(std::string const & passName) const;
+  // recorded before the pass, empty for culled or unknown passes
+  RGBarrierBatch const & Barriers(std::string const & passName) const;
+  // handing imports back in their final layout, after every pass
+  RGBarrierBatch const & FinalBarriers() const { return finalBarriers; }
+  // of a transient into the memory the transients alias in
+  vk::DeviceSize TransientOffset(RGResourceId resource) const
+    { return resources[resource].offset; }
+  vk::DeviceSize TransientBytes() const { return transientBytes; }
+  vk::DeviceSize AliasedBytes() const { return transientMemory.size; }
+
+  void LogStats() const;
+};
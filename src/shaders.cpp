@@ -0,0 +1,31 @@
+#include "shaders.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+ShaderBlob const * FindShader(std::string_view name) {
+  auto const registry = ShaderRegistry();
+  auto const blob =
+    std::find_if(registry.begin(), registry.end(), [&](auto const & blob) {
+      return blob.name == name;
+    });
+  return blob == registry.end() ? nullptr : &*blob;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ShaderStageDesc LoadShader(std::string_view name) {
+  ShaderStageDesc desc;
+
+  auto const * blob = FindShader(name);
+  if (!blob) {
+    spdlog::error("No embedded shader '{}'", name);
+    return desc;
+  }
+
+  desc.stage = blob->stage;
+  desc.spirv.assign(blob->spirv.begin(), blob->spirv.end());
+  desc.specialization.assign(
+    blob->specialization.begin(), blob->specialization.end()
+  );
+  return desc;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "vulkan.hpp"
+
+#include <span>
+#include <string_view>
+
+////////////////////////////////////////////////////////////////////////////////
+// SPIR-V compiled & embedded at build time by cmake/Shaders.cmake
+struct ShaderBlob {
+  std::string_view name; // "bands.frag", or "bands.frag:bands8" for permutations
+  vk::ShaderStageFlagBits stage;
+  std::span<uint32_t const> spirv;
+  // only set when the build could not bake the permutation into the module
+  std::span<SpecializationConstant const> specialization;
+};
+
+// every embedded shader, defined by the generated registry
+std::span<ShaderBlob const> ShaderRegistry();
+
+// null if no shader or permutation has that name
+ShaderBlob const * FindShader(std::string_view name);
+
+// copies the blob into a stage ready for PipelineManager::Request; logs and
+// returns an empty stage if the name is unknown
+ShaderStageDesc LoadShader(std::string_view name);
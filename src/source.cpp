@@ -1,169 +1,652 @@
 #include "util.hpp"
+#include "frame.hpp"
 #include "glfw.hpp"
 #include "graphicscontext.hpp"
+#include "input.hpp"
+#include "jobs.hpp"
+#include "latency.hpp"
+#include "memorytelemetry.hpp"
+#include "offscreen.hpp"
+#include "pacing.hpp"
+#include "profiler.hpp"
+#include "recorder.hpp"
+#include "rendergraph.hpp"
 #include "swapchain.hpp"
+#include "video.hpp"
 
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <thread>
 
+namespace {
+
 ////////////////////////////////////////////////////////////////////////////////
-int main() {
-  auto context = GraphicsContext::Construct();
-  LogDiagnosticInfo(context);
+struct Options {
+  bool headless = false;
+  uint64_t frameLimit = 0; // 0 runs until the window closes
+  // deeper rings trade input latency for CPU/GPU overlap
+  uint32_t framesInFlight = 2;
+  // job system workers besides the main thread
+  uint32_t workers = JobSystem::DefaultWorkerCount();
+  // Chrome trace of CPU & GPU zones written on exit, none if empty
+  std::string profilePath;
+  // seconds between frame pacing summaries, 0 only logs one on exit
+  double pacingSummary = 0.0;
+  PresentPolicy presentPolicy = PresentPolicy::Mailbox;
+  double fpsLimit = 0.0; // 0 is unlimited, or the refresh rate when paced
 
-  auto swapchain = Swapchain(context, context.surface);
-  swapchain.Construct(glm::vec2(640, 480));
-
-  vk::UniqueRenderPass renderPass;
-  { // -- create renderpass
-    std::vector<vk::AttachmentDescription> attachments;
-    std::vector<vk::AttachmentReference> attachmentReferences;
-    std::vector<vk::SubpassDescription> subpasses;
-    std::vector<vk::SubpassDependency> subpassDependencies;
-
-    { // -- color attachment
-      vk::AttachmentDescription desc;
-      desc.format = swapchain.colorFormat;
-      desc.loadOp = vk::AttachmentLoadOp::eClear;
-      desc.storeOp = vk::AttachmentStoreOp::eStore;
-      desc.initialLayout = vk::ImageLayout::eUndefined;
-      desc.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-      attachments.push_back(desc);
+  // -- offline rendering to video, headless & as fast as it can be written
+  std::string videoPath; // none if empty, "-" for stdout
+  VideoFormat videoFormat = VideoFormat::Y4m;
+  double videoFps = 60.0; // the fixed timestep
+  glm::uvec2 videoSize { 1280, 720 };
+  uint32_t readbackDepth = 4;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+Options ParseOptions(int argc, char ** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++ i) {
+    std::string_view const arg = argv[i];
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--frames" && i+1 < argc) {
+      options.frameLimit = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--frames-in-flight" && i+1 < argc) {
+      auto const value = std::strtoul(argv[++i], nullptr, 10);
+      if (value > 0)
+        { options.framesInFlight = static_cast<uint32_t>(value); }
+      else
+        { spdlog::error("Frames in flight must be positive, using 2"); }
+    } else if (arg == "--fps-limit" && i+1 < argc) {
+      options.fpsLimit = std::strtod(argv[++i], nullptr);
+    } else if (arg == "--pacing-summary" && i+1 < argc) {
+      options.pacingSummary = std::strtod(argv[++i], nullptr);
+    } else if (arg == "--present-policy" && i+1 < argc) {
+      auto const name = std::string_view(argv[++i]);
+      if (auto const policy = PresentPolicyFromString(name))
+        { options.presentPolicy = *policy; }
+      else
+        { spdlog::error("Unknown present policy '{}'", name); }
+    } else if (arg == "--profile" && i+1 < argc) {
+      options.profilePath = argv[++i];
+    } else if (arg == "--workers" && i+1 < argc) {
+      options.workers =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--video" && i+1 < argc) {
+      options.videoPath = argv[++i];
+      // ei. "frame_####.ppm" for an image sequence
+      if (options.videoPath.ends_with(".ppm"))
+        { options.videoFormat = VideoFormat::Ppm; }
+    } else if (arg == "--video-format" && i+1 < argc) {
+      auto const name = std::string_view(argv[++i]);
+      if (auto const format = VideoFormatFromString(name))
+        { options.videoFormat = *format; }
+      else
+        { spdlog::error("Unknown video format '{}'", name); }
+    } else if (arg == "--video-fps" && i+1 < argc) {
+      options.videoFps = std::strtod(argv[++i], nullptr);
+    } else if (arg == "--video-size" && i+1 < argc) {
+      // WxH
+      char * end = nullptr;
+      auto const width = std::strtoul(argv[++i], &end, 10);
+      auto const height = *end == 'x' ? std::strtoul(end + 1, nullptr, 10) : 0;
+      if (width > 0 && height > 0)
+        { options.videoSize = glm::uvec2(width, height); }
+      else
+        { spdlog::error("Video size '{}' isn't WxH", argv[i]); }
+    } else if (arg == "--readback-depth" && i+1 < argc) {
+      options.readbackDepth =
+        static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else {
+      spdlog::error("Unknown argument '{}'", arg);
     }
+  }
 
-    { // -- color attachment ref
-      vk::AttachmentReference ref;
-      ref.attachment = 0;
-      ref.layout = vk::ImageLayout::eColorAttachmentOptimal;
-      attachmentReferences.push_back(ref);
+  // there's nothing to present video frames to
+  if (!options.videoPath.empty()) {
+    options.headless = true;
+    if (options.videoFps <= 0.0) {
+      spdlog::error("Video fps must be positive, using 60");
+      options.videoFps = 60.0;
     }
+  }
+
+  // nothing would ever stop a headless run otherwise
+  if (options.headless && options.frameLimit == 0) {
+    spdlog::info("No '--frames' given for headless run, rendering 1000");
+    options.frameLimit = 1000;
+  }
 
-    { // -- subpass
-      vk::SubpassDescription desc;
-      desc.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-      desc.colorAttachmentCount = 1;
-      desc.pColorAttachments = attachmentReferences.data();
-      subpasses.push_back(desc);
+  // a deeper ring only queues frames up behind the one being scanned out
+  if (options.presentPolicy == PresentPolicy::LowLatencyFifo
+   && options.framesInFlight > 1
+  ) {
+    spdlog::info(
+      "Present policy 'fifo' has the least latency with "
+      "'--frames-in-flight 1'"
+    );
+  }
+
+  return options;
+}
+
+// cycled through per band & per frame
+std::array<vk::ClearColorValue, 8> const clearColors {
+  vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 1.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{0.0f, 1.0f, 0.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{0.0f, 1.0f, 1.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{1.0f, 0.0f, 0.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{1.0f, 0.0f, 1.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{1.0f, 1.0f, 0.0f, 0.0f})
+, vk::ClearColorValue(std::array<float, 4>{1.0f, 1.0f, 1.0f, 0.0f})
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// the image is split into horizontal bands, each cleared from its own
+// secondary command buffer, standing in for per-object draw recording;
+// colorIdx (the image index, or the frame number for video) is read when the
+// pass records
+void AddBandsPass(
+  RenderGraph & graph
+, RGResourceId target
+, CommandRecorder & recorder
+, uint32_t const & colorIdx
+) {
+  RGPassDesc pass;
+  pass.name = "bands";
+  // the bands cover every texel, so the previous contents never matter
+  pass.writes = {
+    { target, RGAccessType::ColorAttachment, vk::AttachmentLoadOp::eDontCare }
+  };
+  pass.contents = vk::SubpassContents::eSecondaryCommandBuffers;
+  pass.execute = [&recorder, &colorIdx](
+    vk::CommandBuffer const & commandBuffer
+  , RenderGraph const & graph
+  ) {
+    auto const & renderPassBI = graph.ActiveRenderPass();
+    auto const extent = renderPassBI.renderArea.extent;
+    auto const firstColor = colorIdx;
+
+    constexpr uint32_t bandCount = 16;
+    std::vector<RecordTask> tasks;
+    tasks.reserve(bandCount);
+    for (uint32_t band = 0; band < bandCount; ++ band) {
+      tasks.emplace_back([=](vk::CommandBuffer const & secondary) {
+        vk::ClearAttachment clear;
+        clear.aspectMask = vk::ImageAspectFlagBits::eColor;
+        clear.colorAttachment = 0;
+        clear.clearValue.color =
+          clearColors[(firstColor + band) % clearColors.size()];
+
+        uint32_t const y0 = extent.height * band / bandCount;
+        uint32_t const y1 = extent.height * (band + 1) / bandCount;
+        if (y1 == y0) { return; }
+
+        vk::ClearRect rect;
+        rect.rect.offset = vk::Offset2D { 0, static_cast<int32_t>(y0) };
+        rect.rect.extent = vk::Extent2D { extent.width, y1 - y0 };
+        rect.baseArrayLayer = 0;
+        rect.layerCount = 1;
+        secondary.clearAttachments(clear, rect);
+      });
     }
 
-    { // -- subpass dependency
-      vk::SubpassDependency dep;
+    recorder.RecordSecondaries(commandBuffer, renderPassBI, tasks);
+  };
+  graph.AddPass(std::move(pass));
+}
 
-      dep.srcSubpass = 0;
-      dep.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-      dep.srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+////////////////////////////////////////////////////////////////////////////////
+void RecordFrame(
+  GpuProfiler & profiler
+, uint64_t frameIndex
+, vk::CommandBuffer const & commandBuffer
+, RenderGraph & graph
+) {
+  vk::CommandBufferBeginInfo commandBufferBI;
+  commandBufferBI.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  commandBuffer.begin(commandBufferBI);
+  profiler.BeginFrame(commandBuffer, frameIndex);
+  {
+    ScopedGpuZone zone(profiler, commandBuffer, "bands");
+    graph.Execute(commandBuffer);
+  }
+  commandBuffer.end();
+}
 
-      dep.dstSubpass = VK_SUBPASS_EXTERNAL;
-      dep.dstAccessMask =
-        vk::AccessFlagBits::eColorAttachmentRead
-      | vk::AccessFlagBits::eColorAttachmentWrite;
-      dep.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+////////////////////////////////////////////////////////////////////////////////
+void StartPacing(FramePacing & pacing, Options const & options) {
+  pacing.SetSummaryInterval(
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(options.pacingSummary)
+    )
+  );
+}
 
-      subpassDependencies.push_back(dep);
+////////////////////////////////////////////////////////////////////////////////
+void FinishProfile(GpuProfiler & profiler, Options const & options) {
+  profiler.Flush();
+  profiler.LogLastResults();
+  if (!options.profilePath.empty())
+    { profiler.WriteChromeTrace(options.profilePath); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the render thread's side of RunWindowed, it never touches GLFW & only sees
+// the window through the snapshots arriving on inputChannel
+void RenderWindowed(
+  GraphicsContext & context
+, JobSystem & jobs
+, Options const & options
+, InputChannel & inputChannel
+, InputSnapshot input
+, double refreshRate
+) {
+  auto swapchain = Swapchain(context, context.surface);
+  ApplyPresentPolicy(swapchain, options.presentPolicy);
+  swapchain.Construct(input.framebufferSize);
+  spdlog::info(
+    "Presenting with '{}' over {} images"
+  , vk::to_string(swapchain.presentMode), swapchain.ImageLength()
+  );
+
+  auto frames = FrameRing::Construct(context, options.framesInFlight);
+  auto recorder = CommandRecorder(context, jobs, options.framesInFlight);
+  auto profiler = GpuProfiler(context, options.framesInFlight);
+  auto memory = MemoryTelemetry(context);
+  profiler.SetCapture(!options.profilePath.empty());
+  FramePacing pacing;
+  StartPacing(pacing, options);
+
+  // the acquired image is bound to the import every frame
+  RenderGraph graph(context);
+  auto const target =
+    graph.ImportImage(
+      "swapchain"
+    , RGImageDesc { swapchain.colorFormat, swapchain.swapchainExtent }
+    , vk::ImageLayout::eUndefined
+    , vk::ImageLayout::ePresentSrcKHR
+    );
+  uint32_t colorIdx = 0;
+  AddBandsPass(graph, target, recorder, colorIdx);
+  DeferDestroy(frames, graph.Compile());
+
+  auto pacer =
+    PresentPacer(
+      swapchain, options.presentPolicy, refreshRate, options.fpsLimit
+    );
+
+  // rebuilds the swapchain without waiting on the device, the old one & the
+  // graph's framebuffers over it are destroyed once the frames referencing
+  // them retire; false if the window closed while minimized, with nothing
+  // rebuilt to render to
+  auto const recreateSwapchain = [&]() -> bool {
+    // minimized, there's nothing to render to until the window comes back
+    while (
+      (input.framebufferSize.x == 0 || input.framebufferSize.y == 0)
+   && !input.closeRequested
+    ) {
+      inputChannel.WaitForInput();
+      inputChannel.Drain(input);
     }
+    if (input.closeRequested) { return false; }
+
+    DeferDestroy(frames, graph.InvalidateImported(target));
+    DeferDestroy(frames, swapchain.Construct(input.framebufferSize));
+    graph.ResizeImported(target, swapchain.swapchainExtent);
+    return true;
+  };
+
+  for (
+    uint64_t frameIdx = 0;
+    !input.closeRequested
+ && (options.frameLimit == 0 || frameIdx < options.frameLimit);
+  ) {
+    TimeStage(pacing, FrameStage::Pace, [&]() { pacer.WaitForFrame(); });
 
-    { // -- renderpass create info
-      vk::RenderPassCreateInfo info;
-      info.attachmentCount = static_cast<uint32_t>(attachments.size());
-      info.pAttachments = attachments.data();
-      info.subpassCount = static_cast<uint32_t>(subpasses.size());
-      info.pSubpasses = subpasses.data();
-      info.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-      info.pDependencies = subpassDependencies.data();
-      renderPass = vk::UniqueRenderPass {
-        context.device->createRenderPass(info).value
-      };
+    // everything the pump saw since the last frame, read as late as possible
+    inputChannel.Drain(input);
+    if (input.closeRequested) { break; }
+    if (input.resized && !recreateSwapchain()) { break; }
+
+    double const waitBeginUs = profiler.NowUs();
+    auto & frame =
+      TimeStage(pacing, FrameStage::FenceWait, [&]() -> FrameContext & {
+        return BeginFrame(context, frames);
+      });
+    profiler.AddCpuZone("wait frame", waitBeginUs, profiler.NowUs());
+    recorder.BeginFrame(frame.frameIndex);
+
+    auto const acquireResult =
+      TimeStage(pacing, FrameStage::Acquire, [&]() {
+        return swapchain.AcquireNextImage(*frame.acquireComplete);
+      });
+
+    if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+      // nothing was acquired, so retry the same frame on the new swapchain
+      if (!recreateSwapchain()) { break; }
+      continue;
     }
-  }
 
-  std::vector<vk::Framebuffer> framebuffers;
-  { // create framebuffers
-    std::array<vk::ImageView, 1> imageViews;
-    vk::FramebufferCreateInfo framebufferCI;
-    framebufferCI.renderPass = *renderPass;
-    framebufferCI.attachmentCount = static_cast<uint32_t>(imageViews.size());
-    framebufferCI.pAttachments = imageViews.data();
-    framebufferCI.width = swapchain.swapchainExtent.width;
-    framebufferCI.height = swapchain.swapchainExtent.height;
-    framebufferCI.layers = 1;
-
-    framebuffers = swapchain.CreateFramebuffers(framebufferCI);
-  }
+    uint32_t const currentBuffer = swapchain.currentImage;
+    graph.SetImported(
+      target
+    , swapchain.ImageHandle(currentBuffer)
+    , swapchain.ImageView(currentBuffer)
+    );
+    colorIdx = currentBuffer;
 
-  std::vector<vk::CommandBuffer> commandBuffers;
-  { // allocate command buffres
-    vk::CommandBufferAllocateInfo commandBufferAI;
-    commandBufferAI.commandPool = *context.commandPool;
-    commandBufferAI.commandBufferCount = swapchain.ImageLength();
-    commandBufferAI.level = vk::CommandBufferLevel::ePrimary;
-    commandBuffers =
-      CheckReturn(
-        context.device->allocateCommandBuffers(commandBufferAI),
-        "Allocating command buffers"
+    {
+      ScopedCpuZone zone(profiler, "record");
+      ScopedFrameStage stage(pacing, FrameStage::Record);
+      RecordFrame(profiler, frame.frameIndex, frame.commandBuffer, graph);
+    }
+
+    {
+      ScopedFrameStage stage(pacing, FrameStage::Submit);
+      SubmitFrame(
+        context
+      , frames
+      , frame
+      , {
+          SemaphoreSubmit {
+            *frame.acquireComplete, 0
+          , vk::PipelineStageFlagBits::eColorAttachmentOutput
+          }
+        }
+      , { SemaphoreSubmit { swapchain.RenderComplete() } }
       );
-  }
+    }
 
-  { // assign commands to command buffers
-    static const std::vector<vk::ClearColorValue> clearColors {
-      vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 1.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{0.0f, 1.0f, 0.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{0.0f, 1.0f, 1.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{1.0f, 0.0f, 0.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{1.0f, 0.0f, 1.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{1.0f, 1.0f, 0.0f, 0.0f})
-    , vk::ClearColorValue(std::array<float, 4>{1.0f, 1.0f, 1.0f, 0.0f})
-    };
+    auto const presentResult =
+      TimeStage(pacing, FrameStage::Present, [&]() {
+        return swapchain.QueuePresent(swapchain.RenderComplete());
+      });
+    pacer.FramePresented();
 
-    vk::ClearValue clearValue;
-    auto renderPassBI = vk::RenderPassBeginInfo {
-      *renderPass,
-      {}, // no framebuffer explicitly set
-      { {}, swapchain.swapchainExtent },
-      1, // clear values
-      &clearValue
-    };
+    EndFrame(frames);
+    pacing.EndFrame();
+    memory.Poll();
+    ++ frameIdx;
 
-    for (size_t i = 0; i < swapchain.ImageLength(); ++ i) {
-      auto const & commandBuffer = commandBuffers[i];
-      clearValue.color = clearColors[i % clearColors.size()];
-      renderPassBI.framebuffer = framebuffers[i];
-      commandBuffer.reset(vk::CommandBufferResetFlagBits::eReleaseResources);
-      commandBuffer.begin(vk::CommandBufferBeginInfo{});
-      commandBuffer.beginRenderPass(renderPassBI, vk::SubpassContents::eInline);
-      commandBuffer.endRenderPass();
-      commandBuffer.end();
+    if (acquireResult == vk::Result::eSuboptimalKHR
+     || presentResult == vk::Result::eSuboptimalKHR
+     || presentResult == vk::Result::eErrorOutOfDateKHR
+    ) {
+      if (!recreateSwapchain()) { break; }
     }
   }
 
-  vk::UniqueSemaphore acquireComplete;
-  vk::UniqueSemaphore renderComplete;
-  {
-    acquireComplete = vk::UniqueSemaphore(context.device->createSemaphore({}).value);
-    renderComplete  = vk::UniqueSemaphore(context.device->createSemaphore({}).value);
+  context.graphicsQueue.waitIdle();
+  FinishProfile(profiler, options);
+  pacing.LogSummary();
+  memory.Log();
+  FlushDeferred(frames);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the main thread only pumps GLFW events & forwards them to a dedicated render
+// thread as input snapshots, so a blocking acquire or fence wait never delays
+// input & dragging the window never stalls rendering
+void RunWindowed(
+  GraphicsContext & context
+, JobSystem & jobs
+, Options const & options
+) {
+  auto & window = *context.glfwWindow;
+
+  InputChannel inputChannel;
+  std::atomic<bool> rendering { true };
+  auto const initialInput = TakeInputSnapshot(window);
+  double const refreshRate = RefreshRate(window);
+
+  // jobs the render thread hands the main thread mustn't wait for an event
+  jobs.SetMainThreadWake(WakeEventPump);
+
+  std::thread renderThread([&]() {
+    RenderWindowed(
+      context, jobs, options, inputChannel, initialInput, refreshRate
+    );
+    rendering = false;
+    WakeEventPump();
+  });
+
+  while (rendering.load()) {
+    // a snapshot held back by a full queue is retried without an event
+    if (inputChannel.HasPending())
+      { WaitEventsTimeout(window, 0.001); }
+    else
+      { WaitEvents(window); }
+    inputChannel.Publish(TakeInputSnapshot(window));
+    jobs.PumpMainThread(); // ei. GLFW calls made from jobs
   }
 
-  while (!ShouldWindowClose(*context.glfwWindow))
-  {
-    PollEvents(*context.glfwWindow);
+  renderThread.join();
+  jobs.SetMainThreadWake(nullptr);
+}
 
-    uint32_t currentBuffer = swapchain.AcquireNextImage(*acquireComplete);
+////////////////////////////////////////////////////////////////////////////////
+void RunHeadless(
+  GraphicsContext & context
+, JobSystem & jobs
+, Options const & options
+) {
+  // one image per frame in flight, so an image is never rendered to while
+  // the previous frame using it may still be executing
+  auto offscreen = Offscreen(context, options.framesInFlight);
+  offscreen.Construct(glm::uvec2(640, 480));
 
-    vk::Fence submitFence = swapchain.GetSubmitFence();
+  auto frames = FrameRing::Construct(context, options.framesInFlight);
+  auto recorder = CommandRecorder(context, jobs, options.framesInFlight);
+  auto profiler = GpuProfiler(context, options.framesInFlight);
+  auto memory = MemoryTelemetry(context);
+  profiler.SetCapture(!options.profilePath.empty());
+  FramePacing pacing;
+  StartPacing(pacing, options);
 
-    Submit(
-      context
-    , commandBuffers[currentBuffer]
-    , *acquireComplete
-    , vk::PipelineStageFlagBits::eColorAttachmentOutput
-    , *renderComplete
-    , submitFence
+  // left in transfer-src so frames could be read back after the graph
+  RenderGraph graph(context);
+  auto const target =
+    graph.ImportImage(
+      "offscreen"
+    , RGImageDesc { offscreen.colorFormat, offscreen.imageExtent }
+    , vk::ImageLayout::eUndefined
+    , vk::ImageLayout::eTransferSrcOptimal
     );
+  uint32_t colorIdx = 0;
+  AddBandsPass(graph, target, recorder, colorIdx);
+  DeferDestroy(frames, graph.Compile());
+
+  // nothing to present, so only the rate limit applies
+  FrameLimiter limiter(options.fpsLimit);
+
+  for (uint64_t frameIdx = 0; frameIdx < options.frameLimit; ++ frameIdx) {
+    TimeStage(pacing, FrameStage::Pace, [&]() { limiter.Wait(); });
+    double const waitBeginUs = profiler.NowUs();
+    auto & frame =
+      TimeStage(pacing, FrameStage::FenceWait, [&]() -> FrameContext & {
+        return BeginFrame(context, frames);
+      });
+    profiler.AddCpuZone("wait frame", waitBeginUs, profiler.NowUs());
+    recorder.BeginFrame(frame.frameIndex);
 
-    swapchain.QueuePresent(*renderComplete);
+    uint32_t currentBuffer = offscreen.AcquireNextImage();
+    graph.SetImported(
+      target
+    , offscreen.ImageHandle(currentBuffer)
+    , offscreen.ImageView(currentBuffer)
+    );
+    colorIdx = currentBuffer;
+
+    {
+      ScopedCpuZone zone(profiler, "record");
+      ScopedFrameStage stage(pacing, FrameStage::Record);
+      RecordFrame(profiler, frame.frameIndex, frame.commandBuffer, graph);
+    }
+
+    {
+      ScopedFrameStage stage(pacing, FrameStage::Submit);
+      SubmitFrame(context, frames, frame);
+    }
+
+    EndFrame(frames);
+    pacing.EndFrame();
+    memory.Poll();
   }
 
   context.graphicsQueue.waitIdle();
+  FinishProfile(profiler, options);
+  pacing.LogSummary();
+  memory.Log();
+  FlushDeferred(frames);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// offline rendering on a fixed timestep: frames are a function of their
+// number alone & go out as fast as the GPU renders & the writer keeps up,
+// never paced to a display
+void RunVideo(
+  GraphicsContext & context
+, JobSystem & jobs
+, Options const & options
+) {
+  auto offscreen = Offscreen(context, options.framesInFlight);
+  offscreen.Construct(options.videoSize);
+
+  auto frames = FrameRing::Construct(context, options.framesInFlight);
+  auto recorder = CommandRecorder(context, jobs, options.framesInFlight);
+  auto profiler = GpuProfiler(context, options.framesInFlight);
+  auto memory = MemoryTelemetry(context);
+  profiler.SetCapture(!options.profilePath.empty());
+  FramePacing pacing;
+  StartPacing(pacing, options);
+
+  VideoCaptureCreateInfo captureCI;
+  captureCI.path = options.videoPath;
+  captureCI.format = options.videoFormat;
+  captureCI.extent = offscreen.imageExtent;
+  captureCI.colorFormat = offscreen.colorFormat;
+  captureCI.fps = options.videoFps;
+  captureCI.depth = options.readbackDepth;
+  auto capture = VideoCapture(context, captureCI);
+  if (!capture.IsOpen()) { return; }
+
+  RenderGraph graph(context);
+  auto const target =
+    graph.ImportImage(
+      "offscreen"
+    , RGImageDesc { offscreen.colorFormat, offscreen.imageExtent }
+    , vk::ImageLayout::eUndefined
+    , vk::ImageLayout::eTransferSrcOptimal
+    );
+  uint32_t colorIdx = 0;
+  uint64_t frameIdx = 0;
+  AddBandsPass(graph, target, recorder, colorIdx);
+  { // -- readback, copies the finished frame out to the writer
+    RGPassDesc readback;
+    readback.name = "readback";
+    readback.reads = { { target, RGAccessType::TransferSrc } };
+    readback.execute = [&capture, &frameIdx, target](
+      vk::CommandBuffer const & commandBuffer
+    , RenderGraph const & graph
+    ) {
+      capture.RecordReadback(
+        commandBuffer, graph.ImageHandle(target), frameIdx
+      );
+    };
+    // the frame leaves the graph through the capture, not through an output
+    readback.sideEffects = true;
+    graph.AddPass(std::move(readback));
+  }
+  DeferDestroy(frames, graph.Compile());
+
+  auto const start = std::chrono::steady_clock::now();
+  for (frameIdx = 0; frameIdx < options.frameLimit; ++ frameIdx) {
+    double const waitBeginUs = profiler.NowUs();
+    auto & frame =
+      TimeStage(pacing, FrameStage::FenceWait, [&]() -> FrameContext & {
+        return BeginFrame(context, frames);
+      });
+    profiler.AddCpuZone("wait frame", waitBeginUs, profiler.NowUs());
+    recorder.BeginFrame(frame.frameIndex);
+
+    uint32_t currentBuffer = offscreen.AcquireNextImage();
+    graph.SetImported(
+      target
+    , offscreen.ImageHandle(currentBuffer)
+    , offscreen.ImageView(currentBuffer)
+    );
+    colorIdx = static_cast<uint32_t>(frameIdx);
+
+    {
+      ScopedCpuZone zone(profiler, "record");
+      ScopedFrameStage stage(pacing, FrameStage::Record);
+      RecordFrame(profiler, frame.frameIndex, frame.commandBuffer, graph);
+    }
+
+    {
+      ScopedFrameStage stage(pacing, FrameStage::Submit);
+      capture.Submitted(SubmitFrame(context, frames, frame));
+    }
+
+    EndFrame(frames);
+    pacing.EndFrame();
+    memory.Poll();
+  }
+
+  capture.Finish();
+  double const seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+  spdlog::info(
+    "Wrote {} frames ({:.2f}s of video) in {:.2f}s, {:.1f} fps"
+  , capture.FramesWritten(), capture.FramesWritten() / options.videoFps
+  , seconds, seconds > 0.0 ? capture.FramesWritten() / seconds : 0.0
+  );
+
+  context.graphicsQueue.waitIdle();
+  FinishProfile(profiler, options);
+  pacing.LogSummary();
+  memory.Log();
+  FlushDeferred(frames);
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char ** argv) {
+  // stdout may carry the video stream, ei. '--video -'
+  spdlog::set_default_logger(spdlog::stderr_color_mt("dtq"));
+
+  auto const options = ParseOptions(argc, argv);
+
+  // constructed here so this thread, which owns the window, is its main one
+  JobSystem jobs(options.workers);
+
+  GraphicsContextCreateInfo contextCI;
+  contextCI.headless = options.headless;
+
+  auto context = GraphicsContext::Construct(contextCI);
+  if (!context.device) { return 1; }
+  LogDiagnosticInfo(context);
+
+  if (!options.videoPath.empty())
+    { RunVideo(context, jobs, options); }
+  else if (context.headless)
+    { RunHeadless(context, jobs, options); }
+  else
+    { RunWindowed(context, jobs, options); }
+
   context.device->waitIdle();
 
   return 0;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// bounded lock-free queue between exactly one producer & one consumer thread;
+// each side only writes its own index, kept on separate cache lines, so a push
+// & a pop never contend
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0);
+
+private:
+  std::array<T, Capacity> slots {};
+  alignas(64) std::atomic<size_t> head { 0 }; // next to pop, consumer owned
+  alignas(64) std::atomic<size_t> tail { 0 }; // next to push, producer owned
+
+public:
+  // -- producer only; fails when full
+  bool TryPush(T const & value) {
+    size_t const t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity) { return false; }
+    slots[t & (Capacity - 1)] = value;
+    tail.store(t + 1, std::memory_order_release);
+    tail.notify_one();
+    return true;
+  }
+
+  // -- consumer only; fails when empty
+  bool TryPop(T & value) {
+    size_t const h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) { return false; }
+    value = slots[h & (Capacity - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // -- consumer only; blocks until something is queued
+  void WaitForItem() const {
+    tail.wait(head.load(std::memory_order_relaxed), std::memory_order_acquire);
+  }
+};
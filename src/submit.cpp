@@ -0,0 +1,234 @@
+#include "submit.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// storage a VkSubmitInfo points into, kept until the submit returns
+struct SubmitBatch {
+  std::vector<vk::CommandBuffer> commandBuffers;
+  std::vector<vk::Semaphore> waitSemaphores, signalSemaphores;
+  std::vector<uint64_t> waitValues, signalValues;
+  std::vector<vk::PipelineStageFlags> waitStages;
+  vk::TimelineSemaphoreSubmitInfo timelineInfo;
+  // index of the queue's timeline in signalSemaphores, once there is one
+  std::optional<size_t> timelineSlot;
+  bool closed = false; // signals binary semaphores, nothing may follow
+};
+
+// peers are only flushed from the outermost Flush of a thread, so two queues
+// waiting on each other can't recurse; the inner one relies on timelines
+// allowing a wait to be submitted before its signal
+thread_local uint32_t flushDepth = 0;
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+SubmitQueue::SubmitQueue(
+  GraphicsContext const & context
+, vk::Queue const & queue_
+, uint32_t queueFamilyIdx_
+)
+: device{*context.device}, queue{queue_}, queueFamilyIdx{queueFamilyIdx_}
+{
+  this->timeline = CreateTimelineSemaphore(context);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+SubmitQueue::~SubmitQueue() {
+  this->Wait(this->EnqueuedValue());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitQueue::Enqueue(
+  std::vector<vk::CommandBuffer> const & commandBuffers
+, std::vector<SemaphoreSubmit> const & waits
+, std::vector<SemaphoreSubmit> const & signals
+) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto & entry = this->pending.emplace_back();
+  entry.commandBuffers = commandBuffers;
+  entry.waits = waits;
+  entry.signals = signals;
+  entry.value = ++ this->enqueuedValue;
+  return entry.value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitQueue::Flush(vk::Fence const & fence) {
+  ++ flushDepth;
+
+  if (flushDepth == 1 && !this->peers.empty()) {
+    std::vector<std::pair<SubmitQueue*, uint64_t>> dependencies;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      for (auto const & entry : this->pending)
+      for (auto const & wait : entry.waits)
+      for (auto * peer : this->peers) {
+        if (wait.semaphore == peer->Timeline())
+          { dependencies.emplace_back(peer, wait.value); }
+      }
+    }
+    for (auto const & [peer, value] : dependencies) {
+      if (peer->SubmittedValue() < value) { peer->Flush(); }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (this->pending.empty() && !fence) {
+    -- flushDepth;
+    return this->submittedValue;
+  }
+
+  // a new batch starts at every entry with waits, so work ahead of it never
+  // waits on what it waits on, and after binary signals, which only fire at
+  // the end of a batch
+  std::vector<SubmitBatch> batches;
+  batches.reserve(this->pending.size());
+  for (auto const & entry : this->pending) {
+    if (batches.empty() || batches.back().closed || !entry.waits.empty())
+      { batches.emplace_back(); }
+    auto & batch = batches.back();
+
+    batch.commandBuffers.insert(
+      batch.commandBuffers.end()
+    , entry.commandBuffers.begin(), entry.commandBuffers.end()
+    );
+    for (auto const & wait : entry.waits) {
+      batch.waitSemaphores.emplace_back(wait.semaphore);
+      batch.waitValues.emplace_back(wait.value);
+      batch.waitStages.emplace_back(wait.stage);
+    }
+    for (auto const & signal : entry.signals) {
+      batch.signalSemaphores.emplace_back(signal.semaphore);
+      batch.signalValues.emplace_back(signal.value);
+    }
+    batch.closed = !entry.signals.empty();
+
+    // signalled once per batch, only the final entry's value survives
+    if (batch.timelineSlot) {
+      batch.signalValues[*batch.timelineSlot] = entry.value;
+    } else {
+      batch.timelineSlot = batch.signalSemaphores.size();
+      batch.signalSemaphores.emplace_back(*this->timeline);
+      batch.signalValues.emplace_back(entry.value);
+    }
+  }
+
+  // a fence with nothing pending still needs a submit to signal it
+  if (batches.empty()) { batches.emplace_back(); }
+
+  std::vector<vk::SubmitInfo> submitInfos;
+  submitInfos.reserve(batches.size());
+  for (auto & batch : batches) {
+    // values of binary semaphores in the list are ignored
+    batch.timelineInfo.waitSemaphoreValueCount =
+      static_cast<uint32_t>(batch.waitValues.size());
+    batch.timelineInfo.pWaitSemaphoreValues = batch.waitValues.data();
+    batch.timelineInfo.signalSemaphoreValueCount =
+      static_cast<uint32_t>(batch.signalValues.size());
+    batch.timelineInfo.pSignalSemaphoreValues = batch.signalValues.data();
+
+    auto & submitInfo = submitInfos.emplace_back();
+    submitInfo.pNext = &batch.timelineInfo;
+    submitInfo.commandBufferCount =
+      static_cast<uint32_t>(batch.commandBuffers.size());
+    submitInfo.pCommandBuffers = batch.commandBuffers.data();
+    submitInfo.waitSemaphoreCount =
+      static_cast<uint32_t>(batch.waitSemaphores.size());
+    submitInfo.pWaitSemaphores = batch.waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = batch.waitStages.data();
+    submitInfo.signalSemaphoreCount =
+      static_cast<uint32_t>(batch.signalSemaphores.size());
+    submitInfo.pSignalSemaphores = batch.signalSemaphores.data();
+  }
+
+  auto const result = this->queue.submit(submitInfos, fence);
+  ++ this->submitCount;
+  // dropped rather than retried, their owners recycle the command buffers as
+  // if they ran; the values stay unsubmitted so nothing waits on them forever
+  this->pending.clear();
+  if (result != vk::Result::eSuccess) {
+    spdlog::error("Queue submit failed: {}", vk::to_string(result));
+    -- flushDepth;
+    return this->submittedValue;
+  }
+  this->submittedValue = this->enqueuedValue;
+
+  -- flushDepth;
+  return this->submittedValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitQueue::EnqueuedValue() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->enqueuedValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitQueue::SubmittedValue() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->submittedValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitQueue::CompletedValue() {
+  auto const value =
+    CheckReturn(
+      this->device.getSemaphoreCounterValue(*this->timeline),
+      "Querying timeline semaphore"
+    );
+  this->completedValue = value;
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool SubmitQueue::IsComplete(uint64_t value) {
+  if (value <= this->completedValue) { return true; }
+  return this->CompletedValue() >= value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool SubmitQueue::Wait(uint64_t value) {
+  if (this->IsComplete(value)) { return true; }
+  if (this->SubmittedValue() < value) { this->Flush(); }
+  if (this->SubmittedValue() < value) {
+    spdlog::error("Timeline value {} never reached the queue", value);
+    return false;
+  }
+
+  vk::SemaphoreWaitInfo waitInfo;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &*this->timeline;
+  waitInfo.pValues = &value;
+
+  vk::Result result = vk::Result::eTimeout;
+  while (vk::Result::eTimeout == result) {
+    result =
+      this->device.waitSemaphores(
+        waitInfo
+      , std::numeric_limits<uint64_t>::max()
+      );
+  }
+  // ei. eErrorDeviceLost, the value may never be reached
+  if (result != vk::Result::eSuccess) {
+    spdlog::error("Timeline wait failed: {}", vk::to_string(result));
+    return false;
+  }
+  this->completedValue = std::max(this->completedValue.load(), value);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t SubmitQueue::SubmitCount() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->submitCount;
+}
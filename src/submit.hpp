@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vulkan.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+struct SemaphoreSubmit {
+  vk::Semaphore semaphore;
+  uint64_t value = 0; // ignored for binary semaphores
+  vk::PipelineStageFlags stage = vk::PipelineStageFlagBits::eAllCommands;
+};
+
+// accumulates the command buffers & semaphore dependencies headed for one
+// vk::Queue and submits them with a single vkQueueSubmit on Flush. Every
+// Enqueue is handed the next value of the queue's timeline semaphore, which
+// signals once it and everything enqueued before it completes; consecutive
+// entries without waits or binary signals in between share a VkSubmitInfo
+// and only the last of their values is signalled, which the timeline's
+// ordering makes equivalent. Completion is read without blocking & cached.
+// Thread safe; queues that alias the same vk::Queue share one SubmitQueue.
+class SubmitQueue {
+private:
+  struct Entry {
+    std::vector<vk::CommandBuffer> commandBuffers;
+    std::vector<SemaphoreSubmit> waits;
+    std::vector<SemaphoreSubmit> signals; // besides the timeline
+    uint64_t value = 0;
+  };
+
+  vk::Device device;
+  vk::Queue queue;
+  uint32_t queueFamilyIdx = 0;
+  vk::UniqueSemaphore timeline;
+
+  // the other queues of the context, flushed first when an entry waits on
+  // their timeline for a value they have yet to submit
+  std::vector<SubmitQueue*> peers;
+
+  std::mutex mutex;
+  std::vector<Entry> pending;
+  uint64_t enqueuedValue = 0;
+  uint64_t submittedValue = 0;
+  std::atomic<uint64_t> completedValue { 0 };
+  uint64_t submitCount = 0;
+
+public:
+  SubmitQueue(
+    GraphicsContext const & context
+  , vk::Queue const & queue_
+  , uint32_t queueFamilyIdx_
+  );
+  // waits for everything enqueued, flushing what is still pending
+  ~SubmitQueue();
+  SubmitQueue(SubmitQueue const &) = delete;
+  SubmitQueue(SubmitQueue &&) = delete;
+
+  void SetPeers(std::vector<SubmitQueue*> peers_) { peers = std::move(peers_); }
+
+  vk::Queue const & Queue() const { return queue; }
+  uint32_t QueueFamily() const { return queueFamilyIdx; }
+  vk::Semaphore const & Timeline() const { return *timeline; }
+
+  // returns the timeline value signalled once commandBuffers complete; the
+  // list may be empty to only wait or signal. Nothing reaches the GPU before
+  // Flush
+  uint64_t Enqueue(
+    std::vector<vk::CommandBuffer> const & commandBuffers
+  , std::vector<SemaphoreSubmit> const & waits = {}
+  , std::vector<SemaphoreSubmit> const & signals = {}
+  );
+
+  // submits everything pending in one vkQueueSubmit, after flushing peers
+  // whose values it waits on; fence, if any, signals with the last batch.
+  // Returns the last value submitted, which a failed submit doesn't advance;
+  // its entries are dropped
+  uint64_t Flush(vk::Fence const & fence = nullptr);
+
+  uint64_t EnqueuedValue();
+  uint64_t SubmittedValue();
+  // non-blocking, the last value the GPU signalled
+  uint64_t CompletedValue();
+  // non-blocking, only touches the device if the cached value is behind
+  bool IsComplete(uint64_t value);
+  // flushes first if value is still pending; false if value never reached
+  // the queue or the wait failed, ei. the device was lost
+  bool Wait(uint64_t value);
+
+  // the dependency another queue's submit needs to consume value
+  SemaphoreSubmit WaitFor(uint64_t value, vk::PipelineStageFlags stage) const {
+    return SemaphoreSubmit { *timeline, value, stage };
+  }
+
+  // vkQueueSubmit calls so far
+  uint64_t SubmitCount();
+};
@@ -4,6 +4,8 @@
 
 #include "graphicscontext.hpp"
 
+#include <algorithm>
+
 ////////////////////////////////////////////////////////////////////////////////
 Swapchain::Swapchain(
   GraphicsContext & context_,
@@ -27,10 +29,19 @@ Swapchain::Swapchain(
 
   this->graphicsDeviceQueueIdx =
     FindQueue(*this->context, vk::QueueFlagBits::eGraphics, this->surface);
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+  if (this->context->enablePresentWait) {
+    this->waitForPresent =
+      reinterpret_cast<PFN_vkWaitForPresentKHR>(
+        this->context->device->getProcAddr("vkWaitForPresentKHR")
+      );
+  }
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Swapchain::Construct(const glm::uvec2& size)
+std::function<void()> Swapchain::Construct(const glm::uvec2& size)
 {
   vk::SwapchainKHR oldSwapchain = swapchain;
 
@@ -49,22 +60,20 @@ void Swapchain::Construct(const glm::uvec2& size)
     swapchainExtent = surfaceCapabilities.currentExtent;
   }
 
-  // prefer mailbox if available
-  vk::PresentModeKHR swapchainPresentMode = vk::PresentModeKHR::eFifo;
-  for (auto const& mode : presentModes) {
-    if (mode == vk::PresentModeKHR::eMailbox) {
-      swapchainPresentMode = vk::PresentModeKHR::eMailbox;
-      break;
-    }
-    if ((swapchainPresentMode != vk::PresentModeKHR::eMailbox)
-     && (mode == vk::PresentModeKHR::eImmediate)
+  this->presentMode = vk::PresentModeKHR::eFifo;
+  for (auto const & preferred : this->preferredPresentModes) {
+    if (
+      std::find(presentModes.begin(), presentModes.end(), preferred)
+   != presentModes.end()
     ) {
-      swapchainPresentMode = vk::PresentModeKHR::eImmediate;
+      this->presentMode = preferred;
+      break;
     }
   }
 
   // determine number of images
-  uint32_t desiredImages = surfaceCapabilities.minImageCount+1;
+  uint32_t desiredImages =
+    surfaceCapabilities.minImageCount + this->extraImages;
   if ((surfaceCapabilities.maxImageCount > 0)
    && (desiredImages > surfaceCapabilities.maxImageCount)
   ) {
@@ -90,13 +99,17 @@ void Swapchain::Construct(const glm::uvec2& size)
     swapchainCI.imageColorSpace = colorSpace;
     swapchainCI.imageExtent = swapchainExtent;
     swapchainCI.imageArrayLayers = 1;
-    swapchainCI.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    this->imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    this->imageUsage |=
+      surfaceCapabilities.supportedUsageFlags
+    & vk::ImageUsageFlagBits::eTransferDst;
+    swapchainCI.imageUsage = this->imageUsage;
     swapchainCI.imageSharingMode = vk::SharingMode::eExclusive;
     swapchainCI.queueFamilyIndexCount = 0;
     swapchainCI.pQueueFamilyIndices = nullptr;
     swapchainCI.preTransform = preTransform;
     swapchainCI.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
-    swapchainCI.presentMode = swapchainPresentMode;
+    swapchainCI.presentMode = this->presentMode;
     swapchainCI.clipped = VK_TRUE;
     swapchainCI.oldSwapchain = oldSwapchain;
 
@@ -111,12 +124,23 @@ void Swapchain::Construct(const glm::uvec2& size)
   presentInfo.swapchainCount = 1;
   presentInfo.pSwapchains    = &swapchain;
   presentInfo.pImageIndices  = &currentImage;
+  this->firstPresentId = this->presentId + 1;
 
-  // destroy old swapchain
+  // old swapchain may still be in use by frames in flight, leave destroying
+  // it to the caller
+  std::function<void()> retire = []{};
   if (static_cast<bool>(oldSwapchain)) {
-    for (uint32_t i = 0; i < this->images.size(); ++ i)
-      { this->context->device->destroyImageView(this->images[i].view); }
-    this->context->device->destroySwapchainKHR(oldSwapchain);
+    retire =
+      [
+        device = this->context->device.get(), oldSwapchain
+      , oldImages = this->images
+      ] {
+        for (auto const & image : oldImages) {
+          device.destroyImageView(image.view);
+          device.destroySemaphore(image.renderComplete);
+        }
+        device.destroySwapchainKHR(oldSwapchain);
+      };
   }
 
   // TODO
@@ -143,31 +167,18 @@ void Swapchain::Construct(const glm::uvec2& size)
     colorAttachmentView.image = swapchainImages[i];
     images[i].view =
       context->device->createImageView(colorAttachmentView).value;
-  }
-}
-
-////////////////////////////////////////////////////////////////////////////////
-std::vector<vk::Framebuffer> Swapchain::CreateFramebuffers(
-  vk::FramebufferCreateInfo fbCI
-) {
-  std::vector<vk::ImageView> attachments;
-  attachments.resize(fbCI.attachmentCount);
-  for (size_t i = 0; i < fbCI.attachmentCount; ++ i)
-    { attachments[i] = fbCI.pAttachments[i]; }
-  fbCI.pAttachments = attachments.data();
-
-  std::vector<vk::Framebuffer> framebuffers;
-  framebuffers.resize(this->images.size());
-  for (uint32_t i = 0; i < static_cast<uint32_t>(this->images.size()); ++ i) {
-    attachments[0] = images[i].view;
-    framebuffers[i] = context->device->createFramebuffer(fbCI).value;
+    images[i].renderComplete =
+      CheckReturn(
+        context->device->createSemaphore({}),
+        "Creating swapchain render semaphore"
+      );
   }
 
-  return framebuffers;
+  return retire;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-uint32_t Swapchain::AcquireNextImage(
+vk::Result Swapchain::AcquireNextImage(
   vk::Semaphore const& presentCompleteSemaphore
 ) {
   auto resultValue =
@@ -179,55 +190,70 @@ uint32_t Swapchain::AcquireNextImage(
     );
 
   vk::Result result = resultValue.result;
-  if (result != vk::Result::eSuccess)
-  {
-    printf("Invalid acquire result '%s'", vk::to_string(result).c_str());
-    return 0;
+  if (result != vk::Result::eSuccess
+   && result != vk::Result::eSuboptimalKHR
+  ) {
+    if (result != vk::Result::eErrorOutOfDateKHR)
+      { spdlog::error("Invalid acquire result '{}'", vk::to_string(result)); }
+    return result;
   }
 
   this->currentImage = resultValue.value;
-  return this->currentImage;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-vk::Fence const& Swapchain::GetSubmitFence() {
-  auto& image = this->images[this->currentImage];
-  if (image.fence) {
-    vk::Result fenceResult = vk::Result::eTimeout;
-    while (vk::Result::eTimeout == fenceResult) {
-      fenceResult =
-        context->device->waitForFences(
-          image.fence
-        , VK_TRUE
-        , std::numeric_limits<uint64_t>::max()
-        );
-    }
-    context->device->resetFences(image.fence);
-  } else {
-    image.fence = context->device->createFence(vk::FenceCreateFlags()).value;
-  }
-  return image.fence;
+  return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 vk::Result Swapchain::QueuePresent(vk::Semaphore const& waitSemaphore) {
   presentInfo.waitSemaphoreCount = waitSemaphore ? 1 : 0;
   presentInfo.pWaitSemaphores = &waitSemaphore;
-  return this->context->graphicsQueue.presentKHR(presentInfo);
+  ++ this->presentId;
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+  vk::PresentIdKHR presentIdInfo;
+  presentIdInfo.swapchainCount = 1;
+  presentIdInfo.pPresentIds = &this->presentId;
+  presentInfo.pNext = this->waitForPresent ? &presentIdInfo : nullptr;
+#endif
+
+  auto const result = this->context->graphicsQueue.presentKHR(presentInfo);
+  presentInfo.pNext = nullptr;
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Swapchain::WaitForPresent(uint64_t id, uint64_t timeoutNs) {
+  if (!this->waitForPresent || id > this->presentId) { return false; }
+  if (id < this->firstPresentId) { return true; } // retired with its swapchain
+
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+  auto const result =
+    static_cast<vk::Result>(
+      this->waitForPresent(
+        static_cast<VkDevice>(*this->context->device)
+      , static_cast<VkSwapchainKHR>(this->swapchain)
+      , id
+      , timeoutNs
+      )
+    );
+  if (result != vk::Result::eSuccess
+   && result != vk::Result::eSuboptimalKHR
+   && result != vk::Result::eTimeout
+   && result != vk::Result::eErrorOutOfDateKHR
+  ) {
+    spdlog::error("Invalid present wait result '{}'", vk::to_string(result));
+  }
+  return result == vk::Result::eSuccess
+      || result == vk::Result::eSuboptimalKHR;
+#else
+  return false;
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void Swapchain::Cleanup() {
   for (auto const & image : images) {
-    if (image.fence) {
-      context->device->waitForFences(
-        image.fence
-      , VK_TRUE
-      , std::numeric_limits<uint64_t>::max()
-      );
-      context->device->destroyFence(image.fence);
-    }
     context->device->destroyImageView(image.view);
+    context->device->destroySemaphore(image.renderComplete);
     // don't destroy vk::Image as it is owned by swapchain, will be destroyed by
     // destroySwapchainKHR
   }
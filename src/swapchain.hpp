@@ -4,6 +4,7 @@
 
 #include <glm/glm.hpp>
 
+#include <functional>
 #include <limits>
 #include <utility>
 #include <vector>
@@ -15,7 +16,10 @@ struct SwapchainImage {
 
   vk::Image     image;
   vk::ImageView view;
-  vk::Fence     fence;
+  // signalled by the submit rendering into the image, waited on by its
+  // present; per image rather than per frame in flight, the presentation
+  // engine may still wait on it after later frames were submitted
+  vk::Semaphore renderComplete;
 };
 
 class Swapchain {
@@ -27,6 +31,16 @@ private:
   std::vector<SwapchainImage> images {};
   vk::PresentInfoKHR presentInfo;
 
+  // present ids count up across rebuilds, ids before firstPresentId went to
+  // a retired swapchain and can no longer be waited on
+  uint64_t presentId = 0;
+  uint64_t firstPresentId = 1;
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+  PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+#else
+  void* waitForPresent = nullptr; // always null, headers predate present wait
+#endif
+
 public:
   Swapchain(GraphicsContext & context_, vk::SurfaceKHR & surface);
   ~Swapchain() { Cleanup(); }
@@ -38,17 +52,50 @@ public:
   vk::ColorSpaceKHR colorSpace;
   uint32_t currentImage { 0 };
 
+  // the first of these the surface supports is used by the next Construct,
+  // FIFO (always supported) otherwise; presentMode holds the one in use
+  std::vector<vk::PresentModeKHR> preferredPresentModes {
+    vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate
+  };
+  vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
+
+  // images requested beyond the surface's minImageCount by the next
+  // Construct; 0 is the shallowest queue, and so the lowest latency, the
+  // surface allows
+  uint32_t extraImages = 1;
+
   // index of the gfx & presenting dev
   uint32_t graphicsDeviceQueueIdx = std::numeric_limits<uint32_t>::max();
 
+  // color attachment, plus transfer-dst where the surface allows it so passes
+  // can copy into the images; set by Construct
+  vk::ImageUsageFlags imageUsage;
+
   size_t ImageLength() { return images.size(); }
+  vk::Image const & ImageHandle(uint32_t idx) const
+    { return images[idx].image; }
+  vk::ImageView const & ImageView(uint32_t idx) const
+    { return images[idx].view; }
+  // of the image last acquired
+  vk::Semaphore const & RenderComplete() const
+    { return images[currentImage].renderComplete; }
 
-  void Construct(const glm::uvec2& size);
-  std::vector<vk::Framebuffer> CreateFramebuffers(
-    vk::FramebufferCreateInfo fbCI
-  );
-  uint32_t AcquireNextImage(vk::Semaphore const & presentCompleteSemaphore);
-  vk::Fence const & GetSubmitFence();
+  // builds the swapchain, or rebuilds it passing the current one through as
+  // oldSwapchain; the returned function destroys the retired swapchain and
+  // its views, and must only run once no frame in flight uses them
+  std::function<void()> Construct(const glm::uvec2& size);
+  // on success or eSuboptimalKHR currentImage holds the acquired image, on
+  // eErrorOutOfDateKHR nothing was acquired and the swapchain must be rebuilt
+  vk::Result AcquireNextImage(vk::Semaphore const & presentCompleteSemaphore);
   vk::Result QueuePresent(vk::Semaphore const & waitSemaphore);
+
+  // whether presents carry ids that WaitForPresent can wait on, ei. the
+  // device has VK_KHR_present_id & VK_KHR_present_wait
+  bool SupportsPresentWait() const { return waitForPresent != nullptr; }
+  // id of the last QueuePresent, 0 before the first
+  uint64_t LastPresentId() const { return presentId; }
+  // blocks until the present with the given id is visible or timeoutNs
+  // passes, returns false on timeout, error, or without present wait
+  bool WaitForPresent(uint64_t id, uint64_t timeoutNs);
   void Cleanup();
 };
@@ -0,0 +1,433 @@
+#include "texturestream.hpp"
+
+#include "util.hpp"
+
+#include "assetpack.hpp"
+#include "frame.hpp"
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+vk::ImageCreateInfo ChainImageCI(PackEntry const & entry, uint32_t mip) {
+  vk::ImageCreateInfo imageCI;
+  imageCI.imageType = vk::ImageType::e2D;
+  imageCI.format = static_cast<vk::Format>(entry.format);
+  imageCI.extent =
+    vk::Extent3D {
+      PackMipExtent(entry.width, mip), PackMipExtent(entry.height, mip), 1
+    };
+  imageCI.mipLevels = entry.mipLevels - mip;
+  imageCI.arrayLayers = 1;
+  imageCI.samples = vk::SampleCountFlagBits::e1;
+  imageCI.tiling = vk::ImageTiling::eOptimal;
+  imageCI.usage =
+    vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+  imageCI.sharingMode = vk::SharingMode::eExclusive;
+  imageCI.initialLayout = vk::ImageLayout::eUndefined;
+  return imageCI;
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+TextureStreamer::TextureStreamer(
+  GraphicsContext & context_
+, BindlessHeap & bindless_
+, AssetPack const & pack_
+, TextureStreamerCreateInfo const & ci_
+)
+: context{&context_}, bindless{&bindless_}, pack{&pack_}, ci{ci_}
+, uploads{context_, ci_.stagingBytes}
+{
+  this->stats.budgetBytes = this->ci.budgetBytes;
+
+  // the heap the images will land in, so the driver's budget applies from
+  // the first Plan; a probe stands in for them, as the memory types offered
+  // to sampled optimal images don't depend on their extent
+  PackEntry probe {};
+  probe.format = static_cast<uint32_t>(vk::Format::eR8G8B8A8Unorm);
+  probe.width = probe.height = probe.mipLevels = 1;
+  auto & device = this->context->device;
+  auto const image =
+    CheckReturn(
+      device->createImage(ChainImageCI(probe, 0)),
+      "Creating streamed texture probe image"
+    );
+  auto const memoryTypeIdx =
+    this->context->allocator->FindMemoryType(
+      device->getImageMemoryRequirements(image).memoryTypeBits
+    , MemoryUsage::GpuOnly
+    );
+  device->destroyImage(image);
+  if (memoryTypeIdx < VK_MAX_MEMORY_TYPES) {
+    this->heapIdx =
+      this->context->deviceMemoryProperties.memoryTypes[memoryTypeIdx]
+        .heapIndex;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TextureStreamer::~TextureStreamer() {
+  // the batch in flight still writes into its images
+  if (!this->batch.empty()) { this->uploads.Wait(this->batchValue); }
+
+  for (auto & texture : this->textures) {
+    this->bindless->Free(BindlessKind::SampledImage, texture.handle);
+    if (texture.resident) { this->DestroyResidency(*texture.resident); }
+    if (texture.loading) { this->DestroyResidency(*texture.loading); }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TextureId TextureStreamer::Add(std::string_view name) {
+  auto const * entry = this->pack->Find(name);
+  if (!entry || entry->kind != PackEntryKind::Image) {
+    spdlog::error("Asset pack has no image '{}'", name);
+    return invalidTextureId;
+  }
+
+  Texture texture;
+  texture.entry = entry;
+
+  auto const lastMip = entry->mipLevels - 1;
+  texture.coarseMip = lastMip;
+  for (uint32_t mip = 0; mip < lastMip; ++ mip) {
+    auto const extent =
+      std::max(
+        PackMipExtent(entry->width, mip), PackMipExtent(entry->height, mip)
+      );
+    if (extent <= this->ci.coarseExtent) {
+      texture.coarseMip = mip;
+      break;
+    }
+  }
+
+  // every level is staged in one piece
+  texture.finestMip = texture.coarseMip;
+  while (
+    texture.finestMip > 0
+ && PackMipSize(*entry, texture.finestMip - 1) <= this->ci.stagingBytes
+  ) {
+    -- texture.finestMip;
+  }
+
+  texture.memoryBytes.resize(entry->mipLevels, 0);
+  texture.requestedMip = texture.coarseMip;
+  this->textures.emplace_back(texture);
+  this->stats.textureCount = static_cast<uint32_t>(this->textures.size());
+  return static_cast<TextureId>(this->textures.size() - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t TextureStreamer::ResidentMip(TextureId id) const {
+  auto const & texture = this->textures[id];
+  return
+    texture.resident ? texture.resident->mip : texture.entry->mipLevels;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::RequestScreenSize(TextureId id, float pixels) {
+  auto const & entry = *this->textures[id].entry;
+  float const largest =
+    static_cast<float>(std::max(entry.width, entry.height));
+  // a texel per pixel, ei. 1024 texels over 300 pixels wants level 1
+  uint32_t mip = 0;
+  if (pixels > 0.0f && pixels < largest)
+    { mip = static_cast<uint32_t>(std::floor(std::log2(largest / pixels))); }
+  else if (pixels <= 0.0f)
+    { mip = entry.mipLevels - 1; }
+  this->RequestMip(id, mip);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::RequestMip(TextureId id, uint32_t mip) {
+  auto & texture = this->textures[id];
+  texture.requestedMip = std::min(texture.requestedMip, mip);
+  texture.lastRequested = this->updateCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::Update(
+  FrameRing & frames
+, vk::CommandBuffer const & commandBuffer
+, std::vector<SemaphoreSubmit> & waits
+) {
+  // only acquire once the transfer is done, so the frame never waits on it
+  if (!this->batch.empty() && this->uploads.IsComplete(this->batchValue)) {
+    auto const acquire = this->uploads.RecordOwnershipAcquire(commandBuffer);
+    if (acquire != 0) {
+      waits.push_back(SemaphoreSubmit { this->uploads.Timeline(), acquire });
+    }
+    this->Publish(frames);
+  }
+
+  if (this->batch.empty()) {
+    this->Plan();
+    if (!this->batch.empty()) { this->batchValue = this->uploads.Flush(); }
+  }
+
+  ++ this->updateCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::DeviceSize TextureStreamer::ChainBytes(
+  Texture const & texture
+, uint32_t mip
+) const {
+  auto const & entry = *texture.entry;
+  return PackMipOffset(entry, entry.mipLevels) - PackMipOffset(entry, mip);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::DeviceSize TextureStreamer::MemoryBytes(Texture & texture, uint32_t mip) {
+  auto & bytes = texture.memoryBytes[mip];
+  if (bytes != 0) { return bytes; }
+
+  // tiling & alignment padding make it larger than the packed texels; Vulkan
+  // 1.2 can only tell for an image that exists, one without memory is enough
+  auto & device = this->context->device;
+  auto const image =
+    CheckReturn(
+      device->createImage(ChainImageCI(*texture.entry, mip)),
+      "Creating streamed texture probe image"
+    );
+  bytes = device->getImageMemoryRequirements(image).size;
+  device->destroyImage(image);
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vk::DeviceSize TextureStreamer::EffectiveBudget() {
+  auto budget = this->ci.budgetBytes;
+
+  // leave room for whatever else the process & other processes use
+  if (
+    this->context->enableMemoryBudget
+ && this->heapIdx < VK_MAX_MEMORY_HEAPS
+  ) {
+    auto const heap = QueryMemoryBudget(*this->context)[this->heapIdx];
+    auto const resident = this->stats.residentBytes;
+    auto const others = heap.usage > resident ? heap.usage - resident : 0;
+    auto const available = heap.budget > others ? heap.budget - others : 0;
+    budget =
+      std::min(
+        budget
+      , static_cast<vk::DeviceSize>(available * this->ci.driverBudgetShare)
+      );
+  }
+
+  this->stats.budgetBytes = budget;
+  return budget;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool TextureStreamer::Load(TextureId id, uint32_t mip) {
+  auto & texture = this->textures[id];
+  auto const & entry = *texture.entry;
+
+  auto const imageCI = ChainImageCI(entry, mip);
+
+  AllocationCreateInfo allocationCI;
+  allocationCI.usage = MemoryUsage::GpuOnly;
+
+  Residency residency;
+  residency.mip = mip;
+  residency.image =
+    this->context->allocator->CreateImage(imageCI, allocationCI);
+  if (!residency.image.image) {
+    spdlog::error(
+      "Could not create image for '{}' from level {}"
+    , this->pack->Name(entry), mip
+    );
+    return false;
+  }
+
+  vk::ImageViewCreateInfo viewCI;
+  viewCI.image = residency.image.image;
+  viewCI.viewType = vk::ImageViewType::e2D;
+  viewCI.format = imageCI.format;
+  viewCI.subresourceRange =
+    vk::ImageSubresourceRange {
+      vk::ImageAspectFlagBits::eColor, 0, imageCI.mipLevels, 0, 1
+    };
+  residency.view =
+    CheckReturn(
+      this->context->device->createImageView(viewCI),
+      "Streamed texture image view creation"
+    );
+
+  this->pack->UploadImage(this->uploads, entry, residency.image.image, mip);
+  // copied into staging already, the pages can go
+  this->pack->Evict(entry);
+
+  this->stats.residentBytes += residency.image.allocation.size;
+  this->stats.uploadedBytes += this->ChainBytes(texture, mip);
+
+  texture.loading = residency;
+  this->batch.emplace_back(id);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::Publish(FrameRing & frames) {
+  for (auto const id : this->batch) {
+    auto & texture = this->textures[id];
+    if (!texture.loading) { continue; }
+
+    auto loading = *texture.loading;
+    texture.loading.reset();
+
+    // a fresh slot rather than rewriting the old one, frames in flight may
+    // still read it
+    auto const handle = this->bindless->AddSampledImage(loading.view);
+    if (handle == invalidBindlessHandle) {
+      spdlog::error(
+        "Bindless heap is full, dropping '{}'", this->pack->Name(*texture.entry)
+      );
+      this->stats.residentBytes -= loading.image.allocation.size;
+      this->DestroyResidency(loading);
+      continue;
+    }
+
+    if (texture.resident) {
+      this->stats.residentBytes -= texture.resident->image.allocation.size;
+      DeferDestroy(frames, texture.resident->view);
+      DeferDestroy(frames, texture.resident->image);
+      DeferDestroy(
+        frames
+      , [bindless = this->bindless, oldHandle = texture.handle]() {
+          bindless->Free(BindlessKind::SampledImage, oldHandle);
+        }
+      );
+    }
+
+    texture.resident = loading;
+    texture.handle = handle;
+  }
+  this->batch.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::Plan() {
+  auto const budget = this->EffectiveBudget();
+  // signed, the budget can shrink below what's resident; evictions only free
+  // their bytes once swapped out, this counts them as freed when planned.
+  // Memory is counted in MemoryBytes like residentBytes, the upload budget in
+  // the packed ChainBytes
+  int64_t available =
+    static_cast<int64_t>(budget)
+  - static_cast<int64_t>(this->stats.residentBytes);
+  vk::DeviceSize uploadBudget = this->ci.uploadBytesPerBatch;
+
+  // coarse tails first, they're what everything falls back to
+  for (TextureId id = 0; id < this->textures.size(); ++ id) {
+    auto & texture = this->textures[id];
+    if (texture.resident || texture.loading) { continue; }
+    auto const memory = this->MemoryBytes(texture, texture.coarseMip);
+    auto const bytes = this->ChainBytes(texture, texture.coarseMip);
+    if (!this->Load(id, texture.coarseMip)) { continue; }
+    available -= static_cast<int64_t>(memory);
+    uploadBudget -= std::min(uploadBudget, bytes);
+  }
+
+  // over budget, ei. the driver's shrank; anything may go
+  while (available < 0 && this->Evict(~0ull, available)) {}
+
+  // -- raises, most recently requested first, then the furthest behind
+  std::vector<TextureId> raises;
+  for (TextureId id = 0; id < this->textures.size(); ++ id) {
+    auto const & texture = this->textures[id];
+    if (!texture.resident || texture.loading) { continue; }
+    if (texture.lastRequested + this->ci.idleUpdates < this->updateCount)
+      { continue; }
+    auto const target = std::max(texture.requestedMip, texture.finestMip);
+    if (target < texture.resident->mip) { raises.emplace_back(id); }
+  }
+
+  std::sort(
+    raises.begin(), raises.end()
+  , [this](TextureId a, TextureId b) {
+      auto const & ta = this->textures[a];
+      auto const & tb = this->textures[b];
+      if (ta.lastRequested != tb.lastRequested)
+        { return ta.lastRequested > tb.lastRequested; }
+      return
+        ta.resident->mip - std::max(ta.requestedMip, ta.finestMip)
+      > tb.resident->mip - std::max(tb.requestedMip, tb.finestMip);
+    }
+  );
+
+  for (auto const id : raises) {
+    auto & texture = this->textures[id];
+    auto const current = texture.resident->mip;
+
+    // step towards the target when the whole way doesn't fit the batch, but
+    // always take at least a level while the batch is empty
+    auto mip = std::max(texture.requestedMip, texture.finestMip);
+    while (mip+1 < current && this->ChainBytes(texture, mip) > uploadBudget)
+      { ++ mip; }
+    auto const bytes = this->ChainBytes(texture, mip);
+    if (bytes > uploadBudget && !this->batch.empty()) { continue; }
+
+    auto const growth =
+      static_cast<int64_t>(this->MemoryBytes(texture, mip))
+    - static_cast<int64_t>(this->MemoryBytes(texture, current));
+    while (
+      growth > available
+   && this->Evict(texture.lastRequested, available)
+    ) {}
+    if (growth > available) { continue; }
+
+    if (!this->Load(id, mip)) { continue; }
+    available -= growth;
+    uploadBudget -= std::min(uploadBudget, bytes);
+    ++ this->stats.raises;
+  }
+
+  for (auto & texture : this->textures)
+    { texture.requestedMip = texture.coarseMip; }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// drops the least recently requested texture above its tail, requested before
+// requestedBefore, back to the tail; false if there's none
+bool TextureStreamer::Evict(uint64_t requestedBefore, int64_t & available) {
+  std::optional<TextureId> victim;
+  for (TextureId id = 0; id < this->textures.size(); ++ id) {
+    auto const & texture = this->textures[id];
+    if (
+      !texture.resident || texture.loading
+   || texture.resident->mip >= texture.coarseMip
+   || texture.lastRequested >= requestedBefore
+    ) {
+      continue;
+    }
+    if (
+      !victim
+   || texture.lastRequested < this->textures[*victim].lastRequested
+    ) {
+      victim = id;
+    }
+  }
+  if (!victim) { return false; }
+
+  auto & texture = this->textures[*victim];
+  auto const freed =
+    this->MemoryBytes(texture, texture.resident->mip)
+  - this->MemoryBytes(texture, texture.coarseMip);
+  if (!this->Load(*victim, texture.coarseMip)) { return false; }
+
+  available += static_cast<int64_t>(freed);
+  ++ this->stats.evictions;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::DestroyResidency(Residency & residency) {
+  this->context->device->destroyImageView(residency.view);
+  this->context->allocator->DestroyImage(residency.image);
+}
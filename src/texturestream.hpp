@@ -0,0 +1,149 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "bindless.hpp"
+#include "submit.hpp"
+#include "upload.hpp"
+#include "vulkan.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+class AssetPack; // -- fwd decl
+struct FrameRing; // -- fwd decl
+struct GraphicsContext; // -- fwd decl
+struct PackEntry; // -- fwd decl
+
+using TextureId = uint32_t;
+inline constexpr TextureId invalidTextureId = ~0u;
+
+////////////////////////////////////////////////////////////////////////////////
+struct TextureStreamerCreateInfo {
+  // ceiling for every streamed texture together; with VK_EXT_memory_budget
+  // it's lowered further to driverBudgetShare of what the heap has left
+  vk::DeviceSize budgetBytes = 256ull*1024ull*1024ull;
+  float driverBudgetShare = 0.9f;
+  // levels no larger than this are loaded on Add & never evicted
+  uint32_t coarseExtent = 64;
+  // caps the bytes read out of the pack per batch, larger raises go in steps
+  vk::DeviceSize uploadBytesPerBatch = 16ull*1024ull*1024ull;
+  vk::DeviceSize stagingBytes = 64ull*1024ull*1024ull;
+  // a texture nobody asked for in this many updates drops to its coarse levels
+  // once memory is needed elsewhere, least recently used first
+  uint32_t idleUpdates = 120;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct TextureStreamerStats {
+  uint32_t textureCount = 0;
+  vk::DeviceSize budgetBytes = 0;
+  vk::DeviceSize residentBytes = 0; // including loads not yet swapped in
+  uint64_t uploadedBytes = 0; // -- totals since construction
+  uint32_t raises = 0;
+  uint32_t evictions = 0;
+};
+
+// keeps the mip chains of pack images resident according to demand & a
+// memory budget. Each texture starts out with only its coarse tail; demand
+// reported through Request* raises the finest resident level, memory pressure
+// lowers the least recently used ones back to their tail. A residency change
+// builds a new image holding the chain from the new level down, streamed from
+// the pack's mapping, and swaps it in under a fresh bindless handle once its
+// upload has finished; the old image & handle are freed through DeferDestroy,
+// so in-flight frames never see a descriptor change under them. Shaders read
+// the texture through Handle(), which is stable between swaps. Not thread
+// safe, owned by the render thread.
+class TextureStreamer {
+private:
+  struct Residency {
+    Image image;
+    vk::ImageView view;
+    uint32_t mip = 0; // the level of the pack image that's level 0 here
+  };
+
+  struct Texture {
+    PackEntry const * entry = nullptr;
+    uint32_t coarseMip = 0; // first level of the tail that's always resident
+    uint32_t finestMip = 0; // first level small enough to stage in one go
+    // what an image of the chain from each level allocates, 0 until queried
+    std::vector<vk::DeviceSize> memoryBytes;
+
+    std::optional<Residency> resident;
+    std::optional<Residency> loading; // in the batch in flight
+    BindlessHandle handle = invalidBindlessHandle;
+
+    // -- demand since the last plan
+    uint32_t requestedMip = 0;
+    uint64_t lastRequested = 0; // update count
+  };
+
+  GraphicsContext* context = nullptr;
+  BindlessHeap* bindless = nullptr;
+  AssetPack const* pack = nullptr;
+  TextureStreamerCreateInfo ci;
+
+  UploadEngine uploads;
+  uint64_t batchValue = 0; // upload timeline value of the batch in flight
+  std::vector<TextureId> batch;
+
+  std::vector<Texture> textures;
+  uint64_t updateCount = 0;
+  uint32_t heapIdx = VK_MAX_MEMORY_HEAPS; // of the images
+  TextureStreamerStats stats;
+
+  // the packed texels of the chain from mip, what an upload reads & stages
+  vk::DeviceSize ChainBytes(Texture const & texture, uint32_t mip) const;
+  // the device memory an image of the chain from mip takes, what the budget
+  // is planned in
+  vk::DeviceSize MemoryBytes(Texture & texture, uint32_t mip);
+  vk::DeviceSize EffectiveBudget();
+  // false if nothing was queued, ei. the image couldn't be created
+  bool Load(TextureId id, uint32_t mip);
+  void Publish(FrameRing & frames);
+  void Plan();
+  bool Evict(uint64_t requestedBefore, int64_t & available);
+  void DestroyResidency(Residency & residency);
+
+public:
+  TextureStreamer(
+    GraphicsContext & context_
+  , BindlessHeap & bindless_
+  , AssetPack const & pack_
+  , TextureStreamerCreateInfo const & ci_ = {}
+  );
+  // only once no frame uses the textures anymore, ei. after a waitIdle
+  ~TextureStreamer();
+  TextureStreamer(TextureStreamer const &) = delete;
+  TextureStreamer(TextureStreamer &&) = delete;
+
+  // queues the texture's coarse levels; invalidTextureId if the pack has no
+  // image of that name
+  TextureId Add(std::string_view name);
+
+  // invalidBindlessHandle until the coarse levels are in
+  BindlessHandle Handle(TextureId id) const { return textures[id].handle; }
+  // the pack level that's level 0 of the bound image, ei. to offset an
+  // explicit LOD; implicit LODs need no adjusting
+  uint32_t ResidentMip(TextureId id) const;
+
+  // -- demand feedback for the current frame, ei. from the CPU's projected
+  //    bounds or a readback of GPU sampling feedback; requests until the next
+  //    Update are combined, keeping the finest
+  // the texture covers about pixels screen pixels along its larger axis
+  void RequestScreenSize(TextureId id, float pixels);
+  void RequestMip(TextureId id, uint32_t mip);
+
+  // once per frame while recording commandBuffer, before anything it records
+  // samples a streamed texture: swaps in the batch that finished uploading,
+  // recording its queue ownership acquire (adding the timeline wait, already
+  // satisfied, to waits), then plans & flushes the next batch
+  void Update(
+    FrameRing & frames
+  , vk::CommandBuffer const & commandBuffer
+  , std::vector<SemaphoreSubmit> & waits
+  );
+
+  TextureStreamerStats const & Stats() const { return stats; }
+};
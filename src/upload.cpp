@@ -0,0 +1,402 @@
+#include "upload.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+vk::ImageSubresourceRange SubresourceRange(
+  vk::ImageSubresourceLayers const & layers
+) {
+  vk::ImageSubresourceRange range;
+  range.aspectMask     = layers.aspectMask;
+  range.baseMipLevel   = layers.mipLevel;
+  range.levelCount     = 1;
+  range.baseArrayLayer = layers.baseArrayLayer;
+  range.layerCount     = layers.layerCount;
+  return range;
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+UploadEngine::UploadEngine(
+  GraphicsContext & context_
+, vk::DeviceSize stagingSize_
+)
+: context{&context_}
+{
+  this->submits = this->context->transferSubmits;
+  this->queueFamilyIdx = this->context->transferQueueIdx;
+  this->ownershipTransfer =
+    this->context->transferQueueIdx != this->context->graphicsQueueIdx;
+
+  { // staging ring
+    vk::BufferCreateInfo bufferCI;
+    bufferCI.size = stagingSize_;
+    bufferCI.usage = vk::BufferUsageFlagBits::eTransferSrc;
+    bufferCI.sharingMode = vk::SharingMode::eExclusive;
+
+    AllocationCreateInfo allocationCI;
+    allocationCI.usage = MemoryUsage::CpuToGpu;
+    allocationCI.category = MemoryCategory::Staging;
+    this->staging =
+      this->context->allocator->CreateBuffer(bufferCI, allocationCI);
+    this->stagingSize = stagingSize_;
+
+    if (!this->staging.allocation.mapped)
+      { spdlog::critical("Upload staging ring could not be mapped"); }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+UploadEngine::~UploadEngine() {
+  this->Wait(this->submittedValue);
+  this->inFlight.clear();
+  this->freeBatches.clear();
+  this->context->allocator->DestroyBuffer(this->staging);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UploadEngine::Collect() {
+  if (this->inFlight.empty()) { return; }
+
+  auto const completed = this->submits->CompletedValue();
+  while (
+    !this->inFlight.empty()
+ && this->inFlight.front().timelineValue <= completed
+  ) {
+    this->stagingTail = this->inFlight.front().stagingEnd;
+    this->freeBatches.emplace_back(std::move(this->inFlight.front()));
+    this->inFlight.pop_front();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+UploadEngine::Batch UploadEngine::AcquireBatch() {
+  if (!this->freeBatches.empty()) {
+    Batch batch = std::move(this->freeBatches.back());
+    this->freeBatches.pop_back();
+    this->context->device->resetCommandPool(*batch.commandPool, {});
+    return batch;
+  }
+
+  Batch batch;
+
+  vk::CommandPoolCreateInfo commandPoolCI;
+  commandPoolCI.queueFamilyIndex = this->queueFamilyIdx;
+  commandPoolCI.flags = vk::CommandPoolCreateFlagBits::eTransient;
+  batch.commandPool =
+    CheckReturn(
+      this->context->device->createCommandPoolUnique(commandPoolCI),
+      "Creating upload command pool"
+    );
+
+  vk::CommandBufferAllocateInfo commandBufferAI;
+  commandBufferAI.commandPool = *batch.commandPool;
+  commandBufferAI.commandBufferCount = 1;
+  commandBufferAI.level = vk::CommandBufferLevel::ePrimary;
+  batch.commandBuffer =
+    CheckReturn(
+      this->context->device->allocateCommandBuffers(commandBufferAI),
+      "Allocating upload command buffer"
+    )[0];
+
+  return batch;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+StagingRegion UploadEngine::ReserveStaging(
+  vk::DeviceSize size
+, vk::DeviceSize alignment
+) {
+  if (size > this->stagingSize) {
+    spdlog::error(
+      "Upload of {} bytes exceeds staging ring of {}"
+    , size, this->stagingSize
+    );
+    return StagingRegion {};
+  }
+
+  // never straddle the end of the ring, skip to its start instead
+  auto start = AlignUp(this->stagingHead, alignment);
+  auto const physical = start % this->stagingSize;
+  if (physical + size > this->stagingSize)
+    { start += this->stagingSize - physical; }
+
+  this->Collect();
+  while (start + size - this->stagingTail > this->stagingSize) {
+    // the ring is full of copies that were queued or are still executing
+    if (this->HasPendingCopies()) { this->Flush(); }
+    if (!this->inFlight.empty()) {
+      // its staging stays live for good, there's no room to wait for
+      if (!this->Wait(this->inFlight.front().timelineValue)) {
+        spdlog::error("Upload of {} bytes has no staging left", size);
+        return StagingRegion {};
+      }
+      this->Collect();
+      continue;
+    }
+
+    // idle, only the padding skipped to reach start is in the way, so a
+    // request of nearly the whole ring starts a new lap instead
+    start = AlignUp(this->stagingHead, this->stagingSize);
+    this->stagingTail = start;
+  }
+
+  this->stagingHead = start + size;
+
+  StagingRegion region;
+  region.offset = start % this->stagingSize;
+  region.size = size;
+  region.data =
+    static_cast<std::byte*>(this->staging.allocation.mapped) + region.offset;
+  return region;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UploadEngine::CopyToBuffer(
+  StagingRegion const & region
+, vk::Buffer const & dst
+, vk::DeviceSize dstOffset
+) {
+  if (!region.data) { return; }
+  this->pendingBufferCopies.push_back({
+    dst, vk::BufferCopy { region.offset, dstOffset, region.size }
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UploadEngine::CopyToImage(
+  StagingRegion const & region
+, vk::Image const & dst
+, vk::BufferImageCopy copy
+, vk::ImageLayout finalLayout
+) {
+  if (!region.data) { return; }
+  copy.bufferOffset += region.offset;
+  this->pendingImageCopies.push_back({dst, copy, finalLayout});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UploadEngine::UploadBuffer(
+  vk::Buffer const & dst
+, vk::DeviceSize dstOffset
+, void const * data
+, vk::DeviceSize size
+) {
+  auto const chunkSize = this->stagingSize / 4;
+  auto const * bytes = static_cast<std::byte const *>(data);
+  for (vk::DeviceSize offset = 0; offset < size; offset += chunkSize) {
+    auto const length = std::min(chunkSize, size - offset);
+    auto region = this->ReserveStaging(length);
+    if (!region.data) { return; }
+    std::memcpy(region.data, bytes + offset, length);
+    this->CopyToBuffer(region, dst, dstOffset + offset);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UploadEngine::UploadImage(
+  vk::Image const & dst
+, vk::BufferImageCopy const & copy
+, void const * data
+, vk::DeviceSize size
+, vk::ImageLayout finalLayout
+) {
+  // texel blocks are at most 16 bytes
+  auto region = this->ReserveStaging(size, 16);
+  if (!region.data) { return; }
+  std::memcpy(region.data, data, size);
+  this->CopyToImage(region, dst, copy, finalLayout);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t UploadEngine::Flush() {
+  if (!this->HasPendingCopies()) { return this->submittedValue; }
+
+  this->context->allocator->Flush(this->staging.allocation);
+
+  auto const bufferAcquires = this->pendingBufferAcquires.size();
+  auto const imageAcquires = this->pendingImageAcquires.size();
+  auto batch = this->AcquireBatch();
+  auto const & commandBuffer = batch.commandBuffer;
+
+  vk::CommandBufferBeginInfo commandBufferBI;
+  commandBufferBI.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  commandBuffer.begin(commandBufferBI);
+
+  auto const graphicsFamily = this->context->graphicsQueueIdx;
+  auto const srcFamily =
+    this->ownershipTransfer ? this->queueFamilyIdx : VK_QUEUE_FAMILY_IGNORED;
+  auto const dstFamily =
+    this->ownershipTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+  { // images, transition to transfer dst then copy
+    std::vector<vk::ImageMemoryBarrier> toTransfer;
+    for (auto const & copy : this->pendingImageCopies) {
+      vk::ImageMemoryBarrier barrier;
+      barrier.srcAccessMask = {};
+      barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+      barrier.oldLayout = vk::ImageLayout::eUndefined;
+      barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = copy.dst;
+      barrier.subresourceRange = SubresourceRange(copy.region.imageSubresource);
+      toTransfer.emplace_back(barrier);
+    }
+
+    if (!toTransfer.empty()) {
+      commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe
+      , vk::PipelineStageFlagBits::eTransfer
+      , {}, {}, {}, toTransfer
+      );
+    }
+
+    for (auto const & copy : this->pendingImageCopies) {
+      commandBuffer.copyBufferToImage(
+        this->staging.buffer
+      , copy.dst
+      , vk::ImageLayout::eTransferDstOptimal
+      , copy.region
+      );
+    }
+  }
+
+  { // buffers, regions into the same buffer go out as one command
+    std::stable_sort(
+      this->pendingBufferCopies.begin()
+    , this->pendingBufferCopies.end()
+    , [](auto const & a, auto const & b) {
+        return
+          static_cast<VkBuffer>(a.dst) < static_cast<VkBuffer>(b.dst);
+      }
+    );
+
+    std::vector<vk::BufferCopy> regions;
+    for (size_t i = 0; i < this->pendingBufferCopies.size(); ++ i) {
+      auto const & copy = this->pendingBufferCopies[i];
+      regions.emplace_back(copy.region);
+      if (i+1 == this->pendingBufferCopies.size()
+       || this->pendingBufferCopies[i+1].dst != copy.dst
+      ) {
+        commandBuffer.copyBuffer(this->staging.buffer, copy.dst, regions);
+        regions.clear();
+      }
+    }
+  }
+
+  { // release to graphics (or just make the writes available)
+    std::vector<vk::BufferMemoryBarrier> bufferReleases;
+    std::vector<vk::ImageMemoryBarrier>  imageReleases;
+
+    for (auto const & copy : this->pendingBufferCopies) {
+      vk::BufferMemoryBarrier barrier;
+      barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+      barrier.dstAccessMask = {};
+      barrier.srcQueueFamilyIndex = srcFamily;
+      barrier.dstQueueFamilyIndex = dstFamily;
+      barrier.buffer = copy.dst;
+      barrier.offset = copy.region.dstOffset;
+      barrier.size = copy.region.size;
+      bufferReleases.emplace_back(barrier);
+    }
+
+    for (auto const & copy : this->pendingImageCopies) {
+      vk::ImageMemoryBarrier barrier;
+      barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+      barrier.dstAccessMask = {};
+      barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+      barrier.newLayout = copy.finalLayout;
+      barrier.srcQueueFamilyIndex = srcFamily;
+      barrier.dstQueueFamilyIndex = dstFamily;
+      barrier.image = copy.dst;
+      barrier.subresourceRange = SubresourceRange(copy.region.imageSubresource);
+      imageReleases.emplace_back(barrier);
+    }
+
+    commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer
+    , vk::PipelineStageFlagBits::eBottomOfPipe
+    , {}, {}, bufferReleases, imageReleases
+    );
+
+    // the acquire must match the release exactly, besides its access masks
+    if (this->ownershipTransfer) {
+      for (auto barrier : bufferReleases) {
+        barrier.srcAccessMask = {};
+        barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+        this->pendingBufferAcquires.emplace_back(barrier);
+      }
+      for (auto barrier : imageReleases) {
+        barrier.srcAccessMask = {};
+        barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+        this->pendingImageAcquires.emplace_back(barrier);
+      }
+    }
+  }
+
+  commandBuffer.end();
+
+  // flushed right away, uploads are what other queues end up waiting on
+  batch.timelineValue = this->submits->Enqueue({ commandBuffer });
+  batch.stagingEnd = this->stagingHead;
+  auto const submitted = this->submits->Flush();
+  this->pendingBufferCopies.clear();
+  this->pendingImageCopies.clear();
+
+  // the copies are lost, there's nothing to acquire or wait for; their
+  // staging is reclaimed with the next batch that retires
+  if (submitted < batch.timelineValue) {
+    spdlog::error("Upload batch failed to submit, its copies are dropped");
+    this->pendingBufferAcquires.resize(bufferAcquires);
+    this->pendingImageAcquires.resize(imageAcquires);
+    this->freeBatches.emplace_back(std::move(batch));
+    return this->submittedValue;
+  }
+
+  this->submittedValue = batch.timelineValue;
+  this->inFlight.emplace_back(std::move(batch));
+  this->pendingAcquireValue = this->submittedValue;
+
+  return this->submittedValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool UploadEngine::IsComplete(uint64_t value) {
+  return this->submits->IsComplete(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool UploadEngine::Wait(uint64_t value) {
+  return this->submits->Wait(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t UploadEngine::RecordOwnershipAcquire(
+  vk::CommandBuffer const & commandBuffer
+) {
+  if (
+    !this->pendingBufferAcquires.empty()
+ || !this->pendingImageAcquires.empty()
+  ) {
+    commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTopOfPipe
+    , vk::PipelineStageFlagBits::eAllCommands
+    , {}, {}, this->pendingBufferAcquires, this->pendingImageAcquires
+    );
+    this->pendingBufferAcquires.clear();
+    this->pendingImageAcquires.clear();
+  }
+
+  auto const value = this->pendingAcquireValue;
+  this->pendingAcquireValue = 0;
+  return value;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "vulkan.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+class SubmitQueue; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+struct StagingRegion {
+  std::byte* data = nullptr; // persistently mapped, write straight into it
+  vk::DeviceSize offset = 0; // into the staging buffer
+  vk::DeviceSize size = 0;
+};
+
+// streams buffer & image data to the GPU on the transfer queue through a
+// persistently mapped staging ring; copies are batched until Flush, which
+// signals the returned timeline value on completion. Not thread safe, owned by
+// whichever thread prepares uploads. Each image subresource may only be
+// written once per batch.
+class UploadEngine {
+private:
+  struct Batch {
+    vk::UniqueCommandPool commandPool;
+    vk::CommandBuffer commandBuffer;
+    uint64_t timelineValue = 0;
+    vk::DeviceSize stagingEnd = 0; // ring head once this batch was recorded
+  };
+
+  struct PendingBufferCopy {
+    vk::Buffer dst;
+    vk::BufferCopy region;
+  };
+
+  struct PendingImageCopy {
+    vk::Image dst;
+    vk::BufferImageCopy region;
+    vk::ImageLayout finalLayout;
+  };
+
+  GraphicsContext* context = nullptr;
+
+  SubmitQueue* submits = nullptr;
+  uint32_t queueFamilyIdx = 0;
+  bool ownershipTransfer = false; // transfer & graphics families differ
+
+  Buffer staging;
+  vk::DeviceSize stagingSize = 0;
+  // monotonic byte counters, the live part of the ring is [tail, head)
+  vk::DeviceSize stagingHead = 0;
+  vk::DeviceSize stagingTail = 0;
+
+  uint64_t submittedValue = 0;
+
+  std::deque<Batch> inFlight;
+  std::vector<Batch> freeBatches;
+
+  std::vector<PendingBufferCopy> pendingBufferCopies;
+  std::vector<PendingImageCopy>  pendingImageCopies;
+
+  // acquire halves of queue family ownership transfers, recorded on the
+  // graphics queue once the release has been submitted
+  std::vector<vk::BufferMemoryBarrier> pendingBufferAcquires;
+  std::vector<vk::ImageMemoryBarrier>  pendingImageAcquires;
+  uint64_t pendingAcquireValue = 0;
+
+  void Collect();
+  Batch AcquireBatch();
+  bool HasPendingCopies() const
+    { return !pendingBufferCopies.empty() || !pendingImageCopies.empty(); }
+
+public:
+  UploadEngine(
+    GraphicsContext & context_
+  , vk::DeviceSize stagingSize = 64ull*1024ull*1024ull
+  );
+  ~UploadEngine();
+  UploadEngine(UploadEngine const &) = delete;
+  UploadEngine(UploadEngine &&) = delete;
+
+  vk::Semaphore const & Timeline() const { return submits->Timeline(); }
+
+  // blocks (flushing if needed) until the ring has room; returns an empty
+  // region if size exceeds the whole ring
+  StagingRegion ReserveStaging(
+    vk::DeviceSize size
+  , vk::DeviceSize alignment = 16
+  );
+
+  // queue copies out of a reserved region, region offsets are relative
+  void CopyToBuffer(
+    StagingRegion const & region
+  , vk::Buffer const & dst
+  , vk::DeviceSize dstOffset
+  );
+  void CopyToImage(
+    StagingRegion const & region
+  , vk::Image const & dst
+  , vk::BufferImageCopy copy
+  , vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+  );
+
+  // memcpy conveniences over the above, buffers larger than the ring are
+  // streamed through it in chunks
+  void UploadBuffer(
+    vk::Buffer const & dst
+  , vk::DeviceSize dstOffset
+  , void const * data
+  , vk::DeviceSize size
+  );
+  void UploadImage(
+    vk::Image const & dst
+  , vk::BufferImageCopy const & copy
+  , void const * data
+  , vk::DeviceSize size
+  , vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+  );
+
+  // submits every queued copy as a single batch, returns the timeline value
+  // signalled once it completes (the last value if nothing was queued)
+  uint64_t Flush();
+
+  bool IsComplete(uint64_t value);
+  // false if value will never complete, see SubmitQueue::Wait
+  bool Wait(uint64_t value);
+
+  // records the graphics-queue half of ownership transfers for everything
+  // flushed so far; the submit executing commandBuffer must wait on
+  // Timeline() for the returned value (0 if nothing was flushed since)
+  uint64_t RecordOwnershipAcquire(vk::CommandBuffer const & commandBuffer);
+};
@@ -1,5 +1,38 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// to a multiple of alignment, which needn't be a power of two
+constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+constexpr uint64_t AlignDown(uint64_t value, uint64_t alignment) {
+  return value / alignment * alignment;
+}
+
+// the contents of a JSON string, control characters as \u00XX
+inline std::string EscapeJson(std::string_view str) {
+  constexpr char hexDigits[] = "0123456789abcdef";
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char const c : str) {
+    auto const byte = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (byte < 0x20) {
+      escaped += "\\u00";
+      escaped.push_back(hexDigits[byte >> 4]);
+      escaped.push_back(hexDigits[byte & 0xf]);
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
 
 #ifndef NDEBUG
 
@@ -17,7 +50,7 @@ decltype(Result::value) CheckReturn(Result && result , char const * errMsg) {
     );
     spdlog::dump_backtrace();
   }
-  return result.value;
+  return std::move(result.value);
 }
 
 #else
@@ -0,0 +1,344 @@
+#include "video.hpp"
+
+#include "util.hpp"
+
+#include "graphicscontext.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// the first run of '#' in pattern replaced by the zero-padded frameNumber
+std::string SequencePath(std::string const & pattern, uint64_t frameNumber) {
+  auto const first = pattern.find('#');
+  if (first == std::string::npos) { return pattern; }
+  auto const last = pattern.find_first_not_of('#', first);
+  auto const width =
+    (last == std::string::npos ? pattern.size() : last) - first;
+  return
+    pattern.substr(0, first)
+  + fmt::format("{:0{}}", frameNumber, width)
+  + (last == std::string::npos ? "" : pattern.substr(last));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool IsBgra(vk::Format format) {
+  return
+    format == vk::Format::eB8G8R8A8Unorm
+ || format == vk::Format::eB8G8R8A8Srgb;
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+char const * ToString(VideoFormat format) {
+  switch (format) {
+    case VideoFormat::Y4m: return "y4m";
+    case VideoFormat::Ppm: return "ppm";
+  }
+  return "unknown";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::optional<VideoFormat> VideoFormatFromString(std::string_view name) {
+  for (auto const format : { VideoFormat::Y4m, VideoFormat::Ppm }) {
+    if (name == ToString(format)) { return format; }
+  }
+  return std::nullopt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+VideoCapture::VideoCapture(
+  GraphicsContext & context_
+, VideoCaptureCreateInfo ci_
+)
+: context{&context_}, ci{std::move(ci_)}
+{
+  // one queue entry per slot plus the final one
+  this->ci.depth = std::clamp(this->ci.depth, 1u, 32u);
+
+  // a PPM path without '#' gets every frame, concatenated like a pipe would
+  bool const sequence =
+    this->ci.format == VideoFormat::Ppm
+ && this->ci.path.find('#') != std::string::npos;
+  if (this->ci.path == "-") {
+    this->stream = stdout;
+  } else if (!sequence) {
+    this->stream = std::fopen(this->ci.path.c_str(), "wb");
+    if (!this->stream) {
+      spdlog::error("Could not open '{}' for writing", this->ci.path);
+      return;
+    }
+  }
+
+  vk::BufferCreateInfo bufferCI;
+  bufferCI.size =
+    vk::DeviceSize(this->ci.extent.width) * this->ci.extent.height * 4;
+  bufferCI.usage = vk::BufferUsageFlagBits::eTransferDst;
+  bufferCI.sharingMode = vk::SharingMode::eExclusive;
+
+  AllocationCreateInfo allocationCI;
+  allocationCI.usage = MemoryUsage::GpuToCpu;
+  allocationCI.strategy = AllocationStrategy::Dedicated;
+  allocationCI.category = MemoryCategory::Staging;
+
+  this->slots.resize(this->ci.depth);
+  for (auto & slot : this->slots) {
+    slot = std::make_unique<Slot>();
+    slot->buffer =
+      this->context->allocator->CreateBuffer(bufferCI, allocationCI);
+  }
+
+  spdlog::info(
+    "Writing {}x{} {} at {} fps to '{}', {} frames of readback"
+  , this->ci.extent.width, this->ci.extent.height, ToString(this->ci.format)
+  , this->ci.fps, this->ci.path, this->ci.depth
+  );
+
+  this->writer = std::thread([this]() { this->WriterLoop(); });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+VideoCapture::~VideoCapture() {
+  this->Finish();
+  for (auto & slot : this->slots)
+    { this->context->allocator->DestroyBuffer(slot->buffer); }
+  if (this->stream && this->stream != stdout)
+    { std::fclose(this->stream); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VideoCapture::RecordReadback(
+  vk::CommandBuffer const & commandBuffer
+, vk::Image const & image
+, uint64_t frameNumber
+) {
+  if (!this->IsOpen()) { return; }
+
+  auto const slotIdx = this->nextSlot;
+  this->nextSlot = (this->nextSlot + 1) % this->ci.depth;
+  auto & slot = *this->slots[slotIdx];
+
+  // the writer is a whole ring behind
+  slot.busy.wait(true);
+  slot.busy.store(true);
+
+  { // the render pass' color writes before the copy reads them
+    vk::ImageMemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+    barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange =
+      vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+    commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput
+    , vk::PipelineStageFlagBits::eTransfer
+    , {}, {}, {}, barrier
+    );
+  }
+
+  vk::BufferImageCopy region;
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0; // tightly packed
+  region.bufferImageHeight = 0;
+  region.imageSubresource =
+    vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+  region.imageExtent =
+    vk::Extent3D { this->ci.extent.width, this->ci.extent.height, 1 };
+  commandBuffer.copyImageToBuffer(
+    image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer.buffer, region
+  );
+
+  { // the copy before the writer thread maps it
+    vk::BufferMemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = slot.buffer.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer
+    , vk::PipelineStageFlagBits::eHost
+    , {}, {}, barrier, {}
+    );
+  }
+
+  this->recorded = Readback { slotIdx, frameNumber, 0, false };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VideoCapture::Submitted(uint64_t timelineValue) {
+  if (!this->recorded) { return; }
+  this->recorded->timelineValue = timelineValue;
+  // holds at most depth entries, one per busy slot
+  this->queue.TryPush(*this->recorded);
+  this->recorded.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VideoCapture::Finish() {
+  if (this->finished || !this->IsOpen()) { return; }
+  this->finished = true;
+
+  if (this->recorded) {
+    spdlog::error(
+      "Frame {} was recorded for video but never submitted"
+    , this->recorded->frameNumber
+    );
+    this->slots[this->recorded->slot]->busy.store(false);
+    this->recorded.reset();
+  }
+
+  Readback last;
+  last.last = true;
+  while (!this->queue.TryPush(last))
+    { std::this_thread::yield(); }
+  this->writer.join();
+
+  if (this->stream) { std::fflush(this->stream); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VideoCapture::WriterLoop() {
+  bool failed = false;
+  for (;;) {
+    Readback readback;
+    if (!this->queue.TryPop(readback)) {
+      this->queue.WaitForItem();
+      continue;
+    }
+    if (readback.last) { return; }
+
+    auto & slot = *this->slots[readback.slot];
+    this->context->graphicsSubmits->Wait(readback.timelineValue);
+    this->context->allocator->Invalidate(slot.buffer.allocation);
+
+    // after a failed write frames are only retired, so rendering carries on
+    if (!failed) {
+      auto const pixels =
+        static_cast<uint8_t const *>(slot.buffer.allocation.mapped);
+      failed = !this->WriteFrame(pixels, readback.frameNumber);
+      if (!failed) { ++ this->framesWritten; }
+    }
+
+    slot.busy.store(false);
+    slot.busy.notify_one();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VideoCapture::WriteFrame(uint8_t const * pixels, uint64_t frameNumber) {
+  auto const width = this->ci.extent.width, height = this->ci.extent.height;
+
+  std::string header;
+  if (this->ci.format == VideoFormat::Y4m) {
+    this->ConvertY4m(pixels);
+    if (this->framesWritten.load() == 0) {
+      // F is a ratio, in thousandths so 29.97 & the like survive
+      auto const fpsMilli =
+        static_cast<uint64_t>(std::llround(this->ci.fps * 1000.0));
+      header =
+        fpsMilli % 1000 == 0
+        ? fmt::format(
+            "YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n"
+          , width, height, fpsMilli / 1000
+          )
+        : fmt::format(
+            "YUV4MPEG2 W{} H{} F{}:1000 Ip A1:1 C420jpeg\n"
+          , width, height, fpsMilli
+          );
+    }
+    header += "FRAME\n";
+  } else {
+    this->ConvertPpm(pixels);
+    header = fmt::format("P6\n{} {}\n255\n", width, height);
+  }
+
+  std::FILE * file = this->stream;
+  if (!file) {
+    auto const path = SequencePath(this->ci.path, frameNumber);
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+      spdlog::error("Could not open '{}' for writing", path);
+      return false;
+    }
+  }
+
+  bool const written =
+    std::fwrite(header.data(), 1, header.size(), file) == header.size()
+ && std::fwrite(this->converted.data(), 1, this->converted.size(), file)
+ == this->converted.size();
+
+  if (file != this->stream) { std::fclose(file); }
+  if (!written)
+    { spdlog::error("Writing video frame {} failed", frameNumber); }
+  return written;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VideoCapture::ConvertY4m(uint8_t const * pixels) {
+  // full range BT.601 (JFIF) in 8-bit fixed point, chroma from the average of
+  // each 2x2 block, edges of odd sizes clamped
+  auto const width = this->ci.extent.width, height = this->ci.extent.height;
+  auto const chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+  size_t const lumaSize = size_t(width) * height;
+  size_t const chromaSize = size_t(chromaWidth) * chromaHeight;
+  this->converted.resize(lumaSize + 2*chromaSize);
+
+  uint32_t const r = IsBgra(this->ci.colorFormat) ? 2 : 0, g = 1;
+  uint32_t const b = 2 - r;
+
+  uint8_t * luma = this->converted.data();
+  for (size_t i = 0; i < lumaSize; ++ i) {
+    auto const * px = pixels + i*4;
+    luma[i] =
+      static_cast<uint8_t>((77*px[r] + 150*px[g] + 29*px[b] + 128) >> 8);
+  }
+
+  uint8_t * cb = luma + lumaSize;
+  uint8_t * cr = cb + chromaSize;
+  for (uint32_t cy = 0; cy < chromaHeight; ++ cy)
+  for (uint32_t cx = 0; cx < chromaWidth; ++ cx) {
+    int32_t sum[3] = { 0, 0, 0 };
+    for (uint32_t dy = 0; dy < 2; ++ dy)
+    for (uint32_t dx = 0; dx < 2; ++ dx) {
+      auto const x = std::min(cx*2 + dx, width - 1);
+      auto const y = std::min(cy*2 + dy, height - 1);
+      auto const * px = pixels + (size_t(y)*width + x)*4;
+      sum[0] += px[r]; sum[1] += px[g]; sum[2] += px[b];
+    }
+    int32_t const red = sum[0] / 4, green = sum[1] / 4, blue = sum[2] / 4;
+    size_t const i = size_t(cy)*chromaWidth + cx;
+    cb[i] =
+      static_cast<uint8_t>(
+        std::clamp(((-43*red - 85*green + 128*blue + 128) >> 8) + 128, 0, 255)
+      );
+    cr[i] =
+      static_cast<uint8_t>(
+        std::clamp(((128*red - 107*green - 21*blue + 128) >> 8) + 128, 0, 255)
+      );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VideoCapture::ConvertPpm(uint8_t const * pixels) {
+  size_t const pixelCount =
+    size_t(this->ci.extent.width) * this->ci.extent.height;
+  this->converted.resize(pixelCount * 3);
+
+  uint32_t const r = IsBgra(this->ci.colorFormat) ? 2 : 0;
+  uint32_t const b = 2 - r;
+  for (size_t i = 0; i < pixelCount; ++ i) {
+    this->converted[i*3 + 0] = pixels[i*4 + r];
+    this->converted[i*3 + 1] = pixels[i*4 + 1];
+    this->converted[i*3 + 2] = pixels[i*4 + b];
+  }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "allocator.hpp"
+#include "spscqueue.hpp"
+#include "vulkan.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct GraphicsContext; // -- fwd decl
+
+////////////////////////////////////////////////////////////////////////////////
+enum class VideoFormat {
+  Y4m, // YUV4MPEG2 4:2:0, ei. piped into ffmpeg
+  Ppm, // binary PPM, one file per frame or concatenated when streamed
+};
+
+char const * ToString(VideoFormat format);
+std::optional<VideoFormat> VideoFormatFromString(std::string_view name);
+
+////////////////////////////////////////////////////////////////////////////////
+struct VideoCaptureCreateInfo {
+  // a file or "-" for stdout; for a PPM sequence, the run of '#' in it is
+  // replaced by the zero-padded frame number, ei. "out/frame_#####.ppm"
+  std::string path;
+  VideoFormat format = VideoFormat::Y4m;
+  vk::Extent2D extent;
+  // 8-bit RGBA or BGRA, what the frames are rendered in
+  vk::Format colorFormat = vk::Format::eR8G8B8A8Unorm;
+  double fps = 60.0;
+  // readback buffers in the ring, how far the writer may fall behind
+  uint32_t depth = 4;
+};
+
+// streams rendered frames out to a file or pipe. Every frame is copied into
+// the next of a ring of host-visible readback buffers as part of its own
+// submit, and a writer thread waits on that submit's timeline value, converts
+// & writes the buffer straight out of mapped memory, then frees the slot. The
+// GPU never waits on readback; the render thread only blocks when the writer
+// is a whole ring behind, letting output throughput bound the run
+class VideoCapture {
+private:
+  struct Slot {
+    Buffer buffer;
+    std::atomic<bool> busy { false }; // from RecordReadback until written
+  };
+
+  struct Readback {
+    uint32_t slot = 0;
+    uint64_t frameNumber = 0;
+    uint64_t timelineValue = 0;
+    bool last = false; // no frames follow, the writer quits
+  };
+
+  GraphicsContext* context = nullptr;
+  VideoCaptureCreateInfo ci;
+
+  std::vector<std::unique_ptr<Slot>> slots;
+  uint32_t nextSlot = 0;
+  std::optional<Readback> recorded; // waiting for its submit
+
+  SpscQueue<Readback, 64> queue;
+  std::thread writer;
+  std::FILE* stream = nullptr; // null when writing a sequence of files
+  std::atomic<uint64_t> framesWritten { 0 };
+  bool finished = false;
+
+  // -- writer thread only
+  std::vector<uint8_t> converted;
+
+  void WriterLoop();
+  bool WriteFrame(uint8_t const * pixels, uint64_t frameNumber);
+  void ConvertY4m(uint8_t const * pixels);
+  void ConvertPpm(uint8_t const * pixels);
+
+public:
+  VideoCapture(GraphicsContext & context_, VideoCaptureCreateInfo ci_);
+  ~VideoCapture();
+  VideoCapture(VideoCapture const &) = delete;
+  VideoCapture(VideoCapture &&) = delete;
+
+  // false if the output couldn't be opened, nothing will be written
+  bool IsOpen() const { return writer.joinable(); }
+
+  // records the copy of image, in eTransferSrcOptimal after the frame's
+  // render pass, into the next slot; blocks while the writer still has it
+  void RecordReadback(
+    vk::CommandBuffer const & commandBuffer
+  , vk::Image const & image
+  , uint64_t frameNumber
+  );
+  // the graphics timeline value of the submit carrying the last readback
+  void Submitted(uint64_t timelineValue);
+
+  // writes out every frame submitted & joins the writer
+  void Finish();
+  uint64_t FramesWritten() const { return framesWritten.load(); }
+};
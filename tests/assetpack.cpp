@@ -0,0 +1,178 @@
+// packs written by dtq_pack read back through AssetPack, no device needed:
+//
+//   dtq_test_assetpack <path to dtq_pack> <scratch directory>
+
+#include "assetpack.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+void Check(bool condition, char const * what, int line) {
+  if (condition) { return; }
+  spdlog::error("line {}: {}", line, what);
+  ++ failures;
+}
+
+#define CHECK(X) Check((X), #X, __LINE__)
+
+////////////////////////////////////////////////////////////////////////////////
+bool WriteFile(std::string const & path, std::vector<uint8_t> const & data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(
+    reinterpret_cast<char const *>(data.data())
+  , static_cast<std::streamsize>(data.size())
+  );
+  out.close();
+  return static_cast<bool>(out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t> ReadFile(std::string const & path) {
+  std::ifstream file(path, std::ios::binary);
+  return {
+    std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// a 5x3 P6 whose texel i is (i, 2i, 3i)
+std::vector<uint8_t> TestPpm() {
+  std::string const header = "P6\n# made by the test\n5 3\n255\n";
+  std::vector<uint8_t> ppm(header.begin(), header.end());
+  for (uint8_t i = 0; i < 15; ++ i) {
+    ppm.push_back(i);
+    ppm.push_back(static_cast<uint8_t>(i*2));
+    ppm.push_back(static_cast<uint8_t>(i*3));
+  }
+  return ppm;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestRoundTrip(std::string const & packPath) {
+  AssetPack pack(packPath);
+  CHECK(pack.IsOpen());
+  if (!pack.IsOpen()) { return; }
+  CHECK(pack.EntryCount() == 2);
+
+  auto const * blob = pack.Find("blob");
+  CHECK(blob && blob->kind == PackEntryKind::Blob);
+  if (blob) {
+    auto const data = pack.Data(*blob);
+    std::string_view const text(
+      reinterpret_cast<char const *>(data.data()), data.size()
+    );
+    CHECK(text == "hello pack");
+    CHECK(pack.Name(*blob) == "blob");
+    CHECK(blob->dataOffset % 256 == 0);
+  }
+
+  auto const * image = pack.Find("checker");
+  CHECK(image && image->kind == PackEntryKind::Image);
+  if (image) {
+    CHECK(image->width == 5 && image->height == 3);
+    CHECK(image->texelSize == 4);
+    // 5x3, 2x1, 1x1
+    CHECK(image->mipLevels == 3);
+    CHECK(image->dataSize == (15 + 2 + 1) * 4);
+
+    auto const top = pack.MipData(*image, 0);
+    CHECK(top.size() == 15 * 4);
+    // texel 7 of the source, RGB widened with an opaque alpha
+    auto const * texel = reinterpret_cast<uint8_t const *>(top.data()) + 7*4;
+    CHECK(texel[0] == 7 && texel[1] == 14 && texel[2] == 21);
+    CHECK(texel[3] == 255);
+    CHECK(pack.MipData(*image, 2).size() == 4);
+  }
+
+  CHECK(!pack.Find("missing"));
+  CHECK(!pack.Find(""));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestTruncated(std::string const & packPath, std::string const & dir) {
+  auto data = ReadFile(packPath);
+  data.pop_back();
+  auto const truncatedPath = dir + "/truncated.pack";
+  CHECK(WriteFile(truncatedPath, data));
+  CHECK(!AssetPack(truncatedPath).IsOpen());
+
+  // too short to even hold the header
+  data.resize(sizeof(PackHeader) / 2);
+  CHECK(WriteFile(truncatedPath, data));
+  CHECK(!AssetPack(truncatedPath).IsOpen());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// extents whose level size wraps around 64 bits, so the mip chain would look
+// like it fits the data
+void TestOverflow(std::string const & packPath, std::string const & dir) {
+  auto data = ReadFile(packPath);
+  PackHeader header;
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  bool patched = false;
+  for (uint32_t i = 0; i < header.entryCount; ++ i) {
+    auto const at = header.indexOffset + i*sizeof(PackEntry);
+    PackEntry entry;
+    std::memcpy(&entry, data.data() + at, sizeof(entry));
+    if (entry.kind != PackEntryKind::Image) { continue; }
+
+    // 2^31 * 2^31 * 4 texel bytes, exactly 2^64 & so 0 once wrapped
+    entry.width = 1u << 31;
+    entry.height = 1u << 31;
+    entry.texelSize = 4;
+    entry.mipLevels = 1;
+    std::memcpy(data.data() + at, &entry, sizeof(entry));
+    patched = true;
+  }
+  CHECK(patched);
+
+  auto const corruptPath = dir + "/overflow.pack";
+  CHECK(WriteFile(corruptPath, data));
+  CHECK(!AssetPack(corruptPath).IsOpen());
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char ** argv) {
+  if (argc < 3) {
+    spdlog::error("usage: dtq_test_assetpack <dtq_pack> <scratch directory>");
+    return 1;
+  }
+  std::string const packer = argv[1];
+  std::string const dir = argv[2];
+
+  std::string const text = "hello pack";
+  CHECK(WriteFile(dir + "/checker.ppm", TestPpm()));
+  CHECK(WriteFile(dir + "/blob.bin", { text.begin(), text.end() }));
+
+  auto const packPath = dir + "/test.pack";
+  auto const command =
+    "\"" + packer + "\" -o \"" + packPath + "\" --align 256"
+    " \"checker=" + dir + "/checker.ppm\" \"blob=" + dir + "/blob.bin\"";
+  CHECK(std::system(command.c_str()) == 0);
+
+  TestRoundTrip(packPath);
+  TestTruncated(packPath, dir);
+  TestOverflow(packPath, dir);
+
+  if (failures > 0) {
+    spdlog::error("{} asset pack checks failed", failures);
+    return 1;
+  }
+  spdlog::info("Asset pack checks passed");
+  return 0;
+}
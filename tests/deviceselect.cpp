@@ -0,0 +1,217 @@
+// device selection against synthetic candidates, no device or loader needed
+
+#include "deviceselect.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+void Check(bool condition, char const * what, int line) {
+  if (condition) { return; }
+  spdlog::error("line {}: {}", line, what);
+  ++ failures;
+}
+
+#define CHECK(X) Check((X), #X, __LINE__)
+
+////////////////////////////////////////////////////////////////////////////////
+// a device every requirement is met by, the tests take away from it
+DeviceCandidate Candidate(
+  uint32_t index
+, std::string name
+, vk::PhysicalDeviceType type
+) {
+  DeviceCandidate self;
+  self.index = index;
+  self.name = std::move(name);
+  self.uuid.fill(static_cast<uint8_t>(index));
+  self.type = type;
+  self.apiVersion = VK_API_VERSION_1_2;
+  self.deviceLocalBytes = 4ull*1024ull*1024ull*1024ull;
+  self.graphicsQueue = true;
+  self.presentQueue = true;
+  self.timelineSemaphore = true;
+  return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool HasReason(DeviceScore const & score, std::string const & reason) {
+  return
+    std::find(score.reasons.begin(), score.reasons.end(), reason)
+ != score.reasons.end();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestRejections() {
+  DeviceRequirements requirements;
+  requirements.requiredExtensions = { "VK_KHR_swapchain" };
+
+  auto candidate = Candidate(0, "Old", vk::PhysicalDeviceType::eDiscreteGpu);
+  candidate.apiVersion = VK_API_VERSION_1_1;
+  candidate.graphicsQueue = false;
+  candidate.presentQueue = false;
+  candidate.timelineSemaphore = false;
+
+  auto const score = ScoreDevice(candidate, requirements);
+  CHECK(!score.eligible);
+  CHECK(score.score == 0);
+  CHECK(HasReason(score, "Vulkan 1.1 is too old"));
+  CHECK(HasReason(score, "no graphics queue"));
+  CHECK(HasReason(score, "can't present to the surface"));
+  CHECK(HasReason(score, "no timeline semaphores"));
+  CHECK(HasReason(score, "missing VK_KHR_swapchain"));
+  CHECK(score.reasons.size() == 5);
+
+  // presenting is only required with a surface
+  auto headless = Candidate(0, "Headless", vk::PhysicalDeviceType::eCpu);
+  headless.presentQueue = false;
+  requirements.present = false;
+  requirements.requiredExtensions.clear();
+  CHECK(ScoreDevice(headless, requirements).eligible);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestRanking() {
+  DeviceRequirements const requirements;
+
+  // the integrated device has more memory & better queues, type still wins
+  auto integrated =
+    Candidate(0, "Integrated", vk::PhysicalDeviceType::eIntegratedGpu);
+  integrated.deviceLocalBytes = 32ull*1024ull*1024ull*1024ull;
+  integrated.dedicatedCompute = true;
+  integrated.dedicatedTransfer = true;
+  auto const discrete =
+    Candidate(1, "Discrete", vk::PhysicalDeviceType::eDiscreteGpu);
+  auto const cpu = Candidate(2, "Cpu", vk::PhysicalDeviceType::eCpu);
+
+  auto const selection =
+    SelectDevice({ integrated, discrete, cpu }, requirements);
+  CHECK(selection.chosen == 1);
+  CHECK(selection.scores.size() == 3);
+  CHECK(selection.scores[1].score > selection.scores[0].score);
+  CHECK(selection.scores[0].score > selection.scores[2].score);
+
+  // a rejected discrete device loses to anything eligible
+  auto noTimeline = discrete;
+  noTimeline.timelineSemaphore = false;
+  CHECK(SelectDevice({ integrated, noTimeline }, requirements).chosen == 0);
+
+  // and nothing eligible selects nothing
+  CHECK(!SelectDevice({ noTimeline }, requirements).chosen);
+  CHECK(!SelectDevice({}, requirements).chosen);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestTieBreak() {
+  DeviceRequirements const requirements;
+  auto const a = Candidate(0, "Twin A", vk::PhysicalDeviceType::eDiscreteGpu);
+  auto const b = Candidate(1, "Twin B", vk::PhysicalDeviceType::eDiscreteGpu);
+
+  CHECK(SelectDevice({ a, b }, requirements).chosen == 0);
+  CHECK(SelectDevice({ b, a }, requirements).chosen == 0);
+
+  // an optional extension is enough to break the tie
+  DeviceRequirements withOptional;
+  withOptional.optionalExtensions = { "VK_EXT_memory_budget" };
+  auto budget = b;
+  budget.extensions = { "VK_EXT_memory_budget" };
+  CHECK(SelectDevice({ a, budget }, withOptional).chosen == 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestParseOverride() {
+  CHECK(!ParseDeviceOverride(""));
+
+  auto const index = ParseDeviceOverride("12");
+  CHECK(index && index->kind == DeviceOverride::Kind::Index);
+  CHECK(index && index->index == 12);
+
+  auto const name = ParseDeviceOverride("RTX");
+  CHECK(name && name->kind == DeviceOverride::Kind::Name);
+  CHECK(name && name->name == "rtx");
+
+  auto const uuid =
+    ParseDeviceOverride("00112233-4455-6677-8899-aabbccddeeff");
+  CHECK(uuid && uuid->kind == DeviceOverride::Kind::Uuid);
+  CHECK(uuid && uuid->uuid[0] == 0x00 && uuid->uuid[1] == 0x11);
+  CHECK(uuid && uuid->uuid[15] == 0xff);
+  auto const undashed =
+    ParseDeviceOverride("00112233445566778899AABBCCDDEEFF");
+  CHECK(undashed && uuid && undashed->uuid == uuid->uuid);
+
+  // one digit short of a UUID is a name
+  auto const shortHex =
+    ParseDeviceOverride("00112233445566778899aabbccddeef");
+  CHECK(shortHex && shortHex->kind == DeviceOverride::Kind::Name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TestOverride() {
+  DeviceRequirements const requirements;
+  auto const discrete =
+    Candidate(0, "NVIDIA GeForce RTX", vk::PhysicalDeviceType::eDiscreteGpu);
+  auto integrated =
+    Candidate(1, "Intel UHD", vk::PhysicalDeviceType::eIntegratedGpu);
+  integrated.uuid =
+    ParseDeviceOverride("0123456789abcdef0123456789abcdef")->uuid;
+  std::vector<DeviceCandidate> const candidates { discrete, integrated };
+
+  CHECK(SelectDevice(candidates, requirements).chosen == 0);
+  CHECK(
+    SelectDevice(candidates, requirements, ParseDeviceOverride("1")).chosen
+ == 1
+  );
+  CHECK(
+    SelectDevice(candidates, requirements, ParseDeviceOverride("uhd")).chosen
+ == 1
+  );
+  CHECK(
+    SelectDevice(
+      candidates, requirements
+    , ParseDeviceOverride("01234567-89ab-cdef-0123-456789abcdef")
+    ).chosen
+ == 1
+  );
+
+  // matching nothing falls back to scoring
+  auto const unmatched =
+    SelectDevice(candidates, requirements, ParseDeviceOverride("7"));
+  CHECK(unmatched.chosen == 0);
+  CHECK(unmatched.reason.find("matches no device") != std::string::npos);
+
+  // naming a rejected device is ignored
+  auto rejected = integrated;
+  rejected.graphicsQueue = false;
+  auto const ignored =
+    SelectDevice(
+      { discrete, rejected }, requirements, ParseDeviceOverride("1")
+    );
+  CHECK(ignored.chosen == 0);
+  CHECK(ignored.reason.find("rejected devices") != std::string::npos);
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+int main() {
+  TestRejections();
+  TestRanking();
+  TestTieBreak();
+  TestParseOverride();
+  TestOverride();
+
+  if (failures > 0) {
+    spdlog::error("{} device selection checks failed", failures);
+    return 1;
+  }
+  spdlog::info("Device selection checks passed");
+  return 0;
+}
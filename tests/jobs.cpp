@@ -0,0 +1,184 @@
+// the work stealing deque under contention & the job graph's ordering, no
+// device needed
+
+#include "jobs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+void Check(bool condition, char const * what, int line) {
+  if (condition) { return; }
+  spdlog::error("line {}: {}", line, what);
+  ++ failures;
+}
+
+#define CHECK(X) Check((X), #X, __LINE__)
+
+////////////////////////////////////////////////////////////////////////////////
+// the owner pushes in bursts bigger than the ring, so it grows while thieves
+// are reading from it, & pops between bursts; every item has to be taken by
+// exactly one of them
+void TestDequeStress(uint32_t thiefCount) {
+  constexpr uint32_t itemCount = 1u << 20;
+  constexpr uint32_t burst = 1000;
+
+  // starts tiny so the ring grows many times over
+  WorkStealingDeque<uint32_t> deque(4);
+  auto taken = std::make_unique<std::atomic<uint8_t>[]>(itemCount);
+  std::atomic<uint32_t> takenCount { 0 };
+  std::atomic<bool> ownerDone { false };
+
+  auto const take = [&](uint32_t item) {
+    taken[item].fetch_add(1, std::memory_order_relaxed);
+    takenCount.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  std::vector<std::thread> thieves;
+  std::vector<uint32_t> stolen(thiefCount, 0);
+  for (uint32_t i = 0; i < thiefCount; ++ i) {
+    thieves.emplace_back([&, i]() {
+      uint32_t item;
+      while (
+        !ownerDone.load(std::memory_order_acquire)
+     || takenCount.load(std::memory_order_relaxed) < itemCount
+      ) {
+        if (deque.Steal(item)) {
+          take(item);
+          ++ stolen[i];
+        }
+      }
+    });
+  }
+
+  uint32_t popped = 0;
+  uint32_t item;
+  for (uint32_t first = 0; first < itemCount; first += burst) {
+    for (uint32_t i = first; i < first + burst && i < itemCount; ++ i)
+      { deque.Push(i); }
+    // leaves some behind, so the next burst grows the ring further
+    for (uint32_t i = 0; i < burst / 2 && deque.Pop(item); ++ i) {
+      take(item);
+      ++ popped;
+    }
+  }
+  while (deque.Pop(item)) {
+    take(item);
+    ++ popped;
+  }
+  ownerDone.store(true, std::memory_order_release);
+
+  for (auto & thief : thieves)
+    { thief.join(); }
+
+  CHECK(takenCount.load() == itemCount);
+  uint32_t duplicates = 0, missing = 0;
+  for (uint32_t i = 0; i < itemCount; ++ i) {
+    auto const count = taken[i].load();
+    if (count == 0) { ++ missing; }
+    if (count > 1) { ++ duplicates; }
+  }
+  CHECK(missing == 0);
+  CHECK(duplicates == 0);
+
+  uint32_t stolenTotal = 0;
+  for (auto const count : stolen)
+    { stolenTotal += count; }
+  CHECK(popped + stolenTotal == itemCount);
+
+  // nothing left for anyone
+  CHECK(!deque.Pop(item));
+  CHECK(!deque.Steal(item));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the last item, fought over by the owner & a thief, goes to only one
+void TestDequeLastItem() {
+  WorkStealingDeque<uint32_t> deque(2);
+  for (uint32_t round = 0; round < 20000; ++ round) {
+    deque.Push(round);
+    std::atomic<bool> go { false };
+    uint32_t stolenItem = 0;
+    bool stolen = false;
+    std::thread thief([&]() {
+      while (!go.load(std::memory_order_acquire)) {}
+      stolen = deque.Steal(stolenItem);
+    });
+    go.store(true, std::memory_order_release);
+    uint32_t poppedItem = 0;
+    bool const popped = deque.Pop(poppedItem);
+    thief.join();
+
+    CHECK(popped != stolen);
+    if (popped == stolen) { return; }
+    CHECK((popped ? poppedItem : stolenItem) == round);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// a diamond, a -> (b, c) -> d, run repeatedly; every node sees its
+// dependencies finished & runs once per Run
+void TestGraphOrder(JobSystem & jobs) {
+  std::atomic<uint32_t> a { 0 }, b { 0 }, c { 0 }, d { 0 };
+  std::atomic<uint32_t> outOfOrder { 0 };
+  uint32_t run = 0;
+
+  JobGraph graph;
+  auto const nodeA = graph.Add([&]() { a.fetch_add(1); });
+  auto const nodeB =
+    graph.Add([&]() {
+      if (a.load() != run + 1) { outOfOrder.fetch_add(1); }
+      b.fetch_add(1);
+    }, { nodeA });
+  auto const nodeC =
+    graph.Add([&]() {
+      if (a.load() != run + 1) { outOfOrder.fetch_add(1); }
+      c.fetch_add(1);
+    }, { nodeA });
+  graph.Add([&]() {
+    if (b.load() != run + 1 || c.load() != run + 1)
+      { outOfOrder.fetch_add(1); }
+    d.fetch_add(1);
+  }, { nodeB, nodeC });
+  CHECK(graph.Size() == 4);
+
+  constexpr uint32_t runs = 1000;
+  for (run = 0; run < runs; ++ run)
+    { graph.Run(jobs); }
+
+  CHECK(outOfOrder.load() == 0);
+  CHECK(a.load() == runs && b.load() == runs);
+  CHECK(c.load() == runs && d.load() == runs);
+}
+
+} // -- namespace
+
+////////////////////////////////////////////////////////////////////////////////
+int main() {
+  // at least a few thieves, even on a single core
+  auto const thiefCount =
+    std::max(std::thread::hardware_concurrency(), 4u) - 1;
+  TestDequeStress(thiefCount);
+  TestDequeLastItem();
+
+  // workers even on a single core, so nodes finish on different threads
+  JobSystem jobs(3);
+  TestGraphOrder(jobs);
+
+  if (failures > 0) {
+    spdlog::error("{} job checks failed", failures);
+    return 1;
+  }
+  spdlog::info("Job checks passed");
+  return 0;
+}